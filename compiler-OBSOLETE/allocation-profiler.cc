@@ -0,0 +1,230 @@
+#include "allocation-profiler.hh"
+#include "time-profiler.hh"
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+#if defined(__GNUG__)
+#include <stdlib.h>
+#include <cxxabi.h>
+#endif
+
+#if defined(COMBUST_ALLOCATION_PROFILER)
+
+struct ALLOCATION_PROFILER_STATE {
+    std::atomic<uint64_t>           Count{ 0 };
+    std::atomic<uint64_t>           Bytes{ 0 };
+    std::atomic<int64_t>            LiveBytes{ 0 };
+    std::atomic<int64_t>            PeakLiveBytes{ 0 };
+
+    /** Indexed by TIME_PHASE, with TP_COUNT for outside of every phase. */
+    std::atomic<uint64_t>           PhaseCounts[TP_COUNT + 1]{ };
+    std::atomic<uint64_t>           PhaseBytes[TP_COUNT + 1]{ };
+
+    /** Every counter created so far, most recent first. */
+    std::atomic<AllocationCounter*> Counters{ nullptr };
+};
+
+static ALLOCATION_PROFILER_STATE& GetState() {
+    static ALLOCATION_PROFILER_STATE state{ };
+    return state;
+}
+
+/**
+ * \return the phase the calling thread's allocations count towards
+ */
+static unsigned& GetCurrentPhase() {
+    thread_local unsigned phase{ TP_COUNT };
+    return phase;
+}
+
+AllocationCounter::AllocationCounter(const std::type_info& type) :
+    Type{ type }
+{
+    std::atomic<AllocationCounter*>& counters{ GetState().Counters };
+
+    Next = counters.load(std::memory_order_relaxed);
+    while (!counters.compare_exchange_weak(Next, this, std::memory_order_release, std::memory_order_relaxed))
+        ;
+}
+
+void RecordAllocation(AllocationCounter& counter, size_t size) {
+    ALLOCATION_PROFILER_STATE& state{ GetState() };
+
+    counter.Count.fetch_add(1, std::memory_order_relaxed);
+    counter.Bytes.fetch_add(size, std::memory_order_relaxed);
+    counter.LiveBytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+
+    state.Count.fetch_add(1, std::memory_order_relaxed);
+    state.Bytes.fetch_add(size, std::memory_order_relaxed);
+    unsigned phase{ GetCurrentPhase() };
+    state.PhaseCounts[phase].fetch_add(1, std::memory_order_relaxed);
+    state.PhaseBytes[phase].fetch_add(size, std::memory_order_relaxed);
+
+    int64_t live{ state.LiveBytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed) };
+    live += static_cast<int64_t>(size);
+
+    int64_t peak{ state.PeakLiveBytes.load(std::memory_order_relaxed) };
+    while (live > peak && !state.PeakLiveBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+        ;
+}
+
+void RecordDeallocation(AllocationCounter& counter, size_t size) {
+    counter.LiveBytes.fetch_sub(static_cast<int64_t>(size), std::memory_order_relaxed);
+    GetState().LiveBytes.fetch_sub(static_cast<int64_t>(size), std::memory_order_relaxed);
+}
+
+unsigned SetAllocationPhase(unsigned phase) {
+    unsigned previous{ GetCurrentPhase() };
+    GetCurrentPhase() = phase;
+    return previous;
+}
+
+AllocationStats GetAllocationStats() {
+    ALLOCATION_PROFILER_STATE& state{ GetState() };
+    return AllocationStats{ state.Count.load(), state.Bytes.load() };
+}
+
+AllocationStats GetAllocationStats(unsigned phase) {
+    ALLOCATION_PROFILER_STATE& state{ GetState() };
+    if (phase > TP_COUNT)
+        return AllocationStats{ };
+
+    return AllocationStats{ state.PhaseCounts[phase].load(), state.PhaseBytes[phase].load() };
+}
+
+AllocationStats GetAllocationStats(const std::type_info& type) {
+    AllocationCounter* counter{ GetState().Counters.load(std::memory_order_acquire) };
+
+    for (; counter != nullptr; counter = counter->Next) {
+        if (counter->Type == type)
+            return AllocationStats{ counter->Count.load(), counter->Bytes.load() };
+    }
+
+    return AllocationStats{ };
+}
+
+int64_t GetLiveBytes() {
+    return GetState().LiveBytes.load();
+}
+
+int64_t GetPeakLiveBytes() {
+    return GetState().PeakLiveBytes.load();
+}
+
+void ResetPeakLiveBytes() {
+    ALLOCATION_PROFILER_STATE& state{ GetState() };
+    state.PeakLiveBytes.store(state.LiveBytes.load());
+}
+
+/**
+ * \return the readable name of type where the compiler can provide one
+ */
+static std::string GetTypeName(const std::type_info& type) {
+#if defined(__GNUG__)
+    int status{ 0 };
+    char* demangled{ abi::__cxa_demangle(type.name(), nullptr, nullptr, &status) };
+
+    if (status == 0 && demangled != nullptr) {
+        std::string name{ demangled };
+        free(demangled);
+        return name;
+    }
+#endif
+    return type.name();
+}
+
+std::string FormatAllocationReport() {
+    std::string report{ };
+    char line[256];
+
+    AllocationStats total{ GetAllocationStats() };
+
+    report += "===------------------------------------------------------------===\n";
+    report += "                     Allocation report\n";
+    report += "===------------------------------------------------------------===\n";
+
+    snprintf(
+        line,
+        sizeof(line),
+        "  %llu objects, %llu bytes; peak live %lld bytes, live now %lld bytes\n\n",
+        static_cast<unsigned long long>(total.Count),
+        static_cast<unsigned long long>(total.Bytes),
+        static_cast<long long>(GetPeakLiveBytes()),
+        static_cast<long long>(GetLiveBytes())
+    );
+    report += line;
+    report += "       Count        Bytes  Phase\n";
+
+    for (unsigned phase{ 0 }; phase <= TP_COUNT; ++phase) {
+        AllocationStats stats{ GetAllocationStats(phase) };
+        if (stats.Count == 0)
+            continue;
+
+        snprintf(
+            line,
+            sizeof(line),
+            "  %10llu %12llu  %s\n",
+            static_cast<unsigned long long>(stats.Count),
+            static_cast<unsigned long long>(stats.Bytes),
+            phase == TP_COUNT ? "(none)" : GetTimePhaseName(static_cast<TIME_PHASE>(phase))
+        );
+        report += line;
+    }
+
+    std::vector<const AllocationCounter*> counters{ };
+    for (const AllocationCounter* counter{ GetState().Counters.load() }; counter != nullptr; counter = counter->Next)
+        counters.push_back(counter);
+
+    std::sort(counters.begin(), counters.end(), [](const AllocationCounter* a, const AllocationCounter* b) {
+        return a->Bytes.load() > b->Bytes.load();
+    });
+
+    report += "\n       Count        Bytes   Live bytes  Type\n";
+
+    for (const AllocationCounter* counter : counters) {
+        snprintf(
+            line,
+            sizeof(line),
+            "  %10llu %12llu %12lld  %s\n",
+            static_cast<unsigned long long>(counter->Count.load()),
+            static_cast<unsigned long long>(counter->Bytes.load()),
+            static_cast<long long>(counter->LiveBytes.load()),
+            GetTypeName(counter->Type).c_str()
+        );
+        report += line;
+    }
+
+    return report;
+}
+
+#else
+
+AllocationStats GetAllocationStats() {
+    return AllocationStats{ };
+}
+
+AllocationStats GetAllocationStats(unsigned) {
+    return AllocationStats{ };
+}
+
+AllocationStats GetAllocationStats(const std::type_info&) {
+    return AllocationStats{ };
+}
+
+int64_t GetLiveBytes() {
+    return 0;
+}
+
+int64_t GetPeakLiveBytes() {
+    return 0;
+}
+
+void ResetPeakLiveBytes() { }
+
+std::string FormatAllocationReport() {
+    return "Allocation profiling is not built in; rebuild with ALLOCATION_PROFILER=1.\n";
+}
+
+#endif
+
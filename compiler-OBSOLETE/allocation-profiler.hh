@@ -0,0 +1,107 @@
+#ifndef COMBUST_ALLOCATION_PROFILER_HH
+#define COMBUST_ALLOCATION_PROFILER_HH
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <typeinfo>
+
+/*
+ * Counts what NewObj and NewChild allocate, per type and per TIME_PHASE,
+ * when built with COMBUST_ALLOCATION_PROFILER defined (make
+ * ALLOCATION_PROFILER=1; unit tests always are). Otherwise only the
+ * declarations below the #if exist and every query returns zeros.
+ *
+ * Memory that does not come from NewObj or NewChild, such as the blocks of
+ * a SyntaxArena or the storage of standard containers, is not counted.
+ */
+
+struct AllocationStats {
+    uint64_t Count{ 0 };
+    uint64_t Bytes{ 0 };
+};
+
+#if defined(COMBUST_ALLOCATION_PROFILER)
+
+/**
+ * Totals for one allocated type. One is created per type on its first
+ * allocation and lives for the rest of the program.
+ */
+struct AllocationCounter {
+    explicit AllocationCounter(const std::type_info& type);
+
+    const std::type_info&  Type;
+    std::atomic<uint64_t>  Count{ 0 };
+    std::atomic<uint64_t>  Bytes{ 0 };
+    std::atomic<int64_t>   LiveBytes{ 0 };
+    AllocationCounter*     Next{ nullptr };
+};
+
+void RecordAllocation(AllocationCounter& counter, size_t size);
+void RecordDeallocation(AllocationCounter& counter, size_t size);
+
+/**
+ * Makes allocations on the calling thread count towards phase, a
+ * TIME_PHASE or TP_COUNT for none.
+ *
+ * \return the phase they counted towards before
+ */
+unsigned SetAllocationPhase(unsigned phase);
+
+template<typename Ty>
+AllocationCounter& GetAllocationCounter() {
+    static AllocationCounter counter{ typeid(Ty) };
+    return counter;
+}
+
+/**
+ * Deleter of Owner. Owners never change their pointee's type, so Ty is
+ * always the type NewChild allocated.
+ */
+template<typename Ty>
+struct ProfilingDeleter {
+    void operator()(Ty* pointer) const {
+        RecordDeallocation(GetAllocationCounter<Ty>(), sizeof(Ty));
+        delete pointer;
+    }
+};
+
+#endif
+
+/**
+ * \return what has been allocated so far in total
+ */
+AllocationStats GetAllocationStats();
+
+/**
+ * \return what has been allocated so far while in phase, a TIME_PHASE or
+ *         TP_COUNT for outside of every phase
+ */
+AllocationStats GetAllocationStats(unsigned phase);
+
+/**
+ * \return what has been allocated so far of type, not counting types
+ *         derived from it
+ */
+AllocationStats GetAllocationStats(const std::type_info& type);
+
+/**
+ * \return the bytes allocated and not yet freed
+ */
+int64_t GetLiveBytes();
+
+/**
+ * \return the most bytes that were live at once since the start of the
+ *         program or the last ResetPeakLiveBytes
+ */
+int64_t GetPeakLiveBytes();
+
+void ResetPeakLiveBytes();
+
+/**
+ * \return a report of the totals, the peak live bytes, and the totals per
+ *         phase and per type, the largest first
+ */
+std::string FormatAllocationReport();
+
+#endif
@@ -1,45 +1,265 @@
 #include "backtracking-lexer.hh"
 #include "lexer.hh"
 #include "syntax.hh"
+#include "time-profiler.hh"
+#include <stdint.h>
+#include <algorithm>
+#include <utility>
 #include <vector>
 
+/**
+ * A live marker when streaming, with the oldest position of any marker
+ * made before it that is still live.
+ */
+struct MARK_ENTRY {
+    size_t Position;
+    size_t OldestPosition;
+};
+
+/**
+ * Tokens [Head, Head + Count) by absolute position, stored at
+ * position & (Ring.size() - 1). The ring only grows while markers pin
+ * tokens the parser has already moved past.
+ */
 struct BACKTRACKING_LEXER_IMPL {
-    std::vector<Rc<SyntaxToken>> tokens{ };
-    BacktrackingLexer::Marker currentPos{ 0 };
+    Rc<ILexer>                   Source{ };
+    BACKTRACKING_LEXER_MODE      Mode{ BLM_EAGER };
+    std::vector<Rc<SyntaxToken>> Ring{ };
+    size_t                       Head{ 0 };
+    size_t                       Count{ 0 };
+    size_t                       CurrentPos{ 0 };
+    /** Set once EofToken has been read; positions past it map to it. */
+    bool                         IsAtEof{ false };
+    size_t                       EofPos{ 0 };
+    /**
+     * Only kept when streaming. The parser releases markers in the reverse
+     * order it makes them, so the newest is the last.
+     */
+    std::vector<MARK_ENTRY>      Marks{ };
+    /** Null to create missing tokens on the heap. */
+    Rc<SyntaxArena>              Arena{ };
 };
 
-BacktrackingLexer::BacktrackingLexer(Rc<ILexer> lexer) :
-    l{ NewChild<BACKTRACKING_LEXER_IMPL>() }
+static constexpr size_t INITIAL_RING_SIZE{ 64 };
+
+static Rc<SyntaxToken>& GetSlot(BACKTRACKING_LEXER_IMPL* l, size_t position) {
+    return l->Ring[position & (l->Ring.size() - 1)];
+}
+
+static void PushToken(BACKTRACKING_LEXER_IMPL* l, const Rc<SyntaxToken>& token) {
+    if (l->Count == l->Ring.size()) {
+        std::vector<Rc<SyntaxToken>> ring(l->Ring.empty() ? INITIAL_RING_SIZE : l->Ring.size() * 2);
+        for (size_t i{ l->Head }; i < l->Head + l->Count; ++i)
+            ring[i & (ring.size() - 1)] = std::move(GetSlot(l, i));
+        l->Ring = std::move(ring);
+    }
+
+    GetSlot(l, l->Head + l->Count) = token;
+    ++l->Count;
+}
+
+/**
+ * Pulls tokens from the source until position is buffered or EofToken has
+ * been read.
+ */
+static void Fill(BACKTRACKING_LEXER_IMPL* l, size_t position) {
+    while (!l->IsAtEof && l->Head + l->Count <= position) {
+        Rc<SyntaxToken> token{ l->Source->ReadToken() };
+        PushToken(l, token);
+
+        if (token->GetKind() == SK_EofToken) {
+            l->IsAtEof = true;
+            l->EofPos = l->Head + l->Count - 1;
+            l->Source = Rc<ILexer>{ };
+        }
+    }
+}
+
+/**
+ * Drops the tokens before both the current position and the oldest marker.
+ */
+static void Trim(BACKTRACKING_LEXER_IMPL* l) {
+    if (l->Mode != BLM_STREAMING)
+        return;
+
+    size_t keepFrom{ l->CurrentPos };
+    if (!l->Marks.empty() && l->Marks.back().OldestPosition < keepFrom)
+        keepFrom = l->Marks.back().OldestPosition;
+
+    while (l->Head < keepFrom && l->Count > 1) {
+        GetSlot(l, l->Head) = Rc<SyntaxToken>{ };
+        ++l->Head;
+        --l->Count;
+    }
+}
+
+static const Rc<SyntaxToken>& GetToken(BACKTRACKING_LEXER_IMPL* l, size_t position) {
+    Fill(l, position);
+    if (l->IsAtEof && position > l->EofPos)
+        position = l->EofPos;
+    return GetSlot(l, position);
+}
+
+BacktrackingLexer::Marker::Marker(BacktrackingLexer* lexer, size_t position) :
+    lexer{ lexer },
+    position{ position }
+{ }
+
+BacktrackingLexer::Marker::Marker(Marker&& other) noexcept :
+    lexer{ other.lexer },
+    position{ other.position }
 {
-    Rc<SyntaxToken> token{ };
-    do {
-        token = lexer->ReadToken();
-        l->tokens.push_back(token);
+    other.lexer = nullptr;
+}
+
+BacktrackingLexer::Marker& BacktrackingLexer::Marker::operator=(Marker&& other) noexcept {
+    if (this != &other) {
+        if (lexer)
+            lexer->ReleaseMark(position);
+        lexer = other.lexer;
+        position = other.position;
+        other.lexer = nullptr;
     }
-    while (!IsSyntaxNode<EofToken>(token));
+    return *this;
+}
+
+BacktrackingLexer::Marker::~Marker() {
+    if (lexer)
+        lexer->ReleaseMark(position);
+}
+
+BacktrackingLexer::BacktrackingLexer(Rc<ILexer> lexer, BACKTRACKING_LEXER_MODE mode) :
+    BacktrackingLexer{ lexer, mode, Rc<SyntaxArena>{ } }
+{ }
+
+BacktrackingLexer::BacktrackingLexer(Rc<ILexer> lexer, BACKTRACKING_LEXER_MODE mode, Rc<SyntaxArena> arena) :
+    l{ NewChild<BACKTRACKING_LEXER_IMPL>() }
+{
+    ScopedTimer timer{ TP_BACKTRACKING_LEXER };
+
+    l->Source = lexer;
+    l->Mode = mode;
+    l->Arena = arena;
 
-    l->tokens.push_back(token);
+    if (mode == BLM_EAGER)
+        Fill(l.get(), SIZE_MAX);
 }
 
 BacktrackingLexer::~BacktrackingLexer() {}
 
 Rc<SyntaxToken> BacktrackingLexer::ReadToken() {
-    Rc<SyntaxToken> token{ l->tokens[l->currentPos] };
+    Rc<SyntaxToken> token{ GetToken(l.get(), l->CurrentPos) };
 
-    if (l->currentPos + 1 < l->tokens.size())
-        ++l->currentPos;
+    if (!l->IsAtEof || l->CurrentPos < l->EofPos) {
+        ++l->CurrentPos;
+        Trim(l.get());
+    }
 
     return token;
 }
 
 Rc<SyntaxToken> BacktrackingLexer::PeekToken() {
-    return l->tokens[l->currentPos];
+    return GetToken(l.get(), l->CurrentPos);
+}
+
+SYNTAX_KIND BacktrackingLexer::PeekKind() {
+    return GetToken(l.get(), l->CurrentPos)->GetKind();
 }
 
 BacktrackingLexer::Marker BacktrackingLexer::Mark() {
-    return l->currentPos;
+    // Nothing is dropped from an eager buffer, so its markers need no
+    // releasing.
+    if (l->Mode != BLM_STREAMING)
+        return Marker{ nullptr, l->CurrentPos };
+
+    size_t oldest{ l->Marks.empty() ? l->CurrentPos : std::min(l->CurrentPos, l->Marks.back().OldestPosition) };
+    l->Marks.push_back(MARK_ENTRY{ l->CurrentPos, oldest });
+    return Marker{ this, l->CurrentPos };
 }
 
 void BacktrackingLexer::Backtrack(const Marker& to) {
-    l->currentPos = to;
-}
\ No newline at end of file
+    l->CurrentPos = to.position;
+}
+
+size_t BacktrackingLexer::GetPosition() const {
+    return l->CurrentPos;
+}
+
+void BacktrackingLexer::SkipTo(size_t position) {
+    l->CurrentPos = position;
+    Trim(l.get());
+}
+
+bool BacktrackingLexer::SkipBalanced() {
+    SYNTAX_KIND open{ PeekKind() };
+    SYNTAX_KIND close{ };
+
+    switch (open) {
+    case SK_LBraceSymbol:   close = SK_RBraceSymbol;   break;
+    case SK_LBracketSymbol: close = SK_RBracketSymbol; break;
+    case SK_LParenSymbol:   close = SK_RParenSymbol;   break;
+    default:                return false;
+    }
+
+    // Only the outer kind is counted; a stray closer of another kind
+    // inside the group is left for whoever parses it.
+    size_t depth{ 0 };
+
+    for (size_t position{ l->CurrentPos }; ; ++position) {
+        SYNTAX_KIND kind{ GetToken(l.get(), position)->GetKind() };
+
+        if (kind == open) {
+            ++depth;
+        }
+        else if (kind == close && --depth == 0) {
+            SkipTo(position + 1);
+            return true;
+        }
+        else if (kind == SK_EofToken) {
+            return false;
+        }
+    }
+}
+
+std::vector<Rc<SyntaxToken>> BacktrackingLexer::GetTokens(size_t begin, size_t end) {
+    std::vector<Rc<SyntaxToken>> tokens{ };
+    tokens.reserve(end - begin);
+
+    for (size_t position{ begin }; position < end; ++position)
+        tokens.push_back(GetToken(l.get(), position));
+
+    return tokens;
+}
+
+const Rc<SyntaxArena>& BacktrackingLexer::GetArena() const {
+    return l->Arena;
+}
+
+size_t BacktrackingLexer::GetBufferedTokenCount() const {
+    return l->Count;
+}
+
+void BacktrackingLexer::ReleaseMark(size_t position) {
+    std::vector<MARK_ENTRY>& marks{ l->Marks };
+
+    if (!marks.empty() && marks.back().Position == position) {
+        marks.pop_back();
+    }
+    else {
+        // Out of order, e.g. a marker assigned over; the entries after the
+        // released one get their oldest positions recomputed.
+        size_t index{ marks.size() };
+        while (index > 0 && marks[index - 1].Position != position)
+            --index;
+        if (index == 0)
+            return;
+
+        marks.erase(marks.begin() + (index - 1));
+        for (size_t i{ index - 1 }; i < marks.size(); ++i) {
+            size_t previous{ i == 0 ? SIZE_MAX : marks[i - 1].OldestPosition };
+            marks[i].OldestPosition = std::min(marks[i].Position, previous);
+        }
+    }
+
+    Trim(l.get());
+}
@@ -2,15 +2,51 @@
 #define COMBUST_BACKTRACKING_LEXER_HH
 #include "common.hh"
 #include "lexer.hh"
+#include "syntax-arena.hh"
 #include "syntax.hh"
+#include <stddef.h>
+#include <vector>
 
 struct BACKTRACKING_LEXER_IMPL;
 
-class BacktrackingLexer : public Object, public virtual ILexer {
+enum BACKTRACKING_LEXER_MODE {
+    /** Reads every token up front and keeps them all. */
+    BLM_EAGER,
+    /**
+     * Reads tokens as the parser reaches them and keeps only those it can
+     * still backtrack to.
+     */
+    BLM_STREAMING
+};
+
+class BacktrackingLexer : public ILexer {
 public:
-    using Marker = size_t;
+    /**
+     * A position Backtrack can return to. Tokens from the oldest live
+     * marker onwards stay buffered; destroying a marker releases them.
+     */
+    class Marker {
+    public:
+        Marker(Marker&& other) noexcept;
+        Marker& operator=(Marker&& other) noexcept;
+        ~Marker();
+
+    private:
+        friend class BacktrackingLexer;
+        explicit Marker(BacktrackingLexer* lexer, size_t position);
+        Marker(const Marker&) = delete;
+        Marker& operator=(const Marker&) = delete;
+
+        BacktrackingLexer* lexer{ nullptr };
+        size_t             position{ 0 };
+    };
 
-    explicit BacktrackingLexer(Rc<ILexer> lexer);
+    explicit BacktrackingLexer(Rc<ILexer> lexer, BACKTRACKING_LEXER_MODE mode = BLM_EAGER);
+    /**
+     * Creates the missing tokens Materialize returns in arena, e.g. the one
+     * the parser puts its nodes in.
+     */
+    BacktrackingLexer(Rc<ILexer> lexer, BACKTRACKING_LEXER_MODE mode, Rc<SyntaxArena> arena);
     virtual ~BacktrackingLexer();
 
     Rc<SyntaxToken> ReadToken() override;
@@ -18,38 +54,117 @@ public:
     Marker Mark();
     void Backtrack(const Marker& to);
 
+    /**
+     * \return the index of the next token in the stream
+     */
+    size_t GetPosition() const;
+
+    /**
+     * Moves forward to a position that has been read before and is still
+     * buffered, e.g. the end of a memoized parse that started at a marker.
+     */
+    void SkipTo(size_t position);
+
+    /**
+     * Consumes the group opened by the next token, a '{', '[' or '(', up to
+     * and including its matching closer, without looking inside.
+     *
+     * \return false, consuming nothing, if the next token opens no group or
+     *         the group is still open at EofToken
+     */
+    bool SkipBalanced();
+
+    /**
+     * \return the tokens from begin up to but not including end, which must
+     *         still be buffered (held by a marker when streaming)
+     */
+    std::vector<Rc<SyntaxToken>> GetTokens(size_t begin, size_t end);
+
+    /**
+     * \return the number of tokens currently held
+     */
+    size_t GetBufferedTokenCount() const;
+
+    /**
+     * \return the kind of the next token without taking a reference to it
+     */
+    SYNTAX_KIND PeekKind();
+
+    /**
+     * Consumes the next token if it is one of the given classes.
+     *
+     * \return the token, or nullptr if it is of another class
+     */
+    template<typename... Types>
+    [[nodiscard]] Rc<SyntaxToken> Accept() {
+        static constexpr SyntaxKindSet kinds{ SyntaxKindSet::Of<Types...>() };
+
+        if (!kinds.Contains(PeekKind()))
+            return Rc<SyntaxToken>{ };
+        return ReadToken();
+    }
+
     template<typename T>
     [[nodiscard]] Rc<SyntaxToken> AcceptSingle() {
-        Rc<SyntaxToken> token{ PeekToken() };
-        if (IsSyntaxNode<T>(token)) {
-            ReadToken();
-            return token;
-        }
-        return Rc<SyntaxToken>{ };
+        return Accept<T>();
     }
 
-    template<typename First, typename... Types>
-    [[nodiscard]] Rc<SyntaxToken> Accept() {
-        if constexpr (sizeof...(Types) > 0) {
-            if (Rc<SyntaxToken> token{ AcceptSingle<First>() }; token)
-                return token;
-            return Accept<Types...>();
-        }
-        else {
-            return AcceptSingle<First>();
-        }
+    /**
+     * Consumes the next token if it is a T.
+     *
+     * \return the token, or if the next token is of another class, a T
+     *         flagged IS_MISSING that is shared by every failed Expect<T>
+     *         and has no location; Materialize makes one of its own
+     */
+    template<typename T>
+    [[nodiscard]] Rc<SyntaxToken> Expect() {
+        if (Rc<SyntaxToken> token{ Accept<T>() }; token)
+            return token;
+        return GetMissingToken<T>();
     }
 
+    /**
+     * Gives a missing token from Expect<T> a node of its own, e.g. before it
+     * is put into a tree.
+     *
+     * \return token itself if it is not the placeholder Expect<T> returns,
+     *         or else a new T flagged IS_MISSING, in the lexer's arena, with
+     *         an empty range where the next token starts
+     */
     template<typename T>
-    [[nodiscard]] Rc<SyntaxToken> Expect() {
-        if (Rc<SyntaxToken> token{ AcceptSingle<T>() }; token)
+    [[nodiscard]] Rc<SyntaxToken> Materialize(const Rc<SyntaxToken>& token) {
+        if (token != GetMissingToken<T>())
             return token;
-        Rc<T> missingToken{ NewObj<T>() };
+
+        Rc<SyntaxToken> missingToken{ NewToken<T>(GetArena()) };
         missingToken->SetFlag(SyntaxToken::IS_MISSING);
+
+        SourceRange range{ PeekToken()->GetLexemeRange() };
+        range.Length = 0;
+        missingToken->SetLexemeRange(range);
+
         return missingToken;
     }
 
 private:
+    void ReleaseMark(size_t position);
+    const Rc<SyntaxArena>& GetArena() const;
+
+    /**
+     * \return the placeholder for a missing T, shared between threads
+     */
+    template<typename T>
+    static const Rc<SyntaxToken>& GetMissingToken() {
+        static const Rc<SyntaxToken> missingToken{ [] {
+            Rc<SyntaxToken> token{ NewObj<T>() };
+            token->SetFlag(SyntaxToken::IS_MISSING);
+            token->MarkShared();
+            return token;
+        }() };
+
+        return missingToken;
+    }
+
     Owner<BACKTRACKING_LEXER_IMPL> l;
 };
 
@@ -0,0 +1,206 @@
+#include "../backtracking-lexer.hh"
+#include "../code-lexer.hh"
+#include "../language-parser.hh"
+#include "../logger.hh"
+#include "../parallel.hh"
+#include "../source.hh"
+#include "../syntax.hh"
+#include "../token-cache.hh"
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+/*
+ * Parses expressions nested ever more deeply and reports the time per
+ * token, which stays flat while parsing is linear in the input.
+ */
+
+char* g_ProgramName;
+
+static constexpr int REPETITIONS = 20;
+
+static std::vector<Rc<SyntaxToken>> LexAll(const std::string& contents) {
+    Rc<SourceFile> sourceFile{ CreateSourceFile("bench.c", contents) };
+    CodeLexer lexer{ sourceFile };
+    std::vector<Rc<SyntaxToken>> tokens{ };
+
+    do {
+        tokens.push_back(lexer.ReadToken());
+    }
+    while (tokens.back()->GetKind() != SK_EofToken);
+
+    return tokens;
+}
+
+/**
+ * \return the fastest of several parses, in nanoseconds
+ */
+static double TimeParse(const std::vector<Rc<SyntaxToken>>& tokens, const ParserOptions& options) {
+    double best{ 0 };
+
+    for (int i{ 0 }; i < REPETITIONS; ++i) {
+        Rc<BacktrackingLexer> lexer{ NewObj<BacktrackingLexer>(NewObj<TokenListLexer>(tokens)) };
+
+        auto start{ std::chrono::steady_clock::now() };
+        Rc<Expression> expression{ ParseExpression(lexer, options) };
+        auto end{ std::chrono::steady_clock::now() };
+
+        double elapsed{ std::chrono::duration<double, std::nano>(end - start).count() };
+        if (i == 0 || elapsed < best)
+            best = elapsed;
+    }
+
+    return best;
+}
+
+static void RunCase(const char* name, std::string (*makeInput)(int depth), int maxDepth = 2048) {
+    printf("%s\n", name);
+    printf("  %8s %8s %14s %14s\n", "depth", "tokens", "ns/token", "ns/token memo");
+
+    for (int depth{ 128 }; depth <= maxDepth; depth *= 2) {
+        std::vector<Rc<SyntaxToken>> tokens{ LexAll(makeInput(depth)) };
+
+        ParserOptions plain{ };
+        ParserOptions memoizing{ };
+        memoizing.ShouldMemoize = true;
+
+        double count{ static_cast<double>(tokens.size()) };
+        printf(
+            "  %8d %8zu %14.1f %14.1f\n",
+            depth,
+            tokens.size(),
+            TimeParse(tokens, plain) / count,
+            TimeParse(tokens, memoizing) / count
+        );
+    }
+}
+
+static std::string MakeBalanced(int depth) {
+    return std::string(depth, '(') + "x" + std::string(depth, ')');
+}
+
+static std::string MakeUnclosed(int depth) {
+    return std::string(depth, '(') + "x";
+}
+
+static std::string MakeSubscripts(int depth) {
+    std::string nested{ "x" };
+    for (int i{ 0 }; i < depth; ++i)
+        nested = "a[" + nested + "]";
+    return nested;
+}
+
+static std::vector<Rc<DeferredBody>> DeferAll(const std::vector<Rc<SyntaxToken>>& tokens) {
+    Rc<BacktrackingLexer> lexer{ NewObj<BacktrackingLexer>(NewObj<TokenListLexer>(tokens)) };
+    std::vector<Rc<DeferredBody>> bodies{ };
+    while (Rc<DeferredBody> body{ DeferBody(lexer, ParseExpression) })
+        bodies.push_back(body);
+
+    return bodies;
+}
+
+static std::string MakeSmallBody(int, int) {
+    return "{ a = b * (c + d) ? e[f] : g[h] - i } ";
+}
+
+/**
+ * \return small bodies but for the last hundredth, each a long chain of
+ *         additions, so that they all fall to the last thread's share
+ */
+static std::string MakeSkewedBody(int index, int bodyCount) {
+    if (index < bodyCount - bodyCount / 100)
+        return MakeSmallBody(index, bodyCount);
+
+    std::string body{ "{ x" };
+    for (int i{ 0 }; i < 4000; ++i)
+        body += "+x";
+    return body + " } ";
+}
+
+/**
+ * Times ParseDeferredBodies over the bodies makeBody gives for each index,
+ * with one thread and with every thread available.
+ */
+static void RunBodiesCase(const char* name, std::string (*makeBody)(int index, int bodyCount), int bodyCount) {
+    std::string source{ };
+    for (int i{ 0 }; i < bodyCount; ++i)
+        source += makeBody(i, bodyCount);
+
+    std::vector<Rc<SyntaxToken>> tokens{ LexAll(source) };
+
+    // Timing bodies the parser gives up on would measure the wrong thing.
+    std::vector<Rc<DeferredBody>> checked{ DeferAll(tokens) };
+    ParseDeferredBodies(checked, 1);
+    if (checked.size() != static_cast<size_t>(bodyCount)) {
+        fprintf(stderr, "%s: %zu of %d bodies found\n", name, checked.size(), bodyCount);
+        exit(EXIT_FAILURE);
+    }
+    for (const Rc<DeferredBody>& body : checked) {
+        if (!body->IsComplete()) {
+            fprintf(stderr, "%s: a body does not parse completely\n", name);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    unsigned threadCounts[]{ 1, GetDefaultThreadCount() };
+
+    printf("%s\n", name);
+    printf("  %8s %8s %14s\n", "bodies", "threads", "ns/body");
+
+    for (unsigned threadCount : threadCounts) {
+        double best{ 0 };
+
+        for (int i{ 0 }; i < REPETITIONS; ++i) {
+            std::vector<Rc<DeferredBody>> bodies{ DeferAll(tokens) };
+
+            auto start{ std::chrono::steady_clock::now() };
+            ParseDeferredBodies(bodies, threadCount);
+            auto end{ std::chrono::steady_clock::now() };
+
+            double elapsed{ std::chrono::duration<double, std::nano>(end - start).count() };
+            if (i == 0 || elapsed < best)
+                best = elapsed;
+        }
+
+        printf("  %8d %8u %14.1f\n", bodyCount, threadCount, best / bodyCount);
+    }
+}
+
+static std::string MakeLeftChain(int length) {
+    std::string chain{ "x" };
+    for (int i{ 0 }; i < length; ++i)
+        chain += "+x";
+    return chain;
+}
+
+static std::string MakeRightChain(int length) {
+    std::string chain{ "x" };
+    for (int i{ 0 }; i < length; ++i)
+        chain += "=x";
+    return chain;
+}
+
+static std::string MakeUnaryChain(int length) {
+    std::string chain{ };
+    for (int i{ 0 }; i < length; ++i)
+        chain += "- ";
+    return chain + "x";
+}
+
+int main(int, char** argv) {
+    g_ProgramName = argv[0];
+
+    // Nesting no longer recurses natively, so the worst cases run well
+    // past the depth that used to exhaust the stack.
+    RunCase("balanced parentheses", MakeBalanced, 32768);
+    RunCase("unclosed parentheses", MakeUnclosed);
+    RunCase("nested subscripts", MakeSubscripts, 65536);
+    RunCase("left-associative chain", MakeLeftChain, 65536);
+    RunCase("right-associative chain", MakeRightChain, 65536);
+    RunCase("unary chain", MakeUnaryChain, 65536);
+    RunBodiesCase("deferred bodies", MakeSmallBody, 40000);
+    RunBodiesCase("deferred bodies, long ones last", MakeSkewedBody, 40000);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,253 @@
+#if defined(_WIN32)
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+#include "binary-format.hh"
+#include <stdio.h>
+#include <string.h>
+#include <functional>
+#include <thread>
+
+constexpr uint64_t FNV_PRIME{ 0x100000001B3ULL };
+
+uint32_t StringTableBuilder::Add(const std::string& value) {
+    auto it{ indices.find(value) };
+    if (it != indices.end())
+        return it->second;
+
+    uint32_t index{ static_cast<uint32_t>(Strings.size()) };
+    Strings.push_back({ static_cast<uint32_t>(Data.size()), static_cast<uint32_t>(value.size()) });
+    Data += value;
+    indices.emplace(value, index);
+    return index;
+}
+
+void AppendBytes(IN_OUT std::string& buffer, const void* data, size_t size) {
+    buffer.append(static_cast<const char*>(data), size);
+}
+
+void AppendVarint(IN_OUT std::string& buffer, uint32_t value) {
+    while (value >= 0x80) {
+        buffer += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    buffer += static_cast<char>(value);
+}
+
+bool ReadVarint(IN_OUT const char*& cursor, const char* end, OUT uint32_t& value) {
+    value = 0;
+
+    for (int shift{ 0 }; cursor != end && shift < 32; shift += 7) {
+        uint8_t byte{ static_cast<uint8_t>(*cursor++) };
+        if (shift == 28 && byte > 0x0F)
+            return false;
+
+        value |= uint32_t{ byte & 0x7Fu } << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+bool ReplaceFile(const std::string& path, const std::string& contents) {
+    std::string temporaryPath{
+        path + "." + std::to_string(std::hash<std::thread::id>{ }(std::this_thread::get_id())) + ".tmp"
+    };
+
+    FILE* file{ fopen(temporaryPath.c_str(), "wb") };
+    if (file == nullptr)
+        return false;
+
+    bool succeeded{ fwrite(contents.data(), 1, contents.size(), file) == contents.size() };
+    succeeded = fclose(file) == 0 && succeeded;
+
+#if defined(_WIN32)
+    if (succeeded)
+        remove(path.c_str());
+#endif
+    if (!succeeded || rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        remove(temporaryPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool ReadStringTable(
+    const char*                   records,
+    uint32_t                      count,
+    const char*                   data,
+    uint64_t                      dataSize,
+    OUT std::vector<std::string>& strings
+) {
+    strings.resize(count);
+
+    for (uint32_t i{ 0 }; i < count; ++i) {
+        STRING_RECORD string{ };
+        memcpy(&string, records + i * sizeof(STRING_RECORD), sizeof(string));
+
+        if (uint64_t{ string.Offset } + string.Length > dataSize)
+            return false;
+        strings[i].assign(data + string.Offset, string.Length);
+    }
+
+    return true;
+}
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t hash) {
+    const unsigned char* bytes{ static_cast<const unsigned char*>(data) };
+    for (size_t i{ 0 }; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+uint64_t GetSyntaxSchemaHash() {
+    static const uint64_t schemaHash{ [] {
+        uint64_t hash{ FNV_OFFSET_BASIS };
+#define O(className) hash = HashBytes(#className, sizeof(#className), hash)
+#define Sn(className) O(className)
+#define Tk(className) O(className)
+#include "syntax-kinds.def"
+#undef Tk
+#undef Sn
+#undef O
+        return hash;
+    }() };
+
+    return schemaHash;
+}
+
+uint32_t GetTokenOperandCount(SYNTAX_KIND kind) {
+    switch (kind) {
+    case SK_InvalidDirective:
+    case SK_IdentifierToken:
+    case SK_StringLiteralToken:
+        return 1;
+    case SK_CommentToken:
+        return 3;
+    case SK_NumericLiteralToken:
+        return 5;
+    default:
+        return 0;
+    }
+}
+
+TOKEN_RECORD EncodeToken(
+    const Rc<SyntaxToken>&        token,
+    IN_OUT StringTableBuilder&    strings,
+    IN_OUT std::vector<uint32_t>& operands
+) {
+    const SourceRange& range{ token->GetLexemeRange() };
+
+    TOKEN_RECORD record{ };
+    record.Kind         = token->GetKind();
+    record.Flags        = token->GetFlags();
+    record.Line         = range.Location.Line;
+    record.Column       = range.Location.Column;
+    record.Length       = range.Length;
+    record.FirstOperand = static_cast<uint32_t>(operands.size());
+
+    switch (token->GetKind()) {
+    case SK_InvalidDirective:
+        operands.push_back(strings.Add(As<InvalidDirective>(token)->GetName()));
+        break;
+    case SK_StrayToken:
+        record.Chars[0] = As<StrayToken>(token)->GetOffendingChar();
+        break;
+    case SK_CommentToken: {
+        Rc<CommentToken> comment{ As<CommentToken>(token) };
+        operands.push_back(strings.Add(comment->GetContents()));
+        operands.push_back(strings.Add(comment->GetOpeningToken()));
+        operands.push_back(strings.Add(comment->GetClosingToken()));
+        break;
+    }
+    case SK_IdentifierToken:
+        operands.push_back(strings.Add(As<IdentifierToken>(token)->GetName()));
+        break;
+    case SK_NumericLiteralToken: {
+        Rc<NumericLiteralToken> literal{ As<NumericLiteralToken>(token) };
+        operands.push_back(strings.Add(literal->GetWholeValue()));
+        operands.push_back(strings.Add(literal->GetFractionalValue()));
+        operands.push_back(strings.Add(literal->GetDotSymbol()));
+        operands.push_back(strings.Add(literal->GetPrefix()));
+        operands.push_back(strings.Add(literal->GetSuffix()));
+        break;
+    }
+    case SK_StringLiteralToken: {
+        Rc<StringLiteralToken> literal{ As<StringLiteralToken>(token) };
+        operands.push_back(strings.Add(literal->GetValue()));
+        record.Chars[0] = literal->GetOpeningQuote();
+        record.Chars[1] = literal->GetClosingQuote();
+        break;
+    }
+    default:
+        break;
+    }
+
+    return record;
+}
+
+Rc<SyntaxToken> DecodeToken(
+    const TOKEN_RECORD&             record,
+    const uint32_t*                 operands,
+    const std::vector<std::string>& strings
+) {
+    Rc<SyntaxToken> token{ NewSyntaxToken(record.Kind) };
+    const uint32_t* operand{ operands + record.FirstOperand };
+
+    switch (record.Kind) {
+    case SK_InvalidDirective:
+        As<InvalidDirective>(token)->SetName(strings[operand[0]]);
+        break;
+    case SK_StrayToken:
+        As<StrayToken>(token)->SetOffendingChar(record.Chars[0]);
+        break;
+    case SK_CommentToken: {
+        Rc<CommentToken> comment{ As<CommentToken>(token) };
+        comment->SetContents(strings[operand[0]]);
+        comment->SetOpeningToken(strings[operand[1]]);
+        comment->SetClosingToken(strings[operand[2]]);
+        break;
+    }
+    case SK_IdentifierToken:
+        As<IdentifierToken>(token)->SetName(strings[operand[0]]);
+        break;
+    case SK_NumericLiteralToken: {
+        Rc<NumericLiteralToken> literal{ As<NumericLiteralToken>(token) };
+        literal->SetWholeValue(strings[operand[0]]);
+        literal->SetFractionalValue(strings[operand[1]]);
+        literal->SetDotSymbol(strings[operand[2]]);
+        literal->SetPrefix(strings[operand[3]]);
+        literal->SetSuffix(strings[operand[4]]);
+        break;
+    }
+    case SK_StringLiteralToken: {
+        Rc<StringLiteralToken> literal{ As<StringLiteralToken>(token) };
+        literal->SetValue(strings[operand[0]]);
+        literal->SetOpeningQuote(record.Chars[0]);
+        literal->SetClosingQuote(record.Chars[1]);
+        break;
+    }
+    default:
+        break;
+    }
+
+    SourceRange range{ };
+    range.Location.Line   = record.Line;
+    range.Location.Column = record.Column;
+    range.Length          = record.Length;
+
+    token->SetLexemeRange(range);
+    token->SetFlags(record.Flags);
+    return token;
+}
+
+bool IsValidTokenRecord(const TOKEN_RECORD& record, uint64_t operandCount) {
+    return IsSyntaxTokenKind(record.Kind)
+        && uint64_t{ record.FirstOperand } + GetTokenOperandCount(record.Kind) <= operandCount
+        && record.Line >= 0
+        && record.Column >= 0
+        && record.Length >= 0;
+}
@@ -0,0 +1,134 @@
+#ifndef COMBUST_BINARY_FORMAT_HH
+#define COMBUST_BINARY_FORMAT_HH
+#include "common.hh"
+#include "syntax.hh"
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Building blocks of the on-disk formats (the token cache and precompiled
+ * headers). Everything is stored in host byte order and referenced by
+ * index, never by pointer, so files can be mapped and used in place.
+ */
+
+/**
+ * Fixed-size form of a token. Strings a token
+ * carries are stored as a run of operands, each an index into a string
+ * table, starting at FirstOperand.
+ */
+struct TOKEN_RECORD {
+    uint16_t Kind;
+    char     Chars[2];
+    uint32_t Flags;
+    int32_t  Line;
+    int32_t  Column;
+    int32_t  Length;
+    uint32_t FirstOperand;
+};
+static_assert(sizeof(TOKEN_RECORD) == 24, "token records must stay fixed-size");
+
+struct STRING_RECORD {
+    uint32_t Offset;
+    uint32_t Length;
+};
+
+/**
+ * Collects the strings of the records being written, storing each distinct
+ * string once.
+ */
+class StringTableBuilder {
+public:
+    uint32_t Add(const std::string& value);
+
+    std::vector<STRING_RECORD> Strings{ };
+    std::string                Data{ };
+
+private:
+    std::unordered_map<std::string, uint32_t> indices{ };
+};
+
+constexpr uint64_t FNV_OFFSET_BASIS{ 0xCBF29CE484222325ULL };
+
+void AppendBytes(IN_OUT std::string& buffer, const void* data, size_t size);
+
+/**
+ * Appends value as a varint: seven bits per byte, least significant first,
+ * with the top bit set on every byte but the last.
+ */
+void AppendVarint(IN_OUT std::string& buffer, uint32_t value);
+
+/**
+ * Reads a varint written by AppendVarint, advancing cursor past it.
+ *
+ * \return false if the varint runs past end or does not fit in 32 bits
+ */
+bool ReadVarint(IN_OUT const char*& cursor, const char* end, OUT uint32_t& value);
+
+/**
+ * Writes contents to a private file next to path and renames it over path,
+ * so readers never see a partially written file.
+ *
+ * \return false if the file cannot be written
+ */
+bool ReplaceFile(const std::string& path, const std::string& contents);
+
+/**
+ * Reads count STRING_RECORDs and the characters they index.
+ *
+ * \return false if a record points outside of the dataSize characters
+ */
+bool ReadStringTable(
+    const char*                   records,
+    uint32_t                      count,
+    const char*                   data,
+    uint64_t                      dataSize,
+    OUT std::vector<std::string>& strings
+);
+
+/**
+ * \return the 64-bit FNV-1a hash of data, continuing from hash
+ */
+uint64_t HashBytes(const void* data, size_t size, uint64_t hash = FNV_OFFSET_BASIS);
+
+/**
+ * \return a hash of the syntax kind names in declaration order; formats
+ *         storing kinds use it to reject data written before
+ *         syntax-kinds.def changed
+ */
+uint64_t GetSyntaxSchemaHash();
+
+/**
+ * \return the number of operands a record of the given kind has
+ */
+uint32_t GetTokenOperandCount(SYNTAX_KIND kind);
+
+/**
+ * Encodes token, appending its strings to strings and operands.
+ */
+TOKEN_RECORD EncodeToken(
+    const Rc<SyntaxToken>&        token,
+    IN_OUT StringTableBuilder&    strings,
+    IN_OUT std::vector<uint32_t>& operands
+);
+
+/**
+ * Rebuilds the token a record describes. The record must have been
+ * validated: its kind names a token class and its operands index strings.
+ * The lexeme range's Source is left for the caller to fill in.
+ */
+Rc<SyntaxToken> DecodeToken(
+    const TOKEN_RECORD&             record,
+    const uint32_t*                 operands,
+    const std::vector<std::string>& strings
+);
+
+/**
+ * \return false if the record cannot be decoded against operandCount
+ *         operands
+ */
+bool IsValidTokenRecord(const TOKEN_RECORD& record, uint64_t operandCount);
+
+#endif
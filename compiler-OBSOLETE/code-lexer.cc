@@ -4,6 +4,7 @@
 #include "code-lexer.hh"
 #include "logger.hh"
 #include "source.hh"
+#include "syntax-arena.hh"
 #include "syntax.hh"
 #include <cassert>
 #include <cstdint>
@@ -18,14 +19,21 @@ struct CODE_LEXER_IMPL {
     int                  CurrentFlags{ 0 };
     SourceLoc            CurrentLocation{ };
     Rc<SyntaxToken>      CurrentToken{ };
+    /** Null to create tokens on the heap. */
+    Rc<SyntaxArena>      Arena{ };
 };
 
 CodeLexer::CodeLexer(Rc<const SourceFile> input) :
+    CodeLexer{ input, Rc<SyntaxArena>{ } }
+{ }
+
+CodeLexer::CodeLexer(Rc<const SourceFile> input, Rc<SyntaxArena> arena) :
     l{ NewChild<CODE_LEXER_IMPL>() }
 {
     l->Source                 = input;
     l->CurrentFlags           = SyntaxToken::BEGINNING_OF_LINE;
     l->CurrentLocation.Source = l->Source;
+    l->Arena                  = arena;
 }
 
 CodeLexer::~CodeLexer() {}
@@ -286,40 +294,40 @@ Rc<SyntaxToken> CodeLexer::ReadIdentifierOrKeyword_Internal() {
     }
 
 #define o(kw) (name == kw)
-         if (o("const"))    result = NewObj<ConstKeyword>();
-    else if (o("extern"))   result = NewObj<ExternKeyword>();
-    else if (o("static"))   result = NewObj<StaticKeyword>();
-    else if (o("auto"))     result = NewObj<AutoKeyword>();
-    else if (o("volatile")) result = NewObj<VolatileKeyword>();
-    else if (o("unsigned")) result = NewObj<UnsignedKeyword>();
-    else if (o("signed"))   result = NewObj<SignedKeyword>();
-    else if (o("void"))     result = NewObj<VoidKeyword>();
-    else if (o("char"))     result = NewObj<CharKeyword>();
-    else if (o("short"))    result = NewObj<ShortKeyword>();
-    else if (o("int"))      result = NewObj<IntKeyword>();
-    else if (o("long"))     result = NewObj<LongKeyword>();
-    else if (o("float"))    result = NewObj<FloatKeyword>();
-    else if (o("double"))   result = NewObj<DoubleKeyword>();
-    else if (o("enum"))     result = NewObj<EnumKeyword>();
-    else if (o("struct"))   result = NewObj<StructKeyword>();
-    else if (o("union"))    result = NewObj<UnionKeyword>();
-    else if (o("typedef"))  result = NewObj<TypeDefKeyword>();
-    else if (o("sizeof"))   result = NewObj<SizeOfKeyword>();
-    else if (o("register")) result = NewObj<RegisterKeyword>();
-    else if (o("goto"))     result = NewObj<GotoKeyword>();
-    else if (o("if"))       result = NewObj<IfKeyword>();
-    else if (o("else"))     result = NewObj<ElseKeyword>();
-    else if (o("switch"))   result = NewObj<SwitchKeyword>();
-    else if (o("case"))     result = NewObj<CaseKeyword>();
-    else if (o("default"))  result = NewObj<DefaultKeyword>();
-    else if (o("do"))       result = NewObj<DoKeyword>();
-    else if (o("while"))    result = NewObj<WhileKeyword>();
-    else if (o("for"))      result = NewObj<ForKeyword>();
-    else if (o("break"))    result = NewObj<BreakKeyword>();
-    else if (o("continue")) result = NewObj<ContinueKeyword>();
-    else if (o("return"))   result = NewObj<ReturnKeyword>();
+         if (o("const"))    result = NewToken<ConstKeyword>(l->Arena);
+    else if (o("extern"))   result = NewToken<ExternKeyword>(l->Arena);
+    else if (o("static"))   result = NewToken<StaticKeyword>(l->Arena);
+    else if (o("auto"))     result = NewToken<AutoKeyword>(l->Arena);
+    else if (o("volatile")) result = NewToken<VolatileKeyword>(l->Arena);
+    else if (o("unsigned")) result = NewToken<UnsignedKeyword>(l->Arena);
+    else if (o("signed"))   result = NewToken<SignedKeyword>(l->Arena);
+    else if (o("void"))     result = NewToken<VoidKeyword>(l->Arena);
+    else if (o("char"))     result = NewToken<CharKeyword>(l->Arena);
+    else if (o("short"))    result = NewToken<ShortKeyword>(l->Arena);
+    else if (o("int"))      result = NewToken<IntKeyword>(l->Arena);
+    else if (o("long"))     result = NewToken<LongKeyword>(l->Arena);
+    else if (o("float"))    result = NewToken<FloatKeyword>(l->Arena);
+    else if (o("double"))   result = NewToken<DoubleKeyword>(l->Arena);
+    else if (o("enum"))     result = NewToken<EnumKeyword>(l->Arena);
+    else if (o("struct"))   result = NewToken<StructKeyword>(l->Arena);
+    else if (o("union"))    result = NewToken<UnionKeyword>(l->Arena);
+    else if (o("typedef"))  result = NewToken<TypeDefKeyword>(l->Arena);
+    else if (o("sizeof"))   result = NewToken<SizeOfKeyword>(l->Arena);
+    else if (o("register")) result = NewToken<RegisterKeyword>(l->Arena);
+    else if (o("goto"))     result = NewToken<GotoKeyword>(l->Arena);
+    else if (o("if"))       result = NewToken<IfKeyword>(l->Arena);
+    else if (o("else"))     result = NewToken<ElseKeyword>(l->Arena);
+    else if (o("switch"))   result = NewToken<SwitchKeyword>(l->Arena);
+    else if (o("case"))     result = NewToken<CaseKeyword>(l->Arena);
+    else if (o("default"))  result = NewToken<DefaultKeyword>(l->Arena);
+    else if (o("do"))       result = NewToken<DoKeyword>(l->Arena);
+    else if (o("while"))    result = NewToken<WhileKeyword>(l->Arena);
+    else if (o("for"))      result = NewToken<ForKeyword>(l->Arena);
+    else if (o("break"))    result = NewToken<BreakKeyword>(l->Arena);
+    else if (o("continue")) result = NewToken<ContinueKeyword>(l->Arena);
+    else if (o("return"))   result = NewToken<ReturnKeyword>(l->Arena);
     else {
-        Rc<IdentifierToken> identifier{ NewObj<IdentifierToken>() };
+        Rc<IdentifierToken> identifier{ NewToken<IdentifierToken>(l->Arena) };
         identifier->SetName(name);
         result = identifier;
     }
@@ -329,7 +337,7 @@ Rc<SyntaxToken> CodeLexer::ReadIdentifierOrKeyword_Internal() {
 }
 
 Rc<NumericLiteralToken> CodeLexer::ReadHexLiteral_Internal() {
-    Rc<NumericLiteralToken> result{ NewObj<NumericLiteralToken>() };
+    Rc<NumericLiteralToken> result{ NewToken<NumericLiteralToken>(l->Arena) };
     std::string wholeValue{ };
     std::string suffix{ };
 
@@ -350,7 +358,7 @@ Rc<NumericLiteralToken> CodeLexer::ReadHexLiteral_Internal() {
 }
 
 Rc<NumericLiteralToken> CodeLexer::ReadDecimalOrOctalLiteral_Internal() {
-    Rc<NumericLiteralToken> result{ NewObj<NumericLiteralToken>() };
+    Rc<NumericLiteralToken> result{ NewToken<NumericLiteralToken>(l->Arena) };
     std::string wholeValue{ };
     std::string fractionalValue{ };
     std::string suffix{ };
@@ -400,7 +408,7 @@ Rc<StringLiteralToken> CodeLexer::ReadStringLiteral_Internal(
     if (GetChar() != openingQuote)
         return Rc<StringLiteralToken>{ };
 
-    Rc<StringLiteralToken> result{ NewObj<StringLiteralToken>() };
+    Rc<StringLiteralToken> result{ NewToken<StringLiteralToken>(l->Arena) };
     result->SetOpeningQuote(GetChar());
     IncrementCursor();
 
@@ -429,7 +437,7 @@ Rc<CommentToken> CodeLexer::ReadComment_Internal() {
 
     IncrementCursor();
 
-    Rc<CommentToken> result{ NewObj<CommentToken>() };
+    Rc<CommentToken> result{ NewToken<CommentToken>(l->Arena) };
     result->SetOpeningToken("/*");
 
     std::string contents{ };
@@ -471,24 +479,24 @@ Rc<SyntaxToken> CodeLexer::ReadTokenOnce() {
     lexemeRange.Length = 1;
 
     switch (GetChar()) {
-    case 0:                      result = NewObj<EofToken>(); break;
-    case '(': IncrementCursor(); result = NewObj<LParenSymbol>(); break;
-    case ')': IncrementCursor(); result = NewObj<RParenSymbol>(); break;
-    case '[': IncrementCursor(); result = NewObj<LBracketSymbol>(); break;
-    case ']': IncrementCursor(); result = NewObj<RBracketSymbol>(); break;
-    case '{': IncrementCursor(); result = NewObj<LBraceSymbol>(); break;
-    case '}': IncrementCursor(); result = NewObj<RBraceSymbol>(); break;
-    case ';': IncrementCursor(); result = NewObj<SemicolonSymbol>(); break;
-    case ',': IncrementCursor(); result = NewObj<CommaSymbol>(); break;
-    case '~': IncrementCursor(); result = NewObj<TildeSymbol>(); break;
-    case '?': IncrementCursor(); result = NewObj<QuestionSymbol>(); break;
-    case ':': IncrementCursor(); result = NewObj<ColonSymbol>(); break;
+    case 0:                      result = NewToken<EofToken>(l->Arena); break;
+    case '(': IncrementCursor(); result = NewToken<LParenSymbol>(l->Arena); break;
+    case ')': IncrementCursor(); result = NewToken<RParenSymbol>(l->Arena); break;
+    case '[': IncrementCursor(); result = NewToken<LBracketSymbol>(l->Arena); break;
+    case ']': IncrementCursor(); result = NewToken<RBracketSymbol>(l->Arena); break;
+    case '{': IncrementCursor(); result = NewToken<LBraceSymbol>(l->Arena); break;
+    case '}': IncrementCursor(); result = NewToken<RBraceSymbol>(l->Arena); break;
+    case ';': IncrementCursor(); result = NewToken<SemicolonSymbol>(l->Arena); break;
+    case ',': IncrementCursor(); result = NewToken<CommaSymbol>(l->Arena); break;
+    case '~': IncrementCursor(); result = NewToken<TildeSymbol>(l->Arena); break;
+    case '?': IncrementCursor(); result = NewToken<QuestionSymbol>(l->Arena); break;
+    case ':': IncrementCursor(); result = NewToken<ColonSymbol>(l->Arena); break;
 
     case '.': {
         Rc<NumericLiteralToken> literal{ ReadNumericLiteral_Internal() };
         if (literal == nullptr) {
             IncrementCursor();
-            result = NewObj<DotSymbol>();
+            result = NewToken<DotSymbol>(l->Arena);
         }
         else {
             result = literal;
@@ -498,23 +506,23 @@ Rc<SyntaxToken> CodeLexer::ReadTokenOnce() {
 
     case '+':
         IncrementCursor();
-        if (GetChar() == '=') { IncrementCursor(); result = NewObj<PlusEqualsSymbol>(); }
-        else if (GetChar() == '+') { IncrementCursor(); result = NewObj<PlusPlusSymbol>(); }
-        else { result = NewObj<PlusSymbol>(); }
+        if (GetChar() == '=') { IncrementCursor(); result = NewToken<PlusEqualsSymbol>(l->Arena); }
+        else if (GetChar() == '+') { IncrementCursor(); result = NewToken<PlusPlusSymbol>(l->Arena); }
+        else { result = NewToken<PlusSymbol>(l->Arena); }
         break;
 
     case '-':
         IncrementCursor();
-        if (GetChar() == '=') { IncrementCursor(); result = NewObj<MinusEqualsSymbol>(); }
-        else if (GetChar() == '-') { IncrementCursor(); result = NewObj<MinusMinusSymbol>(); }
-        else if (GetChar() == '>') { IncrementCursor(); result = NewObj<MinusGtSymbol>(); }
-        else { result = NewObj<MinusSymbol>(); }
+        if (GetChar() == '=') { IncrementCursor(); result = NewToken<MinusEqualsSymbol>(l->Arena); }
+        else if (GetChar() == '-') { IncrementCursor(); result = NewToken<MinusMinusSymbol>(l->Arena); }
+        else if (GetChar() == '>') { IncrementCursor(); result = NewToken<MinusGtSymbol>(l->Arena); }
+        else { result = NewToken<MinusSymbol>(l->Arena); }
         break;
 
     case '*':
         IncrementCursor();
-        if (GetChar() == '=') { IncrementCursor(); result = NewObj<AsteriskEqualsSymbol>(); }
-        else { result = NewObj<AsteriskSymbol>(); }
+        if (GetChar() == '=') { IncrementCursor(); result = NewToken<AsteriskEqualsSymbol>(l->Arena); }
+        else { result = NewToken<AsteriskSymbol>(l->Arena); }
         break;
 
     case '/': {
@@ -522,10 +530,10 @@ Rc<SyntaxToken> CodeLexer::ReadTokenOnce() {
         if (commentToken == nullptr) {
             if (GetChar() == '=') {
                 IncrementCursor();
-                result = NewObj<SlashEqualsSymbol>();
+                result = NewToken<SlashEqualsSymbol>(l->Arena);
             }
             else {
-                result = NewObj<SlashSymbol>();
+                result = NewToken<SlashSymbol>(l->Arena);
             }
         }
         else {
@@ -536,28 +544,28 @@ Rc<SyntaxToken> CodeLexer::ReadTokenOnce() {
 
     case '%':
         IncrementCursor();
-        if (GetChar() == '=') { IncrementCursor(); result = NewObj<PercentEqualsSymbol>(); }
-        else { result = NewObj<PercentSymbol>(); }
+        if (GetChar() == '=') { IncrementCursor(); result = NewToken<PercentEqualsSymbol>(l->Arena); }
+        else { result = NewToken<PercentSymbol>(l->Arena); }
         break;
 
     case '<':
         IncrementCursor();
         if (GetChar() == '=') {
             IncrementCursor();
-            result = NewObj<LtEqualsSymbol>();
+            result = NewToken<LtEqualsSymbol>(l->Arena);
         }
         else if (GetChar() == '<') {
             IncrementCursor();
             if (GetChar() == '=') {
                 IncrementCursor();
-                result = NewObj<LtLtEqualsSymbol>();
+                result = NewToken<LtLtEqualsSymbol>(l->Arena);
             }
             else {
-                result = NewObj<LtLtSymbol>();
+                result = NewToken<LtLtSymbol>(l->Arena);
             }
         }
         else {
-            result = NewObj<LtSymbol>();
+            result = NewToken<LtSymbol>(l->Arena);
         }
         break;
 
@@ -565,53 +573,53 @@ Rc<SyntaxToken> CodeLexer::ReadTokenOnce() {
         IncrementCursor();
         if (GetChar() == '=') {
             IncrementCursor();
-            result = NewObj<GtEqualsSymbol>();
+            result = NewToken<GtEqualsSymbol>(l->Arena);
         }
         else if (GetChar() == '>') {
             IncrementCursor();
             if (GetChar() == '=') {
                 IncrementCursor();
-                result = NewObj<GtGtEqualsSymbol>();
+                result = NewToken<GtGtEqualsSymbol>(l->Arena);
             }
             else {
-                result = NewObj<GtGtSymbol>();
+                result = NewToken<GtGtSymbol>(l->Arena);
             }
         }
         else {
-            result = NewObj<GtSymbol>();
+            result = NewToken<GtSymbol>(l->Arena);
         }
         break;
 
     case '=':
         IncrementCursor();
-        if (GetChar() == '=') { IncrementCursor(); result = NewObj<EqualsEqualsSymbol>(); }
-        else { result = NewObj<EqualsSymbol>(); }
+        if (GetChar() == '=') { IncrementCursor(); result = NewToken<EqualsEqualsSymbol>(l->Arena); }
+        else { result = NewToken<EqualsSymbol>(l->Arena); }
         break;
 
     case '!':
         IncrementCursor();
-        if (GetChar() == '=') { IncrementCursor(); result = NewObj<ExclamationEqualsSymbol>(); }
-        else { result = NewObj<ExclamationSymbol>(); }
+        if (GetChar() == '=') { IncrementCursor(); result = NewToken<ExclamationEqualsSymbol>(l->Arena); }
+        else { result = NewToken<ExclamationSymbol>(l->Arena); }
         break;
 
     case '&':
         IncrementCursor();
-        if (GetChar() == '=') { IncrementCursor(); result = NewObj<AmpersandEqualsSymbol>(); }
-        else if (GetChar() == '&') { IncrementCursor(); result = NewObj<AmpersandAmpersandSymbol>(); }
-        else { result = NewObj<AmpersandSymbol>(); }
+        if (GetChar() == '=') { IncrementCursor(); result = NewToken<AmpersandEqualsSymbol>(l->Arena); }
+        else if (GetChar() == '&') { IncrementCursor(); result = NewToken<AmpersandAmpersandSymbol>(l->Arena); }
+        else { result = NewToken<AmpersandSymbol>(l->Arena); }
         break;
 
     case '^':
         IncrementCursor();
-        if (GetChar() == '=') { IncrementCursor(); result = NewObj<CaretEqualsSymbol>(); }
-        else { result = NewObj<CaretSymbol>(); } 
+        if (GetChar() == '=') { IncrementCursor(); result = NewToken<CaretEqualsSymbol>(l->Arena); }
+        else { result = NewToken<CaretSymbol>(l->Arena); } 
         break;
 
     case '|':
         IncrementCursor();
-        if (GetChar() == '=') { IncrementCursor(); result = NewObj<PipeEqualsSymbol>(); }
-        else if (GetChar() == '|') { IncrementCursor(); result = NewObj<PipePipeSymbol>(); }
-        else { result = NewObj<PipeSymbol>(); }
+        if (GetChar() == '=') { IncrementCursor(); result = NewToken<PipeEqualsSymbol>(l->Arena); }
+        else if (GetChar() == '|') { IncrementCursor(); result = NewToken<PipePipeSymbol>(l->Arena); }
+        else { result = NewToken<PipeSymbol>(l->Arena); }
         break;
 
     case '_': case '$':
@@ -634,7 +642,7 @@ Rc<SyntaxToken> CodeLexer::ReadTokenOnce() {
     case '"': result = ReadStringLiteral_Internal('"', '"'); break;
 
     default:
-        Rc<StrayToken> strayToken{ NewObj<StrayToken>() };
+        Rc<StrayToken> strayToken{ NewToken<StrayToken>(l->Arena) };
         strayToken->SetOffendingChar(GetChar());
         IncrementCursor();
 
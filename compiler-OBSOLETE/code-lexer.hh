@@ -14,12 +14,19 @@ class CommentToken;
 class NumericLiteralToken;
 class SyntaxToken;
 class StringLiteralToken;
+class SyntaxArena;
 
 struct CODE_LEXER_IMPL;
 
-class CodeLexer : public Object, public virtual ILexer {
+class CodeLexer : public ILexer {
 public:
     explicit CodeLexer(Rc<const SourceFile> input);
+    /**
+     * Creates the tokens in arena, which the lexer keeps alive. Tokens
+     * read from one file are usually freed together, so this saves a heap
+     * allocation per token.
+     */
+    CodeLexer(Rc<const SourceFile> input, Rc<SyntaxArena> arena);
     virtual ~CodeLexer();
 
     Rc<SyntaxToken> ReadToken() override;
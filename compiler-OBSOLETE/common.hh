@@ -1,34 +1,268 @@
 #ifndef COMBUST_COMMON_HH
 #define COMBUST_COMMON_HH
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
 #include <memory>
+#include <type_traits>
+#include <utility>
+
+#if defined(COMBUST_ALLOCATION_PROFILER)
+#include "allocation-profiler.hh"
+#endif
 
 #define IN
 #define OUT
 #define IN_OUT
 #define THIS
 
+/**
+ * Base of every object an Rc can point to. The reference count lives in
+ * the object itself, so an Rc is a single pointer and creating one takes
+ * no allocation besides the object's.
+ *
+ * Counts are plain loads and stores until MarkShared is called, after
+ * which they are atomic. Mark an object shared before another thread can
+ * reach it; everything else stays on one thread at a time.
+ */
+class RefCounted {
+public:
+    void AddReference() const {
+        uint32_t word{ referenceWord.load(std::memory_order_relaxed) };
+        if ((word & (SHARED_REFERENCES | ALIASED_REFERENCES)) != 0)
+            AddReferenceSlow(word);
+        else
+            referenceWord.store(word + 1, std::memory_order_relaxed);
+    }
+
+    void Release() const {
+        uint32_t word{ referenceWord.load(std::memory_order_relaxed) };
+        if ((word & (SHARED_REFERENCES | ALIASED_REFERENCES)) != 0) {
+            ReleaseSlow(word);
+        }
+        else {
+            referenceWord.store(word - 1, std::memory_order_relaxed);
+            if (word == 1)
+                Destroy();
+        }
+    }
+
+    /**
+     * Makes the object's reference count atomic from now on, or that of the
+     * object that owns its references. Takes effect for every thread the
+     * object is published to afterwards.
+     */
+    void MarkShared() const {
+        if ((referenceWord.load(std::memory_order_relaxed) & ALIASED_REFERENCES) != 0)
+            GetReferenceOwner()->MarkShared();
+        else
+            referenceWord.fetch_or(SHARED_REFERENCES, std::memory_order_relaxed);
+    }
+
+    bool IsShared() const {
+        return (referenceWord.load(std::memory_order_relaxed) & SHARED_REFERENCES) != 0;
+    }
+
+    /**
+     * \return the number of Rcs to the object, or to the object that owns
+     *         its references
+     */
+    long GetReferenceCount() const {
+        uint32_t word{ referenceWord.load(std::memory_order_relaxed) };
+        if ((word & ALIASED_REFERENCES) != 0)
+            return GetReferenceOwner()->GetReferenceCount();
+
+        return static_cast<long>(word & ~(SHARED_REFERENCES | ALIASED_REFERENCES));
+    }
+
+#if defined(COMBUST_ALLOCATION_PROFILER)
+    /** Set by NewObj so that the object's release is counted. */
+    void SetAllocationCounter(AllocationCounter* counter, size_t size) {
+        allocationCounter = counter;
+        allocationSize = size;
+    }
+#endif
+
+protected:
+    explicit RefCounted() {}
+    /** A copy is a new object, with no references yet. */
+    RefCounted(const RefCounted&) {}
+    RefCounted& operator=(const RefCounted&) { return *this; }
+    virtual ~RefCounted() {}
+
+    /**
+     * Makes references to this object count towards the object returned by
+     * GetReferenceOwner instead, which then keeps this one alive.
+     */
+    void AliasReferences() {
+        referenceWord.store(ALIASED_REFERENCES, std::memory_order_relaxed);
+    }
+
+    virtual const RefCounted* GetReferenceOwner() const { return this; }
+
+private:
+    static constexpr uint32_t SHARED_REFERENCES{ 0x80000000 };
+    static constexpr uint32_t ALIASED_REFERENCES{ 0x40000000 };
+
+    void AddReferenceSlow(uint32_t word) const {
+        if ((word & ALIASED_REFERENCES) != 0)
+            GetReferenceOwner()->AddReference();
+        else
+            referenceWord.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void ReleaseSlow(uint32_t word) const {
+        if ((word & ALIASED_REFERENCES) != 0)
+            GetReferenceOwner()->Release();
+        else if (referenceWord.fetch_sub(1, std::memory_order_acq_rel) == (SHARED_REFERENCES | 1))
+            Destroy();
+    }
+
+    void Destroy() const {
+#if defined(COMBUST_ALLOCATION_PROFILER)
+        if (allocationCounter != nullptr)
+            RecordDeallocation(*allocationCounter, allocationSize);
+#endif
+        delete this;
+    }
+
+    mutable std::atomic<uint32_t> referenceWord{ 0 };
+#if defined(COMBUST_ALLOCATION_PROFILER)
+    AllocationCounter*            allocationCounter{ nullptr };
+    size_t                        allocationSize{ 0 };
+#endif
+};
+
+/**
+ * Counted reference to a RefCounted object. Rcs to the same object may be
+ * copied and released on different threads only once it is marked shared.
+ */
+template<typename Ty>
+class Rc {
+public:
+    Rc() {}
+    Rc(std::nullptr_t) {}
+
+    /** Adds a reference to an object that may already have some. */
+    explicit Rc(Ty* object) :
+        object{ object }
+    {
+        if (object != nullptr)
+            object->AddReference();
+    }
+
+    Rc(const Rc& other) :
+        Rc{ other.object }
+    { }
+
+    Rc(Rc&& other) noexcept :
+        object{ other.object }
+    {
+        other.object = nullptr;
+    }
+
+    template<typename Other, typename = std::enable_if_t<std::is_convertible<Other*, Ty*>::value>>
+    Rc(const Rc<Other>& other) :
+        Rc{ other.get() }
+    { }
+
+    template<typename Other, typename = std::enable_if_t<std::is_convertible<Other*, Ty*>::value>>
+    Rc(Rc<Other>&& other) noexcept :
+        object{ other.detach() }
+    { }
+
+    ~Rc() {
+        if (object != nullptr)
+            object->Release();
+    }
+
+    Rc& operator=(Rc other) noexcept {
+        std::swap(object, other.object);
+        return *this;
+    }
+
+    Ty* get() const { return object; }
+    Ty* operator->() const { return object; }
+    Ty& operator*() const { return *object; }
+    explicit operator bool() const { return object != nullptr; }
+
+    long use_count() const { return object != nullptr ? object->GetReferenceCount() : 0; }
+
+    void reset() {
+        Rc{ }.swap(*this);
+    }
+
+    void swap(Rc& other) noexcept {
+        std::swap(object, other.object);
+    }
+
+    /**
+     * \return the object, whose reference the caller now holds
+     */
+    [[nodiscard]] Ty* detach() {
+        Ty* detached{ object };
+        object = nullptr;
+        return detached;
+    }
+
+private:
+    Ty* object{ nullptr };
+};
+
+template<typename Ty, typename Other>
+bool operator==(const Rc<Ty>& a, const Rc<Other>& b) { return a.get() == b.get(); }
+template<typename Ty, typename Other>
+bool operator!=(const Rc<Ty>& a, const Rc<Other>& b) { return a.get() != b.get(); }
+template<typename Ty>
+bool operator==(const Rc<Ty>& a, std::nullptr_t) { return a.get() == nullptr; }
 template<typename Ty>
-using Rc = std::shared_ptr<Ty>;
+bool operator!=(const Rc<Ty>& a, std::nullptr_t) { return a.get() != nullptr; }
+template<typename Ty>
+bool operator==(std::nullptr_t, const Rc<Ty>& b) { return b.get() == nullptr; }
+template<typename Ty>
+bool operator!=(std::nullptr_t, const Rc<Ty>& b) { return b.get() != nullptr; }
+
+template<typename Ty, typename... Types>
+[[nodiscard]] auto NewObj(Types&& ... args) -> Rc<Ty> {
+    Ty* object{ new Ty(args...) };
+#if defined(COMBUST_ALLOCATION_PROFILER)
+    AllocationCounter& counter{ GetAllocationCounter<Ty>() };
+    RecordAllocation(counter, sizeof(Ty));
+    object->SetAllocationCounter(&counter, sizeof(Ty));
+#endif
+    return Rc<Ty>{ object };
+}
+
+#if defined(COMBUST_ALLOCATION_PROFILER)
 
 template<typename Ty>
-using Owner = std::unique_ptr<Ty>;
+using Owner = std::unique_ptr<Ty, ProfilingDeleter<Ty>>;
 
 template<typename Ty, typename... Types>
-[[nodiscard]] auto NewObj(Types&& ... args) -> decltype(std::make_shared<Ty>(args...)) {
-    return std::make_shared<Ty>(args...);
+[[nodiscard]] auto NewChild(Types&& ... args) -> Owner<Ty> {
+    Owner<Ty> child{ new Ty(args...) };
+    RecordAllocation(GetAllocationCounter<Ty>(), sizeof(Ty));
+    return child;
 }
 
+#else
+
+template<typename Ty>
+using Owner = std::unique_ptr<Ty>;
+
 template<typename Ty, typename... Types>
 [[nodiscard]] auto NewChild(Types&& ... args) -> decltype(std::make_unique<Ty>(args...)) {
     return std::make_unique<Ty>(args...);
 }
 
+#endif
+
 template<typename To, typename From>
-[[nodiscard]] auto As(const Rc<From>& obj) -> decltype(std::static_pointer_cast<To>(obj)) {
-    return std::static_pointer_cast<To>(obj);
+[[nodiscard]] auto As(const Rc<From>& obj) -> Rc<To> {
+    return Rc<To>{ static_cast<To*>(obj.get()) };
 }
 
-class Object {
+class Object : public RefCounted {
 public:
     explicit Object() {}
 private:
@@ -0,0 +1,1226 @@
+#include "dependency-scanner.hh"
+#include "binary-format.hh"
+#include "mapped-file.hh"
+#include "preprocessor-lexer.hh"
+#include "source.hh"
+#include "source-minimizer.hh"
+#include "syntax.hh"
+#include "time-profiler.hh"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+static constexpr int MAX_INCLUDE_DEPTH = 200;
+static constexpr int MAX_MACRO_EXPANSION_DEPTH = 64;
+
+struct HEADER_INFO;
+
+enum DIRECTIVE_KIND {
+    DK_NONE,
+    DK_IF,
+    DK_IFDEF,
+    DK_IFNDEF,
+    DK_ELIF,
+    DK_ELSE,
+    DK_ENDIF,
+    DK_INCLUDE,
+    DK_DEFINE,
+    DK_UNDEF,
+    DK_PRAGMA,
+    DK_ERROR,
+    DK_OTHER
+};
+
+/**
+ * A directive and the tokens following it on the same line.
+ */
+struct DirectiveLine {
+    DIRECTIVE_KIND               Kind{ DK_NONE };
+    Rc<SyntaxToken>              Directive{ };
+    std::vector<Rc<SyntaxToken>> Arguments{ };
+    /** The first argument, if it is an identifier. */
+    bool                         HasName{ false };
+    std::string                  Name{ };
+    /**
+     * Where a literal #include resolved to; the search only depends on the
+     * including file, so it is done once per run.
+     */
+    mutable std::atomic<HEADER_INFO*> IncludedFile{ nullptr };
+};
+
+/**
+ * What the scanner knows about a file. Shared by every translation unit
+ * scanned in a run. The file is minimized and lexed once, the first time
+ * any translation unit includes it; Source, Directives and GuardMacro are
+ * immutable afterwards.
+ */
+struct HEADER_INFO {
+    std::string                       Path{ };
+    bool                              Exists{ false };
+    Rc<const SourceFile>              Source{ };
+    std::once_flag                    IsLexed{ };
+    std::vector<Owner<DirectiveLine>> Directives{ };
+    /** Empty unless the whole file is wrapped in #ifndef X ... #endif. */
+    std::string                       GuardMacro{ };
+};
+
+struct MacroDefinition {
+    bool                         IsFunctionLike{ false };
+    /** Hides a macro of the precompiled header after #undef. */
+    bool                         IsUndefined{ false };
+    std::vector<Rc<SyntaxToken>> Body{ };
+};
+
+/**
+ * Preprocessor state at the end of a precompiled header. Files are known by
+ * path so that loading does not have to open them.
+ */
+struct PRELUDE_STATE {
+    std::string                                      Path{ };
+    std::unordered_map<std::string, MacroDefinition> Macros{ };
+    /** The precompiled header, then every header it included. */
+    std::vector<std::string>                         Dependencies{ };
+    std::unordered_set<std::string>                  DependencySet{ };
+    std::unordered_map<std::string, std::string>     GuardMacros{ };
+    std::unordered_set<std::string>                  OnceFiles{ };
+};
+
+struct DEPENDENCY_SCANNER_IMPL {
+    std::vector<std::string>                                  IncludePaths{ };
+    std::mutex                                                Mutex{ };
+    std::unordered_map<std::string, Owner<HEADER_INFO>>       Files{ };
+    std::unordered_map<std::string, Rc<const SourceFile>>     VirtualFiles{ };
+    Owner<PRELUDE_STATE>                                      Prelude{ };
+};
+
+struct ConditionalFrame {
+    bool WasParentActive{ true };
+    bool WasAnyBranchTaken{ false };
+    bool IsActive{ true };
+    bool HasSeenElse{ false };
+};
+
+/**
+ * Preprocessor state of one translation unit.
+ */
+struct SCAN_STATE {
+    DEPENDENCY_SCANNER_IMPL*                         Scanner{ nullptr };
+    ScanResult*                                      Result{ nullptr };
+    std::unordered_map<std::string, MacroDefinition> Macros{ };
+    std::unordered_set<const HEADER_INFO*>           SeenFiles{ };
+    std::unordered_set<const HEADER_INFO*>           OnceFiles{ };
+    /** State the translation unit starts from, if a PCH is loaded. */
+    const PRELUDE_STATE*                             Prelude{ nullptr };
+};
+
+/**
+ * \return the definition of a macro, looking through to the precompiled
+ *         header, or nullptr if it is not defined
+ */
+static const MacroDefinition* FindMacro(const SCAN_STATE& state, const std::string& name) {
+    auto macro = state.Macros.find(name);
+    if (macro != state.Macros.end())
+        return macro->second.IsUndefined ? nullptr : &macro->second;
+
+    if (state.Prelude) {
+        auto preludeMacro = state.Prelude->Macros.find(name);
+        if (preludeMacro != state.Prelude->Macros.end())
+            return &preludeMacro->second;
+    }
+
+    return nullptr;
+}
+
+static void UndefineMacro(SCAN_STATE& state, const std::string& name) {
+    if (state.Prelude && state.Prelude->Macros.count(name)) {
+        MacroDefinition undefined{ };
+        undefined.IsUndefined = true;
+        state.Macros[name] = std::move(undefined);
+    }
+    else {
+        state.Macros.erase(name);
+    }
+}
+
+static void Report(
+    SCAN_STATE&               state,
+    const Rc<SyntaxToken>&    at,
+    const std::string&        message,
+    bool                      isError = true
+)
+{
+    ScanDiagnostic diagnostic{ };
+    if (at)
+        diagnostic.Location = at->GetLexemeRange().Location;
+    diagnostic.Message = message;
+    diagnostic.IsError = isError;
+    state.Result->Diagnostics.push_back(diagnostic);
+
+    if (isError)
+        state.Result->Succeeded = false;
+}
+
+static HEADER_INFO* LookupFile(
+    DEPENDENCY_SCANNER_IMPL* s,
+    const std::string&       path
+)
+{
+    {
+        std::lock_guard<std::mutex> lock{ s->Mutex };
+        auto it = s->Files.find(path);
+        if (it != s->Files.end())
+            return it->second->Exists ? it->second.get() : nullptr;
+    }
+
+    // Read outside of the lock so threads do not serialize on disk I/O.
+    // If two threads race, the first insertion wins.
+    Owner<HEADER_INFO> info{ NewChild<HEADER_INFO>() };
+    info->Path = path;
+
+    auto virtualFile = s->VirtualFiles.find(path);
+    if (virtualFile != s->VirtualFiles.end())
+        info->Source = virtualFile->second;
+    else
+        info->Source = OpenSourceFile(path);
+    info->Exists = info->Source != nullptr;
+    if (info->Exists)
+        info->Source->MarkShared();
+
+    std::lock_guard<std::mutex> lock{ s->Mutex };
+    auto [it, isInserted] = s->Files.emplace(path, std::move(info));
+    (void) isInserted;
+    return it->second->Exists ? it->second.get() : nullptr;
+}
+
+static std::string GetDirectoryName(const std::string& path) {
+    size_t slash{ path.find_last_of("/\\") };
+    if (slash == std::string::npos)
+        return std::string{ };
+    return path.substr(0, slash + 1);
+}
+
+static HEADER_INFO* ResolveInclude(
+    SCAN_STATE&        state,
+    const std::string& includer,
+    const std::string& name,
+    bool               isQuoted
+)
+{
+    if (!name.empty() && (name[0] == '/' || name[0] == '\\'))
+        return LookupFile(state.Scanner, name);
+
+    if (isQuoted) {
+        if (HEADER_INFO* info{ LookupFile(state.Scanner, GetDirectoryName(includer) + name) })
+            return info;
+    }
+
+    for (const std::string& directory : state.Scanner->IncludePaths) {
+        std::string path{ directory };
+        if (!path.empty() && path.back() != '/' && path.back() != '\\')
+            path += '/';
+        path += name;
+
+        if (HEADER_INFO* info{ LookupFile(state.Scanner, path) })
+            return info;
+    }
+
+    return nullptr;
+}
+
+static DIRECTIVE_KIND GetDirectiveKind(const Rc<SyntaxToken>& t) {
+    if (IsSyntaxNode<IfDirective>(t)) return DK_IF;
+    if (IsSyntaxNode<IfDefDirective>(t)) return DK_IFDEF;
+    if (IsSyntaxNode<IfNDefDirective>(t)) return DK_IFNDEF;
+    if (IsSyntaxNode<ElifDirective>(t)) return DK_ELIF;
+    if (IsSyntaxNode<ElseDirective>(t)) return DK_ELSE;
+    if (IsSyntaxNode<EndIfDirective>(t)) return DK_ENDIF;
+    if (IsSyntaxNode<IncludeDirective>(t)) return DK_INCLUDE;
+    if (IsSyntaxNode<DefineDirective>(t)) return DK_DEFINE;
+    if (IsSyntaxNode<UnDefDirective>(t)) return DK_UNDEF;
+    if (IsSyntaxNode<PragmaDirective>(t)) return DK_PRAGMA;
+    if (IsSyntaxNode<ErrorDirective>(t)) return DK_ERROR;
+    if (IsSyntaxNode<LineDirective>(t)
+        || IsSyntaxNode<WarningDirective>(t)
+        || IsSyntaxNode<InvalidDirective>(t)) return DK_OTHER;
+    return DK_NONE;
+}
+
+static const std::string* GetIdentifierName(const Rc<SyntaxToken>& t) {
+    if (!t || !IsSyntaxNode<IdentifierToken>(t))
+        return nullptr;
+    return &As<IdentifierToken>(t)->GetName();
+}
+
+/**
+ * Evaluates the controlling expression of #if and #elif.
+ * Identifiers that are not macros evaluate to 0 and function-like macro
+ * invocations are not expanded, which is enough for dependency discovery.
+ * Operands that &&, || and ?: skip are parsed but not evaluated, so they
+ * cannot fail with e.g. a division by zero.
+ */
+class ConditionEvaluator {
+public:
+    explicit ConditionEvaluator(
+        SCAN_STATE&                         state,
+        const std::vector<Rc<SyntaxToken>>& tokens,
+        int                                 depth
+    ) :
+        state{ state },
+        tokens{ tokens },
+        depth{ depth }
+    {}
+
+    intmax_t Evaluate() {
+        intmax_t value{ ParseConditional() };
+        if (position < tokens.size() && !hasFailed) {
+            Fail(tokens[position], "unexpected token in preprocessor expression");
+        }
+        return hasFailed ? 0 : value;
+    }
+
+    bool HasFailed() const { return hasFailed; }
+
+private:
+    Rc<SyntaxToken> Peek() const {
+        return position < tokens.size() ? tokens[position] : Rc<SyntaxToken>{ };
+    }
+
+    template<typename T>
+    bool Accept() {
+        if (position < tokens.size() && IsSyntaxNode<T>(tokens[position])) {
+            ++position;
+            return true;
+        }
+        return false;
+    }
+
+    void Fail(const Rc<SyntaxToken>& at, const std::string& message) {
+        if (!hasFailed)
+            Report(state, at, message);
+        hasFailed = true;
+    }
+
+    /**
+     * \return what parse returns, with the operand it parses only evaluated
+     *         if isOperandEvaluated is true
+     */
+    template<typename Parse>
+    intmax_t ParseOperand(bool isOperandEvaluated, Parse parse) {
+        bool wasEvaluated{ isEvaluated };
+        isEvaluated = wasEvaluated && isOperandEvaluated;
+        intmax_t value{ parse() };
+        isEvaluated = wasEvaluated;
+        return value;
+    }
+
+    intmax_t ParseConditional() {
+        intmax_t condition{ ParseBinary(0) };
+
+        if (Accept<QuestionSymbol>()) {
+            intmax_t whenTrue{ ParseOperand(condition != 0, [this] { return ParseConditional(); }) };
+            if (!Accept<ColonSymbol>())
+                Fail(Peek(), "expected ':' in preprocessor expression");
+            intmax_t whenFalse{ ParseOperand(condition == 0, [this] { return ParseConditional(); }) };
+            return condition ? whenTrue : whenFalse;
+        }
+
+        return condition;
+    }
+
+    static int GetPrecedence(const Rc<SyntaxToken>& t) {
+        if (!t) return -1;
+        if (IsSyntaxNode<PipePipeSymbol>(t)) return 0;
+        if (IsSyntaxNode<AmpersandAmpersandSymbol>(t)) return 1;
+        if (IsSyntaxNode<PipeSymbol>(t)) return 2;
+        if (IsSyntaxNode<CaretSymbol>(t)) return 3;
+        if (IsSyntaxNode<AmpersandSymbol>(t)) return 4;
+        if (IsSyntaxNode<EqualsEqualsSymbol>(t)
+            || IsSyntaxNode<ExclamationEqualsSymbol>(t)) return 5;
+        if (IsSyntaxNode<LtSymbol>(t) || IsSyntaxNode<GtSymbol>(t)
+            || IsSyntaxNode<LtEqualsSymbol>(t)
+            || IsSyntaxNode<GtEqualsSymbol>(t)) return 6;
+        if (IsSyntaxNode<LtLtSymbol>(t) || IsSyntaxNode<GtGtSymbol>(t)) return 7;
+        if (IsSyntaxNode<PlusSymbol>(t) || IsSyntaxNode<MinusSymbol>(t)) return 8;
+        if (IsSyntaxNode<AsteriskSymbol>(t) || IsSyntaxNode<SlashSymbol>(t)
+            || IsSyntaxNode<PercentSymbol>(t)) return 9;
+        return -1;
+    }
+
+    intmax_t Apply(const Rc<SyntaxToken>& op, intmax_t lhs, intmax_t rhs) {
+        if (IsSyntaxNode<PipePipeSymbol>(op)) return lhs || rhs;
+        if (IsSyntaxNode<AmpersandAmpersandSymbol>(op)) return lhs && rhs;
+        if (IsSyntaxNode<PipeSymbol>(op)) return lhs | rhs;
+        if (IsSyntaxNode<CaretSymbol>(op)) return lhs ^ rhs;
+        if (IsSyntaxNode<AmpersandSymbol>(op)) return lhs & rhs;
+        if (IsSyntaxNode<EqualsEqualsSymbol>(op)) return lhs == rhs;
+        if (IsSyntaxNode<ExclamationEqualsSymbol>(op)) return lhs != rhs;
+        if (IsSyntaxNode<LtSymbol>(op)) return lhs < rhs;
+        if (IsSyntaxNode<GtSymbol>(op)) return lhs > rhs;
+        if (IsSyntaxNode<LtEqualsSymbol>(op)) return lhs <= rhs;
+        if (IsSyntaxNode<GtEqualsSymbol>(op)) return lhs >= rhs;
+        if (IsSyntaxNode<LtLtSymbol>(op)) return lhs << (rhs & 63);
+        if (IsSyntaxNode<GtGtSymbol>(op)) return lhs >> (rhs & 63);
+        if (IsSyntaxNode<PlusSymbol>(op)) return lhs + rhs;
+        if (IsSyntaxNode<MinusSymbol>(op)) return lhs - rhs;
+        if (IsSyntaxNode<AsteriskSymbol>(op)) return lhs * rhs;
+
+        if (rhs == 0) {
+            if (isEvaluated)
+                Fail(op, "division by zero in preprocessor expression");
+            return 0;
+        }
+        if (IsSyntaxNode<SlashSymbol>(op)) return lhs / rhs;
+        return lhs % rhs;
+    }
+
+    intmax_t ParseBinary(int minPrecedence) {
+        intmax_t lhs{ ParseUnary() };
+
+        for (;;) {
+            Rc<SyntaxToken> op{ Peek() };
+            int precedence{ GetPrecedence(op) };
+            if (precedence < minPrecedence)
+                return lhs;
+
+            ++position;
+            bool isShortCircuited{
+                (IsSyntaxNode<AmpersandAmpersandSymbol>(op) && lhs == 0)
+                || (IsSyntaxNode<PipePipeSymbol>(op) && lhs != 0)
+            };
+            intmax_t rhs{ ParseOperand(!isShortCircuited, [this, precedence] { return ParseBinary(precedence + 1); }) };
+            lhs = Apply(op, lhs, rhs);
+        }
+    }
+
+    intmax_t ParseUnary() {
+        if (Accept<ExclamationSymbol>()) return !ParseUnary();
+        if (Accept<TildeSymbol>()) return ~ParseUnary();
+        if (Accept<MinusSymbol>()) return -ParseUnary();
+        if (Accept<PlusSymbol>()) return ParseUnary();
+        return ParsePrimary();
+    }
+
+    intmax_t ParsePrimary() {
+        Rc<SyntaxToken> token{ Peek() };
+        if (!token) {
+            Fail(tokens.empty() ? Rc<SyntaxToken>{ } : tokens.back(),
+                 "expected value in preprocessor expression");
+            return 0;
+        }
+
+        if (Accept<LParenSymbol>()) {
+            intmax_t value{ ParseConditional() };
+            if (!Accept<RParenSymbol>())
+                Fail(Peek(), "expected ')' in preprocessor expression");
+            return value;
+        }
+
+        if (IsSyntaxNode<NumericLiteralToken>(token)) {
+            ++position;
+            return EvaluateNumericLiteral(As<NumericLiteralToken>(token));
+        }
+
+        if (IsSyntaxNode<StringLiteralToken>(token)) {
+            ++position;
+            Rc<StringLiteralToken> literal{ As<StringLiteralToken>(token) };
+            if (literal->GetOpeningQuote() == '\'' && !literal->GetValue().empty())
+                return static_cast<unsigned char>(literal->GetValue()[0]);
+            Fail(token, "invalid token in preprocessor expression");
+            return 0;
+        }
+
+        if (const std::string* name{ GetIdentifierName(token) }) {
+            ++position;
+
+            if (*name == "defined") {
+                bool hasParen{ Accept<LParenSymbol>() };
+                const std::string* operand{ GetIdentifierName(Peek()) };
+                if (!operand) {
+                    Fail(Peek(), "macro name missing after 'defined'");
+                    return 0;
+                }
+                ++position;
+                if (hasParen && !Accept<RParenSymbol>())
+                    Fail(Peek(), "expected ')' after 'defined'");
+                return FindMacro(state, *operand) ? 1 : 0;
+            }
+
+            const MacroDefinition* macro{ FindMacro(state, *name) };
+            if (!macro)
+                return 0;
+
+            if (macro->IsFunctionLike) {
+                SkipInvocationArguments();
+                return 0;
+            }
+
+            if (depth >= MAX_MACRO_EXPANSION_DEPTH || macro->Body.empty())
+                return 0;
+
+            ConditionEvaluator expansion{ state, macro->Body, depth + 1 };
+            expansion.isEvaluated = isEvaluated;
+            intmax_t value{ expansion.Evaluate() };
+            hasFailed = hasFailed || expansion.HasFailed();
+            return value;
+        }
+
+        // Keywords and other identifiers-to-be evaluate to 0.
+        ++position;
+        return 0;
+    }
+
+    void SkipInvocationArguments() {
+        if (!Accept<LParenSymbol>())
+            return;
+
+        int nesting{ 1 };
+        while (nesting > 0 && position < tokens.size()) {
+            if (IsSyntaxNode<LParenSymbol>(tokens[position]))
+                ++nesting;
+            else if (IsSyntaxNode<RParenSymbol>(tokens[position]))
+                --nesting;
+            ++position;
+        }
+    }
+
+    static intmax_t EvaluateNumericLiteral(const Rc<NumericLiteralToken>& literal) {
+        const std::string& whole{ literal->GetWholeValue() };
+        const std::string& suffix{ literal->GetSuffix() };
+
+        // The code lexer stops hex literals at the "x"; the digits end up in
+        // the suffix.
+        if (whole == "0" && !suffix.empty() && (suffix[0] == 'x' || suffix[0] == 'X'))
+            return static_cast<intmax_t>(strtoull(suffix.c_str() + 1, nullptr, 16));
+
+        return static_cast<intmax_t>(strtoull(whole.c_str(), nullptr, 0));
+    }
+
+private:
+    SCAN_STATE&                         state;
+    const std::vector<Rc<SyntaxToken>>& tokens;
+    size_t                              position{ 0 };
+    int                                 depth{ 0 };
+    bool                                hasFailed{ false };
+    /** False within an operand that a short circuit skips. */
+    bool                                isEvaluated{ true };
+};
+
+static bool EvaluateCondition(
+    SCAN_STATE&                         state,
+    const Rc<SyntaxToken>&              directive,
+    const std::vector<Rc<SyntaxToken>>& arguments
+)
+{
+    if (arguments.empty()) {
+        Report(state, directive, "#if with no expression");
+        return false;
+    }
+
+    ConditionEvaluator evaluator{ state, arguments, 0 };
+    return evaluator.Evaluate() != 0;
+}
+
+static void DefineMacro(
+    SCAN_STATE&                         state,
+    const Rc<SyntaxToken>&              directive,
+    const std::vector<Rc<SyntaxToken>>& arguments
+)
+{
+    const std::string* name{ arguments.empty() ? nullptr : GetIdentifierName(arguments[0]) };
+    if (!name) {
+        Report(state, directive, "macro names must be identifiers");
+        return;
+    }
+
+    MacroDefinition macro{ };
+    size_t bodyStart{ 1 };
+
+    // A macro is function-like when "(" immediately follows its name.
+    if (arguments.size() > 1 && IsSyntaxNode<LParenSymbol>(arguments[1])) {
+        const SourceLoc& nameLoc{ arguments[0]->GetLexemeRange().Location };
+        const SourceLoc& parenLoc{ arguments[1]->GetLexemeRange().Location };
+
+        if (nameLoc.Line == parenLoc.Line
+            && nameLoc.Column + static_cast<int>(name->size()) == parenLoc.Column)
+        {
+            macro.IsFunctionLike = true;
+            while (bodyStart < arguments.size()
+                   && !IsSyntaxNode<RParenSymbol>(arguments[bodyStart]))
+                ++bodyStart;
+            ++bodyStart;
+        }
+    }
+
+    for (size_t i{ bodyStart }; i < arguments.size(); ++i)
+        macro.Body.push_back(arguments[i]);
+
+    state.Macros[*name] = std::move(macro);
+}
+
+static void LexDirectives(HEADER_INFO* file);
+static void ScanHeader(SCAN_STATE& state, HEADER_INFO* file, int depth);
+
+static void IncludeFile(
+    SCAN_STATE&          state,
+    HEADER_INFO*         includer,
+    const DirectiveLine& line,
+    int                  depth
+)
+{
+    const Rc<SyntaxToken>& directive{ line.Directive };
+    Rc<SyntaxToken> operand{ line.Arguments.empty() ? Rc<SyntaxToken>{ } : line.Arguments[0] };
+    bool isComputed{ false };
+
+    // Computed includes are supported when the macro names a literal.
+    if (const std::string* name{ GetIdentifierName(operand) }) {
+        const MacroDefinition* macro{ FindMacro(state, *name) };
+        if (macro && macro->Body.size() == 1) {
+            operand = macro->Body[0];
+            isComputed = true;
+        }
+    }
+
+    if (!operand || !IsSyntaxNode<StringLiteralToken>(operand)) {
+        Report(state, directive, "#include expects \"FILENAME\" or <FILENAME>");
+        return;
+    }
+
+    HEADER_INFO* header{ isComputed ? nullptr : line.IncludedFile.load(std::memory_order_acquire) };
+
+    if (!header) {
+        Rc<StringLiteralToken> literal{ As<StringLiteralToken>(operand) };
+        bool isQuoted{ literal->GetOpeningQuote() == '"' };
+
+        header = ResolveInclude(state, includer->Path, literal->GetValue(), isQuoted);
+        if (!header) {
+            Report(state, operand, literal->GetValue() + ": No such file or directory");
+            return;
+        }
+
+        if (!isComputed)
+            line.IncludedFile.store(header, std::memory_order_release);
+    }
+
+    if (depth >= MAX_INCLUDE_DEPTH) {
+        Report(state, directive, "#include nested too deeply");
+        return;
+    }
+
+    const PRELUDE_STATE* prelude{ state.Prelude };
+
+    if (state.SeenFiles.insert(header).second
+        && !(prelude && prelude->DependencySet.count(header->Path)))
+        state.Result->Dependencies.push_back(header->Path);
+
+    if (state.OnceFiles.count(header) || (prelude && prelude->OnceFiles.count(header->Path)))
+        return;
+
+    // Headers of the precompiled header are skipped without lexing them.
+    if (prelude) {
+        auto guard = prelude->GuardMacros.find(header->Path);
+        if (guard != prelude->GuardMacros.end() && FindMacro(state, guard->second))
+            return;
+    }
+
+    // GuardMacro is only safe to read once the header has been lexed.
+    std::call_once(header->IsLexed, LexDirectives, header);
+    if (!header->GuardMacro.empty() && FindMacro(state, header->GuardMacro))
+        return;
+
+    ScanHeader(state, header, depth + 1);
+}
+
+/**
+ * Reduces a file to its directive lines and detects its include guard.
+ * Only the minimized source is lexed and kept; code lines cannot affect
+ * which headers are included.
+ */
+static void LexDirectives(HEADER_INFO* file) {
+    {
+        ScopedTimer timer{ TP_MINIMIZE_SOURCE };
+        file->Source = MinimizeSource(*file->Source);
+        file->Source->MarkShared();
+    }
+
+    ScopedTimer timer{ TP_PREPROCESSOR_LEXER };
+    PreprocessorLexer lexer{ file->Source };
+
+    // Include guard detection: the file must consist of a single
+    // #ifndef X ... #endif block, outside of which only comments appear.
+    std::string guardCandidate{ };
+    int nesting{ 0 };
+    bool hasSeenToken{ false };
+    bool isGuardClosed{ false };
+    bool isGuardBroken{ false };
+
+    Rc<SyntaxToken> token{ lexer.ReadToken() };
+
+    while (!IsSyntaxNode<EofToken>(token)) {
+        if (IsSyntaxNode<CommentToken>(token)) {
+            token = lexer.ReadToken();
+            continue;
+        }
+
+        if (isGuardClosed)
+            isGuardBroken = true;
+
+        DIRECTIVE_KIND kind{ GetDirectiveKind(token) };
+
+        if (kind == DK_NONE) {
+            hasSeenToken = true;
+            token = lexer.ReadToken();
+            continue;
+        }
+
+        // Every translation unit that includes the file reads its lines.
+        Owner<DirectiveLine> line{ NewChild<DirectiveLine>() };
+        line->Kind = kind;
+        line->Directive = token;
+        token->MarkShared();
+
+        for (;;) {
+            token = lexer.ReadToken();
+            if (IsSyntaxNode<EofToken>(token)
+                || (token->GetFlags() & SyntaxToken::BEGINNING_OF_LINE))
+                break;
+            if (!IsSyntaxNode<CommentToken>(token)) {
+                token->MarkShared();
+                line->Arguments.push_back(token);
+            }
+        }
+
+        if (const std::string* name{ line->Arguments.empty() ? nullptr : GetIdentifierName(line->Arguments[0]) }) {
+            line->HasName = true;
+            line->Name = *name;
+        }
+
+        if (kind == DK_IF || kind == DK_IFDEF || kind == DK_IFNDEF) {
+            if (!hasSeenToken && kind == DK_IFNDEF && line->HasName)
+                guardCandidate = line->Name;
+            ++nesting;
+        }
+        else if (kind == DK_ELSE || kind == DK_ELIF) {
+            // Lines past the guard's own #else are read when the macro is
+            // defined, so the file must be scanned each time.
+            if (nesting == 1)
+                isGuardBroken = true;
+        }
+        else if (kind == DK_ENDIF) {
+            if (--nesting == 0 && !guardCandidate.empty())
+                isGuardClosed = true;
+        }
+
+        hasSeenToken = true;
+        file->Directives.push_back(std::move(line));
+    }
+
+    if (isGuardClosed && !isGuardBroken && nesting == 0)
+        file->GuardMacro = guardCandidate;
+}
+
+static void ScanHeader(SCAN_STATE& state, HEADER_INFO* file, int depth) {
+    std::call_once(file->IsLexed, LexDirectives, file);
+
+    std::vector<ConditionalFrame> conditionals{ };
+
+    for (const Owner<DirectiveLine>& line : file->Directives) {
+        const Rc<SyntaxToken>& directive{ line->Directive };
+        const std::vector<Rc<SyntaxToken>>& arguments{ line->Arguments };
+        const std::string* name{ line->HasName ? &line->Name : nullptr };
+        bool isActive{ conditionals.empty() || conditionals.back().IsActive };
+
+        switch (line->Kind) {
+        case DK_IFDEF:
+        case DK_IFNDEF: {
+            ConditionalFrame frame{ };
+            frame.WasParentActive = isActive;
+            frame.IsActive = false;
+
+            if (isActive) {
+                if (!name)
+                    Report(state, directive, "no macro name given in directive");
+                else
+                    frame.IsActive = (FindMacro(state, *name) != nullptr) != (line->Kind == DK_IFNDEF);
+            }
+
+            frame.WasAnyBranchTaken = frame.IsActive;
+            conditionals.push_back(frame);
+            break;
+        }
+
+        case DK_IF: {
+            ConditionalFrame frame{ };
+            frame.WasParentActive = isActive;
+            frame.IsActive = isActive && EvaluateCondition(state, directive, arguments);
+            frame.WasAnyBranchTaken = frame.IsActive;
+            conditionals.push_back(frame);
+            break;
+        }
+
+        case DK_ELIF:
+            if (conditionals.empty()) {
+                Report(state, directive, "#elif without #if");
+            }
+            else if (conditionals.back().HasSeenElse) {
+                Report(state, directive, "#elif after #else");
+            }
+            else {
+                ConditionalFrame& frame{ conditionals.back() };
+                frame.IsActive = frame.WasParentActive
+                    && !frame.WasAnyBranchTaken
+                    && EvaluateCondition(state, directive, arguments);
+                frame.WasAnyBranchTaken = frame.WasAnyBranchTaken || frame.IsActive;
+            }
+            break;
+
+        case DK_ELSE:
+            if (conditionals.empty()) {
+                Report(state, directive, "#else without #if");
+            }
+            else if (conditionals.back().HasSeenElse) {
+                Report(state, directive, "#else after #else");
+            }
+            else {
+                ConditionalFrame& frame{ conditionals.back() };
+                frame.IsActive = frame.WasParentActive && !frame.WasAnyBranchTaken;
+                frame.WasAnyBranchTaken = true;
+                frame.HasSeenElse = true;
+            }
+            break;
+
+        case DK_ENDIF:
+            if (conditionals.empty())
+                Report(state, directive, "#endif without #if");
+            else
+                conditionals.pop_back();
+            break;
+
+        case DK_INCLUDE:
+            if (isActive)
+                IncludeFile(state, file, *line, depth);
+            break;
+
+        case DK_DEFINE:
+            if (isActive)
+                DefineMacro(state, directive, arguments);
+            break;
+
+        case DK_UNDEF:
+            if (isActive) {
+                if (name)
+                    UndefineMacro(state, *name);
+                else
+                    Report(state, directive, "no macro name given in #undef directive");
+            }
+            break;
+
+        case DK_PRAGMA:
+            if (isActive && name && *name == "once")
+                state.OnceFiles.insert(file);
+            break;
+
+        case DK_ERROR:
+            if (isActive)
+                Report(state, directive, "#error directive");
+            break;
+
+        case DK_NONE:
+        case DK_OTHER:
+            break;
+        }
+    }
+
+    if (!conditionals.empty())
+        Report(state, file->Directives.back()->Directive, "unterminated conditional directive");
+}
+
+DependencyScanner::DependencyScanner(const std::vector<std::string>& includePaths) :
+    s{ NewChild<DEPENDENCY_SCANNER_IMPL>() }
+{
+    s->IncludePaths = includePaths;
+}
+
+DependencyScanner::~DependencyScanner() {}
+
+void DependencyScanner::AddVirtualFile(
+    const std::string& path,
+    const std::string& contents
+)
+{
+    Rc<SourceFile> file{ CreateSourceFile(path, contents) };
+    file->MarkShared();
+    s->VirtualFiles[path] = file;
+}
+
+ScanResult DependencyScanner::ScanFile(const std::string& path) {
+    ScanResult result{ };
+    result.Succeeded = true;
+
+    HEADER_INFO* input{ LookupFile(s.get(), path) };
+    if (!input) {
+        ScanDiagnostic diagnostic{ };
+        diagnostic.Message = "cannot open " + path;
+        result.Diagnostics.push_back(diagnostic);
+        result.Succeeded = false;
+        return result;
+    }
+
+    SCAN_STATE state{ };
+    state.Scanner = s.get();
+    state.Result = &result;
+    state.Prelude = s->Prelude.get();
+    state.SeenFiles.insert(input);
+    result.Dependencies.push_back(path);
+
+    if (state.Prelude) {
+        result.Dependencies.insert(
+            result.Dependencies.end(),
+            state.Prelude->Dependencies.begin(),
+            state.Prelude->Dependencies.end()
+        );
+    }
+
+    ScanHeader(state, input, 0);
+
+    return result;
+}
+
+/** Bump whenever the layout of a precompiled header changes. */
+static constexpr uint32_t PCH_VERSION{ 1 };
+
+static constexpr char PCH_MAGIC[8]{ 'C', 'M', 'B', 'P', 'C', 'H', 0, 0 };
+
+static constexpr uint32_t PCH_NO_INDEX{ UINT32_MAX };
+
+/**
+ * A precompiled header is this header followed by, in order: the file
+ * records, the macro records, the token records of the macro bodies, the
+ * token operands, the string table and the string data.
+ *
+ * Declarations and types will follow the macros once the compiler has a
+ * semantic layer; adding them bumps PCH_VERSION.
+ */
+struct PCH_HEADER {
+    char     Magic[8];
+    uint32_t Version;
+    uint32_t RecordSize;
+    uint64_t SchemaHash;
+    uint64_t IncludePathsHash;
+    uint32_t FileCount;
+    uint32_t MacroCount;
+    uint32_t TokenCount;
+    uint32_t OperandCount;
+    uint32_t StringCount;
+    uint32_t Reserved;
+    uint64_t StringDataSize;
+    uint64_t PayloadHash;
+};
+
+static constexpr uint32_t PF_PRAGMA_ONCE{ 0x1 };
+
+/** A header included by the precompiled header, in inclusion order. */
+struct PCH_FILE_RECORD {
+    uint32_t Path;
+    uint32_t GuardMacro;
+    uint32_t Flags;
+};
+
+static constexpr uint32_t PM_FUNCTION_LIKE{ 0x1 };
+
+struct PCH_MACRO_RECORD {
+    uint32_t Name;
+    /** File the body tokens come from, or PCH_NO_INDEX. */
+    uint32_t File;
+    uint32_t FirstToken;
+    uint32_t TokenCount;
+    uint32_t Flags;
+};
+
+static uint64_t HashIncludePaths(const std::vector<std::string>& includePaths) {
+    uint64_t hash{ FNV_OFFSET_BASIS };
+    for (const std::string& path : includePaths)
+        hash = HashBytes(path.c_str(), path.size() + 1, hash);
+    return hash;
+}
+
+ScanResult DependencyScanner::WritePrecompiledHeader(
+    const std::string& headerPath,
+    const std::string& outputPath
+)
+{
+    ScanResult result{ };
+    result.Succeeded = true;
+
+    HEADER_INFO* input{ LookupFile(s.get(), headerPath) };
+    if (!input) {
+        ScanDiagnostic diagnostic{ };
+        diagnostic.Message = "cannot open " + headerPath;
+        result.Diagnostics.push_back(diagnostic);
+        result.Succeeded = false;
+        return result;
+    }
+
+    SCAN_STATE state{ };
+    state.Scanner = s.get();
+    state.Result = &result;
+    state.SeenFiles.insert(input);
+    result.Dependencies.push_back(headerPath);
+
+    ScanHeader(state, input, 0);
+
+    if (!result.Succeeded)
+        return result;
+
+    StringTableBuilder                        strings{ };
+    std::vector<PCH_FILE_RECORD>              files{ };
+    std::vector<PCH_MACRO_RECORD>             macros{ };
+    std::vector<TOKEN_RECORD>                 tokens{ };
+    std::vector<uint32_t>                     operands{ };
+    std::unordered_map<std::string, uint32_t> fileIndices{ };
+
+    for (const std::string& path : result.Dependencies) {
+        HEADER_INFO* header{ LookupFile(s.get(), path) };
+
+        PCH_FILE_RECORD file{ };
+        file.Path = strings.Add(path);
+        file.GuardMacro = header->GuardMacro.empty() ? PCH_NO_INDEX : strings.Add(header->GuardMacro);
+        file.Flags = state.OnceFiles.count(header) ? PF_PRAGMA_ONCE : 0;
+
+        fileIndices.emplace(path, static_cast<uint32_t>(files.size()));
+        files.push_back(file);
+    }
+
+    for (const auto& [name, definition] : state.Macros) {
+        PCH_MACRO_RECORD macro{ };
+        macro.Name = strings.Add(name);
+        macro.File = PCH_NO_INDEX;
+        macro.FirstToken = static_cast<uint32_t>(tokens.size());
+        macro.TokenCount = static_cast<uint32_t>(definition.Body.size());
+        macro.Flags = definition.IsFunctionLike ? PM_FUNCTION_LIKE : 0;
+
+        if (!definition.Body.empty()) {
+            const Rc<const SourceFile>& source{ definition.Body[0]->GetLexemeRange().Location.Source };
+            auto file = source ? fileIndices.find(source->Name) : fileIndices.end();
+            if (file != fileIndices.end())
+                macro.File = file->second;
+        }
+
+        for (const Rc<SyntaxToken>& token : definition.Body)
+            tokens.push_back(EncodeToken(token, strings, operands));
+
+        macros.push_back(macro);
+    }
+
+    std::string payload{ };
+    AppendBytes(payload, files.data(), files.size() * sizeof(PCH_FILE_RECORD));
+    AppendBytes(payload, macros.data(), macros.size() * sizeof(PCH_MACRO_RECORD));
+    AppendBytes(payload, tokens.data(), tokens.size() * sizeof(TOKEN_RECORD));
+    AppendBytes(payload, operands.data(), operands.size() * sizeof(uint32_t));
+    AppendBytes(payload, strings.Strings.data(), strings.Strings.size() * sizeof(STRING_RECORD));
+    payload += strings.Data;
+
+    PCH_HEADER header{ };
+    memcpy(header.Magic, PCH_MAGIC, sizeof(header.Magic));
+    header.Version          = PCH_VERSION;
+    header.RecordSize       = sizeof(TOKEN_RECORD);
+    header.SchemaHash       = GetSyntaxSchemaHash();
+    header.IncludePathsHash = HashIncludePaths(s->IncludePaths);
+    header.FileCount        = static_cast<uint32_t>(files.size());
+    header.MacroCount       = static_cast<uint32_t>(macros.size());
+    header.TokenCount       = static_cast<uint32_t>(tokens.size());
+    header.OperandCount     = static_cast<uint32_t>(operands.size());
+    header.StringCount      = static_cast<uint32_t>(strings.Strings.size());
+    header.StringDataSize   = strings.Data.size();
+    header.PayloadHash      = HashBytes(payload.data(), payload.size());
+
+    std::string contents{ };
+    AppendBytes(contents, &header, sizeof(header));
+    contents += payload;
+
+    if (!ReplaceFile(outputPath, contents)) {
+        ScanDiagnostic diagnostic{ };
+        diagnostic.Message = "cannot write " + outputPath;
+        result.Diagnostics.push_back(diagnostic);
+        result.Succeeded = false;
+    }
+
+    return result;
+}
+
+bool DependencyScanner::LoadPrecompiledHeader(const std::string& path) {
+    Rc<MappedFile> file{ OpenMappedFile(path) };
+    if (file == nullptr || file->GetSize() < sizeof(PCH_HEADER))
+        return false;
+
+    PCH_HEADER header{ };
+    memcpy(&header, file->GetData(), sizeof(header));
+
+    if (memcmp(header.Magic, PCH_MAGIC, sizeof(header.Magic)) != 0
+        || header.Version != PCH_VERSION
+        || header.RecordSize != sizeof(TOKEN_RECORD)
+        || header.SchemaHash != GetSyntaxSchemaHash()
+        || header.IncludePathsHash != HashIncludePaths(s->IncludePaths))
+        return false;
+
+    uint64_t filesSize{ uint64_t{ header.FileCount } * sizeof(PCH_FILE_RECORD) };
+    uint64_t macrosSize{ uint64_t{ header.MacroCount } * sizeof(PCH_MACRO_RECORD) };
+    uint64_t tokensSize{ uint64_t{ header.TokenCount } * sizeof(TOKEN_RECORD) };
+    uint64_t operandsSize{ uint64_t{ header.OperandCount } * sizeof(uint32_t) };
+    uint64_t stringsSize{ uint64_t{ header.StringCount } * sizeof(STRING_RECORD) };
+    uint64_t payloadSize{ file->GetSize() - sizeof(PCH_HEADER) };
+
+    if (header.StringDataSize > payloadSize
+        || filesSize + macrosSize + tokensSize + operandsSize + stringsSize + header.StringDataSize != payloadSize)
+        return false;
+
+    const char* payload{ file->GetData() + sizeof(PCH_HEADER) };
+    if (HashBytes(payload, payloadSize) != header.PayloadHash)
+        return false;
+
+    const char* fileData{ payload };
+    const char* macroData{ fileData + filesSize };
+    const char* tokenData{ macroData + macrosSize };
+    const char* operandData{ tokenData + tokensSize };
+    const char* stringData{ operandData + operandsSize };
+    const char* characterData{ stringData + stringsSize };
+
+    std::vector<std::string> strings{ };
+    if (!ReadStringTable(stringData, header.StringCount, characterData, header.StringDataSize, strings))
+        return false;
+
+    std::vector<uint32_t> operands(header.OperandCount);
+    if (!operands.empty())
+        memcpy(operands.data(), operandData, operandsSize);
+    for (uint32_t operand : operands) {
+        if (operand >= header.StringCount)
+            return false;
+    }
+
+    auto isString = [&](uint32_t index) { return index < header.StringCount; };
+
+    Owner<PRELUDE_STATE> prelude{ NewChild<PRELUDE_STATE>() };
+    prelude->Path = path;
+    prelude->Dependencies.push_back(path);
+
+    // Body tokens point at stand-ins that only carry the file name; the
+    // headers themselves are not read.
+    std::vector<Rc<const SourceFile>> sources{ };
+
+    for (uint32_t i{ 0 }; i < header.FileCount; ++i) {
+        PCH_FILE_RECORD record{ };
+        memcpy(&record, fileData + i * sizeof(PCH_FILE_RECORD), sizeof(record));
+
+        if (!isString(record.Path)
+            || (record.GuardMacro != PCH_NO_INDEX && !isString(record.GuardMacro)))
+            return false;
+
+        const std::string& filePath{ strings[record.Path] };
+        prelude->Dependencies.push_back(filePath);
+        prelude->DependencySet.insert(filePath);
+        if (record.GuardMacro != PCH_NO_INDEX)
+            prelude->GuardMacros[filePath] = strings[record.GuardMacro];
+        if (record.Flags & PF_PRAGMA_ONCE)
+            prelude->OnceFiles.insert(filePath);
+
+        sources.push_back(NewObj<SourceFile>(filePath, std::vector<char>{ }));
+        sources.back()->MarkShared();
+    }
+
+    for (uint32_t i{ 0 }; i < header.MacroCount; ++i) {
+        PCH_MACRO_RECORD record{ };
+        memcpy(&record, macroData + i * sizeof(PCH_MACRO_RECORD), sizeof(record));
+
+        if (!isString(record.Name)
+            || (record.File != PCH_NO_INDEX && record.File >= header.FileCount)
+            || uint64_t{ record.FirstToken } + record.TokenCount > header.TokenCount)
+            return false;
+
+        MacroDefinition macro{ };
+        macro.IsFunctionLike = (record.Flags & PM_FUNCTION_LIKE) != 0;
+        macro.Body.reserve(record.TokenCount);
+
+        for (uint32_t j{ 0 }; j < record.TokenCount; ++j) {
+            TOKEN_RECORD tokenRecord{ };
+            memcpy(
+                &tokenRecord,
+                tokenData + (uint64_t{ record.FirstToken } + j) * sizeof(TOKEN_RECORD),
+                sizeof(tokenRecord)
+            );
+
+            if (!IsValidTokenRecord(tokenRecord, header.OperandCount))
+                return false;
+
+            Rc<SyntaxToken> token{ DecodeToken(tokenRecord, operands.data(), strings) };
+            if (record.File != PCH_NO_INDEX) {
+                SourceRange range{ token->GetLexemeRange() };
+                range.Location.Source = sources[record.File];
+                token->SetLexemeRange(range);
+            }
+            // Every translation unit scanned afterwards reads the macros.
+            token->MarkShared();
+            macro.Body.push_back(token);
+        }
+
+        prelude->Macros[strings[record.Name]] = std::move(macro);
+    }
+
+    s->Prelude = std::move(prelude);
+    return true;
+}
+
+static std::string EscapeMakePath(const std::string& path) {
+    std::string escaped{ };
+    escaped.reserve(path.size());
+
+    for (char c : path) {
+        if (c == ' ' || c == '#')
+            escaped += '\\';
+        else if (c == '$')
+            escaped += '$';
+        escaped += c;
+    }
+
+    return escaped;
+}
+
+std::string FormatMakeRule(
+    const std::string&              target,
+    const std::vector<std::string>& dependencies
+)
+{
+    static constexpr size_t MAX_LINE_LENGTH = 78;
+
+    std::string rule{ EscapeMakePath(target) + ":" };
+    size_t lineLength{ rule.size() };
+
+    for (const std::string& dependency : dependencies) {
+        std::string escaped{ EscapeMakePath(dependency) };
+
+        if (lineLength + 1 + escaped.size() > MAX_LINE_LENGTH && lineLength > 1) {
+            rule += " \\\n";
+            lineLength = 0;
+        }
+
+        rule += ' ';
+        rule += escaped;
+        lineLength += 1 + escaped.size();
+    }
+
+    rule += '\n';
+    return rule;
+}
+
+std::string GetObjectFileName(const std::string& inputPath) {
+    size_t slash{ inputPath.find_last_of("/\\") };
+    std::string name{ slash == std::string::npos ? inputPath : inputPath.substr(slash + 1) };
+
+    size_t dot{ name.find_last_of('.') };
+    if (dot != std::string::npos)
+        name.resize(dot);
+
+    return name + ".o";
+}
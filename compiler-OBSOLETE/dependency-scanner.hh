@@ -0,0 +1,87 @@
+#ifndef COMBUST_DEPENDENCY_SCANNER_HH
+#define COMBUST_DEPENDENCY_SCANNER_HH
+#include "common.hh"
+#include "source.hh"
+#include <string>
+#include <vector>
+
+struct ScanDiagnostic {
+    SourceLoc   Location{ };
+    std::string Message{ };
+    bool        IsError{ true };
+};
+
+struct ScanResult {
+    /** The input itself, then every header in first-inclusion order. */
+    std::vector<std::string>    Dependencies{ };
+    std::vector<ScanDiagnostic> Diagnostics{ };
+    bool                        Succeeded{ false };
+};
+
+struct DEPENDENCY_SCANNER_IMPL;
+
+/**
+ * Discovers the headers a translation unit depends on by running only the
+ * directive layer of the preprocessor. Inactive conditional blocks are
+ * skipped, include guards and #pragma once are honored, and every file is
+ * read at most once per scanner instance.
+ *
+ * ScanFile may be called from several threads at once; share one scanner
+ * across a run so the file cache is shared as well. Load a precompiled
+ * header before scanning starts.
+ */
+class DependencyScanner : public Object {
+public:
+    explicit DependencyScanner(const std::vector<std::string>& includePaths);
+    virtual ~DependencyScanner();
+
+    /**
+     * Makes path resolve to the given contents instead of the file system.
+     */
+    void AddVirtualFile(const std::string& path, const std::string& contents);
+
+    ScanResult ScanFile(const std::string& path);
+
+    /**
+     * Scans a prelude header and saves the preprocessor state it leaves
+     * behind (macros, include guards, #pragma once files and the headers
+     * it pulled in) to outputPath as a precompiled header.
+     *
+     * \return the scan of headerPath; Succeeded is false if it has errors
+     *         or the precompiled header cannot be written
+     */
+    ScanResult WritePrecompiledHeader(
+        const std::string& headerPath,
+        const std::string& outputPath
+    );
+
+    /**
+     * Makes every following ScanFile start from the state saved by
+     * WritePrecompiledHeader, as if the prelude were included first. The
+     * precompiled header and the headers it was built from are listed as
+     * dependencies of every file; rebuild it whenever one of them changes.
+     *
+     * \return false if the file is missing, corrupt, from another version,
+     *         or built with different include paths
+     */
+    bool LoadPrecompiledHeader(const std::string& path);
+
+private:
+    Owner<DEPENDENCY_SCANNER_IMPL> s;
+};
+
+/**
+ * Formats a make rule in the style of -M, wrapping long lines with "\".
+ */
+std::string FormatMakeRule(
+    const std::string&              target,
+    const std::vector<std::string>& dependencies
+);
+
+/**
+ * \return the default -M target for an input: its file name with the
+ *         extension replaced by ".o"
+ */
+std::string GetObjectFileName(const std::string& inputPath);
+
+#endif
@@ -0,0 +1,546 @@
+#include "diagnostic-engine.hh"
+#include "json-writer.hh"
+#include "logger.hh"
+#include <stdio.h>
+#include <iterator>
+
+#if defined(_WIN32)
+#define RED_B     ""
+#define YELLOW_B  ""
+#define WHITE     ""
+#define WHITE_B   ""
+#else
+#define RED_B     "\x1b[1m\x1b[31m"
+#define YELLOW_B  "\x1b[1m\x1b[33m"
+#define WHITE     "\x1b[0m"
+#define WHITE_B   "\x1b[1m\x1b[0m"
+#endif
+
+static const char* GetLevelLabel(LOG_LEVEL level) {
+    switch (level) {
+    case LL_INFO:    return WHITE;
+    case LL_WARNING: return YELLOW_B "warning: " WHITE;
+    case LL_ERROR:   return RED_B "error: " WHITE;
+    default:         return RED_B "fatal error: " WHITE;
+    }
+}
+
+struct DIAGNOSTIC_INFO {
+    const char* Name;
+    LOG_LEVEL   Level;
+    const char* Flag;
+    const char* Format;
+};
+
+static const DIAGNOSTIC_INFO DIAGNOSTIC_INFOS[DK_COUNT]{
+#define Dg(name, level, flag, format) { #name, level, flag, format },
+#include "diagnostic-kinds.def"
+#undef Dg
+};
+
+LOG_LEVEL GetDiagnosticLevel(DIAGNOSTIC_KIND kind) {
+    return DIAGNOSTIC_INFOS[kind].Level;
+}
+
+const char* GetDiagnosticFlag(DIAGNOSTIC_KIND kind) {
+    return DIAGNOSTIC_INFOS[kind].Flag;
+}
+
+static void AppendArgument(IN_OUT std::string& text, const DiagnosticArgument& argument) {
+    if (argument.IsText)
+        text += argument.Text;
+    else
+        text += std::to_string(argument.Integer);
+}
+
+/**
+ * Appends format with %0, %1, ... replaced by the arguments. A reference
+ * past the last argument is left as it is.
+ */
+static void AppendMessage(
+    IN_OUT std::string&       text,
+    const char*               format,
+    const DiagnosticArgument* arguments,
+    size_t                    argumentCount
+) {
+    for (const char* c{ format }; *c != 0; ++c) {
+        if (c[0] != '%' || c[1] == 0) {
+            text += *c;
+        }
+        else if (c[1] == '%') {
+            text += '%';
+            ++c;
+        }
+        else if (c[1] >= '0' && c[1] <= '9' && static_cast<size_t>(c[1] - '0') < argumentCount) {
+            AppendArgument(text, arguments[c[1] - '0']);
+            ++c;
+        }
+        else {
+            text += *c;
+        }
+    }
+}
+
+/**
+ * Appends the source line with tabs widened to four columns, then a caret
+ * under the start of range and tildes under the rest of it.
+ */
+static void AppendSourceExcerpt(IN_OUT std::string& text, const DiagnosticRecord& record) {
+    std::string line{ record.Source->GetLine(record.Line) };
+    int column{ record.Column };
+    int end{ column + (record.Length > 1 ? record.Length : 1) };
+
+    for (char c : line) {
+        if (c == '\t')
+            text += "    ";
+        else
+            text += c;
+    }
+    text += '\n';
+
+    for (int i{ 0 }; i < end; ++i) {
+        size_t width{ i < static_cast<int>(line.size()) && line[i] == '\t' ? 4u : 1u };
+
+        if (i < column)
+            text.append(width, ' ');
+        else if (i == column)
+            text += '^';
+        else
+            text.append(width, '~');
+    }
+    text += '\n';
+}
+
+/**
+ * Appends the diagnostic as people read it: the location, the level, the
+ * message and the source excerpt.
+ */
+static void AppendTextRecord(
+    IN_OUT std::string&       text,
+    const DiagnosticRecord&   record,
+    const DiagnosticArgument* arguments
+) {
+    const DIAGNOSTIC_INFO& info{ DIAGNOSTIC_INFOS[record.Kind] };
+
+    text += WHITE_B;
+    if (record.Source != nullptr) {
+        text += record.Source->Name;
+        text += ':';
+        text += std::to_string(record.Line + 1);
+        text += ':';
+        text += std::to_string(record.Column + 1);
+    }
+    else if (g_ProgramName != nullptr) {
+        text += g_ProgramName;
+    }
+    text += ": ";
+
+    text += GetLevelLabel(info.Level);
+    AppendMessage(text, info.Format, arguments, record.ArgumentCount);
+    text += '\n';
+
+    if (record.Source != nullptr)
+        AppendSourceExcerpt(text, record);
+}
+
+/**
+ * \return the offset in bytes of the start of the record's range in its
+ *         file, or -1 if the line is not in the file
+ */
+static int64_t GetByteOffset(const DiagnosticRecord& record) {
+    const std::vector<int>& lineStarts{ record.Source->GetLineStarts() };
+    if (record.Line < 0 || record.Line >= static_cast<int>(lineStarts.size()))
+        return -1;
+
+    return int64_t{ lineStarts[record.Line] } + record.Column;
+}
+
+static const char* GetSeverityName(LOG_LEVEL level) {
+    switch (level) {
+    case LL_INFO:    return "note";
+    case LL_WARNING: return "warning";
+    case LL_ERROR:   return "error";
+    default:         return "fatal";
+    }
+}
+
+/**
+ * Appends the diagnostic as one line of JSON. Lines and columns count from
+ * 1, as in text output; the location is left out if there is none.
+ */
+static void AppendJsonRecord(
+    IN_OUT std::string&       text,
+    const DiagnosticRecord&   record,
+    const DiagnosticArgument* arguments
+) {
+    const DIAGNOSTIC_INFO& info{ DIAGNOSTIC_INFOS[record.Kind] };
+    std::string message{ };
+    AppendMessage(message, info.Format, arguments, record.ArgumentCount);
+
+    text += '{';
+    AppendJsonKey(text, "severity");
+    AppendJsonString(text, GetSeverityName(info.Level));
+    text += ',';
+    AppendJsonKey(text, "kind");
+    AppendJsonString(text, info.Name);
+
+    if (info.Flag[0] != 0) {
+        text += ',';
+        AppendJsonKey(text, "flag");
+        AppendJsonString(text, info.Flag);
+    }
+
+    text += ',';
+    AppendJsonKey(text, "message");
+    AppendJsonString(text, message);
+
+    if (record.Source != nullptr) {
+        text += ',';
+        AppendJsonKey(text, "file");
+        AppendJsonString(text, record.Source->Name);
+        text += ',';
+        AppendJsonKey(text, "offset");
+        AppendJsonNumber(text, GetByteOffset(record));
+        text += ',';
+        AppendJsonKey(text, "length");
+        AppendJsonNumber(text, record.Length);
+        text += ',';
+        AppendJsonKey(text, "line");
+        AppendJsonNumber(text, record.Line + 1);
+        text += ',';
+        AppendJsonKey(text, "column");
+        AppendJsonNumber(text, record.Column + 1);
+    }
+
+    text += "}\n";
+}
+
+static const char* GetSarifLevel(LOG_LEVEL level) {
+    switch (level) {
+    case LL_INFO:    return "note";
+    case LL_WARNING: return "warning";
+    default:         return "error";
+    }
+}
+
+/**
+ * Appends the diagnostic as a SARIF result object, with no separator.
+ */
+static void AppendSarifResult(
+    IN_OUT std::string&       text,
+    const DiagnosticRecord&   record,
+    const DiagnosticArgument* arguments
+) {
+    const DIAGNOSTIC_INFO& info{ DIAGNOSTIC_INFOS[record.Kind] };
+    std::string message{ };
+    AppendMessage(message, info.Format, arguments, record.ArgumentCount);
+
+    text += '{';
+    AppendJsonKey(text, "ruleId");
+    AppendJsonString(text, info.Name);
+    text += ',';
+    AppendJsonKey(text, "level");
+    AppendJsonString(text, GetSarifLevel(info.Level));
+    text += ',';
+    AppendJsonKey(text, "message");
+    text += '{';
+    AppendJsonKey(text, "text");
+    AppendJsonString(text, message);
+    text += '}';
+
+    if (record.Source != nullptr) {
+        int length{ record.Length > 1 ? record.Length : 1 };
+
+        text += ',';
+        AppendJsonKey(text, "locations");
+        text += "[{";
+        AppendJsonKey(text, "physicalLocation");
+        text += '{';
+        AppendJsonKey(text, "artifactLocation");
+        text += '{';
+        AppendJsonKey(text, "uri");
+        AppendJsonString(text, record.Source->Name);
+        text += "},";
+        AppendJsonKey(text, "region");
+        text += '{';
+        AppendJsonKey(text, "startLine");
+        AppendJsonNumber(text, record.Line + 1);
+        text += ',';
+        AppendJsonKey(text, "startColumn");
+        AppendJsonNumber(text, record.Column + 1);
+        text += ',';
+        AppendJsonKey(text, "endColumn");
+        AppendJsonNumber(text, record.Column + 1 + length);
+
+        if (int64_t offset{ GetByteOffset(record) }; offset >= 0) {
+            text += ',';
+            AppendJsonKey(text, "byteOffset");
+            AppendJsonNumber(text, offset);
+            text += ',';
+            AppendJsonKey(text, "byteLength");
+            AppendJsonNumber(text, length);
+        }
+
+        text += "}}}]";
+    }
+
+    text += '}';
+}
+
+static void AppendRecord(
+    IN_OUT std::string&       text,
+    const DiagnosticRecord&   record,
+    const DiagnosticArgument* arguments,
+    DIAGNOSTIC_FORMAT         format
+) {
+    switch (format) {
+    case DF_TEXT:
+        AppendTextRecord(text, record, arguments);
+        break;
+    case DF_JSON:
+        AppendJsonRecord(text, record, arguments);
+        break;
+    case DF_SARIF:
+        if (!text.empty())
+            text += ",\n";
+        AppendSarifResult(text, record, arguments);
+        break;
+    }
+}
+
+bool DiagnosticBuffer::IsDroppedEarly(DIAGNOSTIC_KIND kind) {
+    if (engine == nullptr)
+        return false;
+
+    LOG_LEVEL level{ GetDiagnosticLevel(kind) };
+
+    if (level == LL_WARNING && engine->IsSuppressed(kind)) {
+        ++suppressedWarningCount;
+        return true;
+    }
+    if (level == LL_ERROR && engine->IsErrorLimitReached()) {
+        ++errorCount;
+        ++droppedErrorCount;
+        return true;
+    }
+
+    return false;
+}
+
+void DiagnosticBuffer::AddRecord(DIAGNOSTIC_KIND kind, PCSOURCE_RANGE range, size_t argumentCount) {
+    DiagnosticRecord record{ };
+    record.Kind = static_cast<uint16_t>(kind);
+    record.FirstArgument = static_cast<uint32_t>(arguments.size());
+    record.ArgumentCount = static_cast<uint16_t>(argumentCount);
+
+    if (range != nullptr && range->Location.Source != nullptr) {
+        const Rc<const SourceFile>& source{ range->Location.Source };
+
+        // Diagnostics tend to come in runs from the same file, so checking
+        // the last one keeps the list short.
+        if (sources.empty() || sources.back() != source)
+            sources.push_back(source);
+
+        record.Source = source.get();
+        record.Line = range->Location.Line;
+        record.Column = range->Location.Column;
+        record.Length = range->Length;
+    }
+
+    records.push_back(record);
+
+    LOG_LEVEL level{ GetDiagnosticLevel(kind) };
+    if (level >= LL_ERROR)
+        ++errorCount;
+    else if (level == LL_WARNING)
+        ++warningCount;
+}
+
+void DiagnosticBuffer::Append(DiagnosticBuffer& other) {
+    for (DiagnosticRecord record : other.records) {
+        record.FirstArgument += static_cast<uint32_t>(arguments.size());
+        records.push_back(record);
+    }
+
+    arguments.insert(
+        arguments.end(),
+        std::make_move_iterator(other.arguments.begin()),
+        std::make_move_iterator(other.arguments.end())
+    );
+    sources.insert(sources.end(), other.sources.begin(), other.sources.end());
+
+    errorCount += other.errorCount;
+    warningCount += other.warningCount;
+    droppedErrorCount += other.droppedErrorCount;
+    suppressedWarningCount += other.suppressedWarningCount;
+    other.Clear();
+}
+
+std::string DiagnosticBuffer::Format(DIAGNOSTIC_FORMAT format) const {
+    std::string text{ };
+    for (const DiagnosticRecord& record : records)
+        AppendRecord(text, record, GetArguments(record), format);
+
+    return text;
+}
+
+const DiagnosticArgument* DiagnosticBuffer::GetArguments(const DiagnosticRecord& record) const {
+    return arguments.data() + record.FirstArgument;
+}
+
+bool DiagnosticBuffer::IsEmpty() const {
+    return records.empty() && droppedErrorCount == 0 && suppressedWarningCount == 0;
+}
+
+void DiagnosticBuffer::Clear() {
+    records.clear();
+    arguments.clear();
+    sources.clear();
+    errorCount = 0;
+    warningCount = 0;
+    droppedErrorCount = 0;
+    suppressedWarningCount = 0;
+}
+
+DiagnosticEngine::DiagnosticEngine(FILE* output) :
+    output{ output }
+{ }
+
+DiagnosticEngine::~DiagnosticEngine() { }
+
+DiagnosticBuffer& DiagnosticEngine::GetThreadBuffer() {
+    // Kept between calls so that its storage is reused.
+    thread_local DiagnosticBuffer buffer{ };
+    return buffer;
+}
+
+bool DiagnosticEngine::IsDroppedEarly(DIAGNOSTIC_KIND kind) {
+    LOG_LEVEL level{ GetDiagnosticLevel(kind) };
+
+    if (level == LL_WARNING && IsSuppressed(kind)) {
+        suppressedWarningCount.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    if (level == LL_ERROR && IsErrorLimitReached()) {
+        errorCount.fetch_add(1, std::memory_order_relaxed);
+        droppedErrorCount.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    return false;
+}
+
+void DiagnosticEngine::Flush(DiagnosticBuffer& buffer) {
+    if (buffer.IsEmpty())
+        return;
+
+    thread_local std::string text{ };
+    text.clear();
+
+    int shownWarningCount{ 0 };
+    int droppedCount{ buffer.GetDroppedErrorCount() };
+    int suppressedCount{ buffer.GetSuppressedWarningCount() };
+
+    for (const DiagnosticRecord& record : buffer.GetRecords()) {
+        DIAGNOSTIC_KIND kind{ static_cast<DIAGNOSTIC_KIND>(record.Kind) };
+        LOG_LEVEL level{ GetDiagnosticLevel(kind) };
+
+        if (level == LL_WARNING) {
+            if (IsSuppressed(kind)) {
+                ++suppressedCount;
+                continue;
+            }
+            ++shownWarningCount;
+        }
+        else if (level == LL_ERROR && errorLimit > 0
+                 && admittedErrorCount.fetch_add(1, std::memory_order_relaxed) >= errorLimit) {
+            ++droppedCount;
+            continue;
+        }
+
+        AppendRecord(text, record, buffer.GetArguments(record), format);
+    }
+
+    if (!text.empty())
+        Write(text);
+
+    errorCount.fetch_add(buffer.GetErrorCount(), std::memory_order_relaxed);
+    warningCount.fetch_add(shownWarningCount, std::memory_order_relaxed);
+    droppedErrorCount.fetch_add(droppedCount, std::memory_order_relaxed);
+    suppressedWarningCount.fetch_add(suppressedCount, std::memory_order_relaxed);
+    buffer.Clear();
+}
+
+/** Opens the log and its single run; results go in the run's array. */
+static const char SARIF_HEADER[]{
+    "{\"version\":\"2.1.0\","
+    "\"$schema\":\"https://json.schemastore.org/sarif-2.1.0.json\","
+    "\"runs\":[{\"tool\":{\"driver\":{\"name\":\"compiler\"}},\"results\":[\n"
+};
+static const char SARIF_FOOTER[]{ "\n]}]}\n" };
+
+void DiagnosticEngine::Write(const std::string& text) {
+    // Formatting is done by then, so the lock is only held for the write.
+    std::lock_guard<std::mutex> lock{ outputMutex };
+
+    if (format == DF_SARIF) {
+        if (!hasStarted)
+            fputs(SARIF_HEADER, output);
+        if (hasWrittenResult)
+            fputs(",\n", output);
+    }
+
+    fwrite(text.data(), 1, text.size(), output);
+    fflush(output);
+
+    hasStarted = true;
+    hasWrittenResult = true;
+}
+
+void DiagnosticEngine::Finish() {
+    std::lock_guard<std::mutex> lock{ outputMutex };
+
+    if (format == DF_SARIF) {
+        if (!hasStarted)
+            fputs(SARIF_HEADER, output);
+        fputs(SARIF_FOOTER, output);
+        fflush(output);
+    }
+
+    hasStarted = true;
+}
+
+void DiagnosticEngine::ReportSummary() {
+    if (int dropped{ GetDroppedErrorCount() }; dropped > 0)
+        Report(DK_ERRORS_NOT_SHOWN, nullptr, dropped, errorLimit);
+    if (int suppressed{ GetSuppressedWarningCount() }; suppressed > 0)
+        Report(DK_WARNINGS_SUPPRESSED, nullptr, suppressed);
+}
+
+bool DiagnosticEngine::SuppressWarning(const std::string& flag) {
+    bool isKnown{ false };
+
+    for (int kind{ 0 }; kind < DK_COUNT; ++kind) {
+        const DIAGNOSTIC_INFO& info{ DIAGNOSTIC_INFOS[kind] };
+
+        if (info.Level == LL_WARNING && info.Flag[0] != 0 && flag == info.Flag) {
+            suppressedKinds.set(kind);
+            isKnown = true;
+        }
+    }
+
+    return isKnown;
+}
+
+bool DiagnosticEngine::IsSuppressed(DIAGNOSTIC_KIND kind) const {
+    return GetDiagnosticLevel(kind) == LL_WARNING && (areAllWarningsSuppressed || suppressedKinds.test(kind));
+}
+
+bool DiagnosticEngine::IsErrorLimitReached() const {
+    return errorLimit > 0 && admittedErrorCount.load(std::memory_order_relaxed) >= errorLimit;
+}
+
+DiagnosticEngine& GetDiagnosticEngine() {
+    static DiagnosticEngine engine{ };
+    return engine;
+}
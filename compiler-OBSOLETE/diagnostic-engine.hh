@@ -0,0 +1,244 @@
+#ifndef COMBUST_DIAGNOSTIC_ENGINE_HH
+#define COMBUST_DIAGNOSTIC_ENGINE_HH
+#include "common.hh"
+#include "source.hh"
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <bitset>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+enum LOG_LEVEL {
+    LL_INFO,
+    LL_WARNING,
+    LL_ERROR,
+    LL_FATAL
+};
+
+enum DIAGNOSTIC_KIND {
+#define Dg(name, level, flag, format) DK_##name,
+#include "diagnostic-kinds.def"
+#undef Dg
+    DK_COUNT
+};
+
+enum DIAGNOSTIC_FORMAT {
+    /** Colored text with a source excerpt, for people. */
+    DF_TEXT,
+    /** One JSON object per diagnostic, each on a line of its own. */
+    DF_JSON,
+    /** A SARIF 2.1.0 log with one result per diagnostic. */
+    DF_SARIF
+};
+
+LOG_LEVEL GetDiagnosticLevel(DIAGNOSTIC_KIND kind);
+
+/**
+ * \return the name -Wno-<name> suppresses the diagnostic by, "" if none
+ */
+const char* GetDiagnosticFlag(DIAGNOSTIC_KIND kind);
+
+/**
+ * Integer or text a diagnostic is reported with, kept as is until the
+ * diagnostic is formatted.
+ */
+struct DiagnosticArgument {
+    DiagnosticArgument(const char* text) : Text{ text ? text : "" }, IsText{ true } { }
+    DiagnosticArgument(std::string text) : Text{ std::move(text) }, IsText{ true } { }
+
+    template<typename T, typename = std::enable_if_t<std::is_integral<T>::value || std::is_enum<T>::value>>
+    DiagnosticArgument(T value) : Integer{ static_cast<long long>(value) } { }
+
+    std::string Text{ };
+    long long   Integer{ 0 };
+    bool        IsText{ false };
+};
+
+/**
+ * A diagnostic as reported: its kind, where its arguments start in the
+ * buffer that holds it, and its location without the file's reference
+ * count, which the buffer holds instead.
+ */
+struct DiagnosticRecord {
+    const SourceFile* Source{ nullptr };
+    int32_t           Line{ 0 };
+    int32_t           Column{ 0 };
+    int32_t           Length{ 0 };
+    uint32_t          FirstArgument{ 0 };
+    uint16_t          Kind{ 0 };
+    uint16_t          ArgumentCount{ 0 };
+};
+
+class DiagnosticEngine;
+
+/**
+ * Diagnostics reported but not yet formatted, e.g. those of one task among
+ * several running in parallel. Flushing the buffers of all tasks in task
+ * order gives the same output whichever order the tasks ran in.
+ *
+ * A buffer made with an engine drops what that engine would drop before
+ * storing it; either way, the engine filters again when the buffer is
+ * flushed. A buffer may only be used by one thread at a time.
+ */
+class DiagnosticBuffer : public RefCounted {
+public:
+    explicit DiagnosticBuffer(const DiagnosticEngine* engine = nullptr) : engine{ engine } { }
+
+    /**
+     * Records a diagnostic, pointing into the source if range is not null
+     * and has a Source. Nothing is formatted until the buffer is flushed.
+     */
+    template<typename... Args>
+    void Report(DIAGNOSTIC_KIND kind, PCSOURCE_RANGE range, const Args&... args) {
+        if (IsDroppedEarly(kind))
+            return;
+
+        AddRecord(kind, range, sizeof...(args));
+        (arguments.emplace_back(args), ...);
+    }
+
+    /**
+     * Moves everything in other to the end of this buffer.
+     */
+    void Append(DiagnosticBuffer& other);
+
+    /**
+     * \return the diagnostics as they would be written, without filtering;
+     *         for DF_SARIF, the results without the log around them
+     */
+    std::string Format(DIAGNOSTIC_FORMAT format = DF_TEXT) const;
+
+    const std::vector<DiagnosticRecord>& GetRecords() const { return records; }
+    const DiagnosticArgument* GetArguments(const DiagnosticRecord& record) const;
+
+    /** Errors dropped before they were recorded are counted too. */
+    int GetErrorCount() const { return errorCount; }
+    int GetWarningCount() const { return warningCount; }
+    int GetDroppedErrorCount() const { return droppedErrorCount; }
+    int GetSuppressedWarningCount() const { return suppressedWarningCount; }
+
+    bool IsEmpty() const;
+    void Clear();
+
+private:
+    bool IsDroppedEarly(DIAGNOSTIC_KIND kind);
+    void AddRecord(DIAGNOSTIC_KIND kind, PCSOURCE_RANGE range, size_t argumentCount);
+
+    const DiagnosticEngine*           engine{ nullptr };
+    std::vector<DiagnosticRecord>     records{ };
+    std::vector<DiagnosticArgument>   arguments{ };
+    /** Keeps the files the records point into alive. */
+    std::vector<Rc<const SourceFile>> sources{ };
+    int                               errorCount{ 0 };
+    int                               warningCount{ 0 };
+    int                               droppedErrorCount{ 0 };
+    int                               suppressedWarningCount{ 0 };
+};
+
+/**
+ * Writes diagnostics, each flush with a single write, so diagnostics
+ * reported from several threads never interleave. Suppressed warnings and
+ * errors past the error limit are counted and dropped before they are
+ * formatted. Counts are kept atomically.
+ */
+class DiagnosticEngine : public Object {
+public:
+    explicit DiagnosticEngine(FILE* output = stderr);
+    virtual ~DiagnosticEngine();
+
+    /**
+     * Formats a diagnostic, unless it is dropped, into a buffer of the
+     * calling thread's own and writes it at once.
+     */
+    template<typename... Args>
+    void Report(DIAGNOSTIC_KIND kind, PCSOURCE_RANGE range, const Args&... args) {
+        if (IsDroppedEarly(kind))
+            return;
+
+        DiagnosticBuffer& buffer{ GetThreadBuffer() };
+        buffer.Report(kind, range, args...);
+        Flush(buffer);
+    }
+
+    /**
+     * Writes and counts everything in buffer that is not dropped, then
+     * clears it.
+     */
+    void Flush(DiagnosticBuffer& buffer);
+
+    /**
+     * Reports how many diagnostics were dropped, if any were.
+     */
+    void ReportSummary();
+
+    /**
+     * Completes the output; a SARIF log is only valid once this is called.
+     * Nothing may be reported afterwards.
+     */
+    void Finish();
+
+    /** Must be set before anything is reported. */
+    void SetFormat(DIAGNOSTIC_FORMAT format) { this->format = format; }
+    DIAGNOSTIC_FORMAT GetFormat() const { return format; }
+
+    /**
+     * Errors past the first limit are counted but not written; 0 means no
+     * limit. Fatal errors are always written.
+     */
+    void SetErrorLimit(int limit) { errorLimit = limit; }
+    int GetErrorLimit() const { return errorLimit; }
+
+    void SuppressAllWarnings() { areAllWarningsSuppressed = true; }
+
+    /**
+     * Suppresses the warnings -Wno-<flag> names.
+     *
+     * \return false if no warning has that flag
+     */
+    bool SuppressWarning(const std::string& flag);
+
+    bool IsSuppressed(DIAGNOSTIC_KIND kind) const;
+    bool IsErrorLimitReached() const;
+
+    /** Fatal errors, and errors past the limit, are counted as errors. */
+    int GetErrorCount() const { return errorCount.load(std::memory_order_relaxed); }
+    int GetWarningCount() const { return warningCount.load(std::memory_order_relaxed); }
+    int GetDroppedErrorCount() const { return droppedErrorCount.load(std::memory_order_relaxed); }
+    int GetSuppressedWarningCount() const { return suppressedWarningCount.load(std::memory_order_relaxed); }
+
+private:
+    /** Counts the diagnostic if so. */
+    bool IsDroppedEarly(DIAGNOSTIC_KIND kind);
+    static DiagnosticBuffer& GetThreadBuffer();
+
+    /** Writes text, the output of one flush, in the engine's format. */
+    void Write(const std::string& text);
+
+    FILE*                  output{ nullptr };
+    DIAGNOSTIC_FORMAT      format{ DF_TEXT };
+    int                    errorLimit{ 0 };
+    bool                   areAllWarningsSuppressed{ false };
+    std::bitset<DK_COUNT>  suppressedKinds{ };
+
+    /** Errors let through the limit so far, whether or not written yet. */
+    std::atomic<int>       admittedErrorCount{ 0 };
+    std::atomic<int>       errorCount{ 0 };
+    std::atomic<int>       warningCount{ 0 };
+    std::atomic<int>       droppedErrorCount{ 0 };
+    std::atomic<int>       suppressedWarningCount{ 0 };
+
+    /** Held while writing, so SARIF results are separated in output order. */
+    std::mutex             outputMutex{ };
+    bool                   hasStarted{ false };
+    bool                   hasWrittenResult{ false };
+};
+
+/**
+ * \return the engine behind Log, LogAt and LogAtRange
+ */
+DiagnosticEngine& GetDiagnosticEngine();
+
+#endif
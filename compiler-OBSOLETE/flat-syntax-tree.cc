@@ -0,0 +1,56 @@
+#include "flat-syntax-tree.hh"
+
+FlatSyntaxTree FlattenSyntaxTree(const Rc<SyntaxNode>& root) {
+    FlatSyntaxTree tree{ };
+    if (root == nullptr)
+        return tree;
+
+    // Children are pushed last to first so that they come off the stack,
+    // and into the arrays, in order.
+    std::vector<Rc<SyntaxNode>> pending{ root };
+
+    while (!pending.empty()) {
+        Rc<SyntaxNode> node{ std::move(pending.back()) };
+        pending.pop_back();
+
+        uint32_t index{ tree.GetNodeCount() };
+        SYNTAX_KIND kind{ node->GetKind() };
+        uint32_t childCount{ 0 };
+
+        tree.Kinds.push_back(kind);
+
+        if (IsSyntaxTokenKind(kind)) {
+            tree.TokenIndices.push_back(static_cast<uint32_t>(tree.Tokens.size()));
+            tree.Tokens.push_back(As<SyntaxToken>(node));
+        }
+        else {
+            tree.TokenIndices.push_back(FlatSyntaxTree::NONE);
+
+            const Expression& expression{ static_cast<const Expression&>(*node) };
+            for (size_t i{ expression.GetChildCount() }; i-- > 0; ) {
+                if (expression.GetChildNode(static_cast<int>(i)) != nullptr) {
+                    pending.push_back(expression.GetChild(static_cast<int>(i)));
+                    ++childCount;
+                }
+            }
+        }
+
+        tree.FirstChildren.push_back(childCount != 0 ? index + 1 : FlatSyntaxTree::NONE);
+        tree.ChildCounts.push_back(childCount);
+    }
+
+    // A subtree ends where the subtree of its last child does. Walking
+    // backwards, every child's end is known before its parent's.
+    uint32_t nodeCount{ tree.GetNodeCount() };
+    tree.SubtreeEnds.resize(nodeCount);
+
+    for (uint32_t i{ nodeCount }; i-- > 0; ) {
+        uint32_t end{ i + 1 };
+        for (uint32_t child{ 0 }; child < tree.ChildCounts[i]; ++child)
+            end = tree.SubtreeEnds[end];
+
+        tree.SubtreeEnds[i] = end;
+    }
+
+    return tree;
+}
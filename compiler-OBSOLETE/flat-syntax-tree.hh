@@ -0,0 +1,38 @@
+#ifndef COMBUST_FLAT_SYNTAX_TREE_HH
+#define COMBUST_FLAT_SYNTAX_TREE_HH
+#include "common.hh"
+#include "syntax.hh"
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Syntax tree stored as parallel arrays, one element per node, in preorder.
+ * A pass that does not care about structure is a loop over the arrays; one
+ * that does can step from a node to its first child and from there across
+ * siblings through SubtreeEnds, without touching the nodes themselves.
+ */
+struct FlatSyntaxTree {
+    /** Marks a missing child or token index. */
+    static constexpr uint32_t NONE{ UINT32_MAX };
+
+    std::vector<SYNTAX_KIND>     Kinds{ };
+    /** NONE for nodes without children. */
+    std::vector<uint32_t>        FirstChildren{ };
+    std::vector<uint32_t>        ChildCounts{ };
+    /** Index one past the node's subtree, i.e. its next sibling if any. */
+    std::vector<uint32_t>        SubtreeEnds{ };
+    /** Index into Tokens for tokens, NONE for expressions. */
+    std::vector<uint32_t>        TokenIndices{ };
+
+    std::vector<Rc<SyntaxToken>> Tokens{ };
+
+    uint32_t GetNodeCount() const { return static_cast<uint32_t>(Kinds.size()); }
+};
+
+/**
+ * Flattens the tree under root. Null children, which only appear in
+ * incomplete expressions, are left out.
+ */
+FlatSyntaxTree FlattenSyntaxTree(const Rc<SyntaxNode>& root);
+
+#endif
@@ -0,0 +1,197 @@
+#include "green-syntax.hh"
+#include "syntax-visitor.hh"
+#include <functional>
+#include <unordered_set>
+
+static void CombineHash(IN_OUT size_t& hash, size_t value) {
+    hash ^= value + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2);
+}
+
+GreenNode::GreenNode(
+    SYNTAX_KIND                kind,
+    SYNTAX_PRODUCTION          production,
+    uint32_t                   flags,
+    std::string                text,
+    std::vector<Rc<GreenNode>> children
+) :
+    kind{ kind },
+    production{ production },
+    flags{ flags },
+    text{ std::move(text) },
+    children{ std::move(children) }
+{
+    width = IsSyntaxTokenKind(kind) ? 1 : 0;
+    hash = std::hash<std::string>{ }(this->text);
+    CombineHash(hash, kind);
+    CombineHash(hash, production);
+    CombineHash(hash, flags);
+
+    for (const Rc<GreenNode>& child : this->children) {
+        CombineHash(hash, std::hash<GreenNode*>{ }(child.get()));
+        if (child != nullptr)
+            width += child->width;
+    }
+}
+
+GreenNode::~GreenNode() { }
+
+bool GreenNode::IsShallowlyEqual(const GreenNode& other) const {
+    return kind == other.kind
+        && production == other.production
+        && flags == other.flags
+        && text == other.text
+        && children == other.children;
+}
+
+struct GREEN_NODE_HASH {
+    size_t operator()(const Rc<GreenNode>& node) const { return node->GetHash(); }
+};
+
+struct GREEN_NODE_EQUAL {
+    bool operator()(const Rc<GreenNode>& a, const Rc<GreenNode>& b) const {
+        return a->IsShallowlyEqual(*b);
+    }
+};
+
+struct GREEN_NODE_CACHE_IMPL {
+    std::unordered_set<Rc<GreenNode>, GREEN_NODE_HASH, GREEN_NODE_EQUAL> Nodes{ };
+};
+
+GreenNodeCache::GreenNodeCache() :
+    c{ NewChild<GREEN_NODE_CACHE_IMPL>() }
+{ }
+
+GreenNodeCache::~GreenNodeCache() { }
+
+Rc<GreenNode> GreenNodeCache::Find(Rc<GreenNode> node) {
+    return *c->Nodes.insert(std::move(node)).first;
+}
+
+Rc<GreenNode> GreenNodeCache::GetToken(SYNTAX_KIND kind, uint32_t flags, const std::string& text) {
+    return Find(NewObj<GreenNode>(kind, SP_INVALID, flags, text, std::vector<Rc<GreenNode>>{ }));
+}
+
+Rc<GreenNode> GreenNodeCache::GetNode(
+    SYNTAX_KIND                kind,
+    SYNTAX_PRODUCTION          production,
+    std::vector<Rc<GreenNode>> children
+) {
+    return Find(NewObj<GreenNode>(kind, production, 0, std::string{ }, std::move(children)));
+}
+
+/**
+ * \return the token's spelling, for the kinds that have one
+ */
+static std::string GetTokenText(const SyntaxToken& token) {
+    switch (token.GetKind()) {
+    case SK_InvalidDirective:
+        return static_cast<const InvalidDirective&>(token).GetName();
+    case SK_StrayToken:
+        return std::string(1, static_cast<const StrayToken&>(token).GetOffendingChar());
+    case SK_CommentToken: {
+        const CommentToken& comment{ static_cast<const CommentToken&>(token) };
+        return comment.GetOpeningToken() + comment.GetContents() + comment.GetClosingToken();
+    }
+    case SK_IdentifierToken:
+        return static_cast<const IdentifierToken&>(token).GetName();
+    case SK_NumericLiteralToken: {
+        const NumericLiteralToken& literal{ static_cast<const NumericLiteralToken&>(token) };
+        return literal.GetPrefix() + literal.GetWholeValue() + literal.GetDotSymbol()
+            + literal.GetFractionalValue() + literal.GetSuffix();
+    }
+    case SK_StringLiteralToken: {
+        const StringLiteralToken& literal{ static_cast<const StringLiteralToken&>(token) };
+        return literal.GetOpeningQuote() + literal.GetValue() + literal.GetClosingQuote();
+    }
+    default:
+        return std::string{ };
+    }
+}
+
+Rc<GreenNode> GreenNodeCache::Intern(const Rc<SyntaxNode>& root) {
+    if (root == nullptr)
+        return Rc<GreenNode>{ };
+
+    // Children are interned before their parents, which find them on top
+    // of the stack, last child uppermost.
+    std::vector<Rc<GreenNode>> interned{ };
+
+    WalkSyntaxTree(
+        *root,
+        [](SyntaxNode&) { },
+        [&](SyntaxNode& node) {
+            if (IsSyntaxTokenKind(node.GetKind())) {
+                const SyntaxToken& token{ static_cast<const SyntaxToken&>(node) };
+                uint32_t flags{ token.GetFlags() & SyntaxToken::IS_MISSING };
+
+                interned.push_back(GetToken(node.GetKind(), flags, GetTokenText(token)));
+                return;
+            }
+
+            const Expression& expression{ static_cast<const Expression&>(node) };
+            std::vector<Rc<GreenNode>> children(expression.GetChildCount());
+
+            for (size_t i{ children.size() }; i-- > 0; ) {
+                if (expression.GetChildNode(static_cast<int>(i)) != nullptr) {
+                    children[i] = std::move(interned.back());
+                    interned.pop_back();
+                }
+            }
+
+            interned.push_back(GetNode(node.GetKind(), expression.GetProduction(), std::move(children)));
+        }
+    );
+
+    return interned.back();
+}
+
+size_t GreenNodeCache::GetNodeCount() const {
+    return c->Nodes.size();
+}
+
+RedNode::RedNode(Rc<GreenNode> green, Rc<RedNode> parent, uint32_t offset) :
+    green{ std::move(green) },
+    parent{ std::move(parent) },
+    offset{ offset }
+{ }
+
+RedNode::~RedNode() { }
+
+Rc<RedNode> RedNode::GetChild(size_t index) {
+    const Rc<GreenNode>& child{ green->GetChild(index) };
+    if (child == nullptr)
+        return Rc<RedNode>{ };
+
+    uint32_t childOffset{ offset };
+    for (size_t i{ 0 }; i < index; ++i) {
+        if (const Rc<GreenNode>& sibling{ green->GetChild(i) }; sibling != nullptr)
+            childOffset += sibling->GetWidth();
+    }
+
+    return NewObj<RedNode>(child, Rc<RedNode>{ this }, childOffset);
+}
+
+Rc<RedNode> RedNode::FindToken(uint32_t tokenOffset) {
+    if (tokenOffset < offset || tokenOffset - offset >= green->GetWidth())
+        return Rc<RedNode>{ };
+
+    Rc<RedNode> node{ this };
+
+    while (!IsSyntaxTokenKind(node->GetKind())) {
+        uint32_t childOffset{ node->offset };
+
+        for (size_t i{ 0 }; i < node->GetChildCount(); ++i) {
+            const Rc<GreenNode>& child{ node->green->GetChild(i) };
+            if (child == nullptr)
+                continue;
+
+            if (tokenOffset < childOffset + child->GetWidth()) {
+                node = NewObj<RedNode>(child, node, childOffset);
+                break;
+            }
+            childOffset += child->GetWidth();
+        }
+    }
+
+    return node;
+}
@@ -0,0 +1,145 @@
+#ifndef COMBUST_GREEN_SYNTAX_HH
+#define COMBUST_GREEN_SYNTAX_HH
+#include "common.hh"
+#include "syntax.hh"
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct GREEN_NODE_CACHE_IMPL;
+
+/**
+ * Immutable, position-free syntax node. Equal subtrees are the same
+ * object when built by one GreenNodeCache, so a tree of green nodes is a
+ * DAG in which every ';' or repeated sizeof(x) is stored once.
+ *
+ * A node's width is the number of tokens under it, which is all a RedNode
+ * needs to work out where the node sits.
+ */
+class GreenNode : public Object {
+public:
+    /** Use GreenNodeCache to create nodes. */
+    explicit GreenNode(
+        SYNTAX_KIND                kind,
+        SYNTAX_PRODUCTION          production,
+        uint32_t                   flags,
+        std::string                text,
+        std::vector<Rc<GreenNode>> children
+    );
+    virtual ~GreenNode();
+
+    SYNTAX_KIND GetKind() const { return kind; }
+    /** SP_INVALID for tokens. */
+    SYNTAX_PRODUCTION GetProduction() const { return production; }
+    /** The token flags that do not depend on position, e.g. IS_MISSING. */
+    uint32_t GetFlags() const { return flags; }
+    /** The spelling of identifiers, literals and the like; empty otherwise. */
+    const std::string& GetText() const { return text; }
+
+    size_t GetChildCount() const { return children.size(); }
+    /** Null where the expression it came from had a null child. */
+    const Rc<GreenNode>& GetChild(size_t index) const { return children[index]; }
+
+    uint32_t GetWidth() const { return width; }
+    size_t GetHash() const { return hash; }
+
+    /**
+     * \return true if the nodes have the same kind, production, flags and
+     *         text and the very same children
+     */
+    bool IsShallowlyEqual(const GreenNode& other) const;
+
+private:
+    SYNTAX_KIND                kind{ };
+    SYNTAX_PRODUCTION          production{ SP_INVALID };
+    uint32_t                   flags{ 0 };
+    std::string                text{ };
+    std::vector<Rc<GreenNode>> children{ };
+    uint32_t                   width{ 0 };
+    size_t                     hash{ 0 };
+};
+
+/**
+ * Hash-cons table of green nodes. Children must come from the same cache,
+ * which makes comparing them by identity enough to find equal nodes.
+ *
+ * A cache keeps every node it has built alive, and is not safe to use from
+ * several threads at once.
+ */
+class GreenNodeCache : public Object {
+public:
+    explicit GreenNodeCache();
+    virtual ~GreenNodeCache();
+
+    /**
+     * \return the token node with the given kind, flags and text
+     */
+    Rc<GreenNode> GetToken(SYNTAX_KIND kind, uint32_t flags, const std::string& text);
+
+    /**
+     * \return the expression node with the given kind, production and
+     *         children
+     */
+    Rc<GreenNode> GetNode(
+        SYNTAX_KIND                kind,
+        SYNTAX_PRODUCTION          production,
+        std::vector<Rc<GreenNode>> children
+    );
+
+    /**
+     * \return the green form of the tree under root, or nullptr if root is
+     *         null
+     */
+    Rc<GreenNode> Intern(const Rc<SyntaxNode>& root);
+
+    /**
+     * \return the number of distinct nodes built so far
+     */
+    size_t GetNodeCount() const;
+
+private:
+    Rc<GreenNode> Find(Rc<GreenNode> node);
+
+    Owner<GREEN_NODE_CACHE_IMPL> c;
+};
+
+/**
+ * Positioned view of a green node: where it starts, in tokens from the
+ * start of the tree, and which node contains it. Red nodes are made on the
+ * way down by GetChild and are cheap to throw away; the green tree under
+ * them is never copied.
+ */
+class RedNode : public Object {
+public:
+    /** Use NewObj for the root; descendants come from GetChild. */
+    explicit RedNode(Rc<GreenNode> green, Rc<RedNode> parent = Rc<RedNode>{ }, uint32_t offset = 0);
+    virtual ~RedNode();
+
+    const Rc<GreenNode>& GetGreen() const { return green; }
+    /** Null for the root. */
+    const Rc<RedNode>& GetParent() const { return parent; }
+    /** The index of the node's first token. */
+    uint32_t GetOffset() const { return offset; }
+
+    SYNTAX_KIND GetKind() const { return green->GetKind(); }
+    size_t GetChildCount() const { return green->GetChildCount(); }
+
+    /**
+     * \return the child at index, or nullptr if the green child is null
+     */
+    Rc<RedNode> GetChild(size_t index);
+
+    /**
+     * \return the token at offset under this node, or nullptr if offset is
+     *         outside of it
+     */
+    Rc<RedNode> FindToken(uint32_t offset);
+
+private:
+    Rc<GreenNode> green{ };
+    Rc<RedNode>   parent{ };
+    uint32_t      offset{ 0 };
+};
+
+#endif
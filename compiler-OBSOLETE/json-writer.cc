@@ -0,0 +1,43 @@
+#include "json-writer.hh"
+#include <string.h>
+
+void AppendJsonString(IN_OUT std::string& json, const std::string& value) {
+    static const char HEX_DIGITS[]{ "0123456789abcdef" };
+
+    json += '"';
+
+    for (char c : value) {
+        switch (c) {
+        case '"':  json += "\\\""; break;
+        case '\\': json += "\\\\"; break;
+        case '\n': json += "\\n";  break;
+        case '\r': json += "\\r";  break;
+        case '\t': json += "\\t";  break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                json += "\\u00";
+                json += HEX_DIGITS[(c >> 4) & 0xF];
+                json += HEX_DIGITS[c & 0xF];
+            }
+            else {
+                json += c;
+            }
+        }
+    }
+
+    json += '"';
+}
+
+void AppendJsonString(IN_OUT std::string& json, const char* value) {
+    AppendJsonString(json, std::string{ value });
+}
+
+void AppendJsonKey(IN_OUT std::string& json, const char* name) {
+    json += '"';
+    json.append(name, strlen(name));
+    json += "\":";
+}
+
+void AppendJsonNumber(IN_OUT std::string& json, int64_t value) {
+    json += std::to_string(value);
+}
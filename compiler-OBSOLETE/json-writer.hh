@@ -0,0 +1,26 @@
+#ifndef COMBUST_JSON_WRITER_HH
+#define COMBUST_JSON_WRITER_HH
+#include "common.hh"
+#include <stdint.h>
+#include <string>
+
+/*
+ * Helpers for writing JSON straight into a string, for output other tools
+ * read (machine-readable diagnostics, traces). Nothing here parses JSON.
+ */
+
+/**
+ * Appends value as a quoted JSON string, escaping quotes, backslashes and
+ * control characters. Other bytes are copied as they are.
+ */
+void AppendJsonString(IN_OUT std::string& json, const std::string& value);
+void AppendJsonString(IN_OUT std::string& json, const char* value);
+
+/**
+ * Appends "name": for the member of an object.
+ */
+void AppendJsonKey(IN_OUT std::string& json, const char* name);
+
+void AppendJsonNumber(IN_OUT std::string& json, int64_t value);
+
+#endif
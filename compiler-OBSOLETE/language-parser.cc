@@ -1,93 +1,624 @@
 #include "language-parser.hh"
 #include "backtracking-lexer.hh"
+#include "diagnostic-engine.hh"
+#include "parallel.hh"
+#include "syntax-arena.hh"
 #include "syntax.hh"
+#include "time-profiler.hh"
+#include "token-cache.hh"
+#include <optional>
+#include <unordered_map>
+#include <vector>
 
-static Rc<PrimaryExpression> ParsePrimaryExpression(Rc<BacktrackingLexer> l) {
-    BacktrackingLexer::Marker marker{ l->Mark() };
+enum PARSE_RULE {
+    PR_PRIMARY_EXPRESSION,
+    PR_POSTFIX_EXPRESSION,
+    PR_UNARY_EXPRESSION,
+    /** Rules from here on are not memoized. */
+    PR_MEMOIZED_COUNT,
+    PR_BINARY_EXPRESSION = PR_MEMOIZED_COUNT
+};
 
-    if (Rc<SyntaxToken> token{ l->Accept<IdentifierToken,
-                                         NumericLiteralToken,
-                                         StringLiteralToken>() }; token)
-    {
-        Rc<PrimaryExpression> expression{ NewObj<PrimaryExpression>() };
-        expression->SetChildren({ token });
+/** Where a rule picks up again once the rule it called has returned. */
+enum PARSE_STEP {
+    PS_START,
+    PS_PRIMARY_AFTER_INNER,
+    PS_POSTFIX_AFTER_PRIMARY,
+    PS_POSTFIX_AFTER_INDEX,
+    PS_UNARY_AFTER_OPERAND,
+    PS_UNARY_AFTER_POSTFIX,
+    PS_BINARY_AFTER_LEFT,
+    PS_BINARY_AFTER_RIGHT,
+    PS_BINARY_AFTER_IF_TRUE,
+    PS_BINARY_AFTER_IF_FALSE
+};
 
-        return expression;
+struct OPERATOR_INFO;
+
+/**
+ * A rule in progress. Rules call each other by pushing a frame and
+ * returning to the loop in ParseExpression_Internal instead of recursing,
+ * so nesting costs heap rather than native stack.
+ */
+struct PARSE_FRAME {
+    PARSE_RULE                               Rule{ };
+    PARSE_STEP                               Step{ PS_START };
+    int                                      MinPrecedence{ 0 };
+    /** Set on entry when memoizing. */
+    size_t                                   MemoKey{ 0 };
+    std::optional<BacktrackingLexer::Marker> Marker{ };
+
+    /** The left operand, or the object of a postfix expression. */
+    Rc<Expression>                           Operand{ };
+    Rc<Expression>                           IfTrue{ };
+    const OPERATOR_INFO*                     Info{ nullptr };
+    /** The operator, or the opening bracket awaiting its closer. */
+    Rc<SyntaxToken>                          Op{ };
+    Rc<SyntaxToken>                          Colon{ };
+};
+
+struct MEMO_ENTRY {
+    Rc<Expression> Result{ };
+    size_t         EndPosition{ 0 };
+};
+
+using MemoTable = std::unordered_map<
+    size_t,
+    MEMO_ENTRY,
+    std::hash<size_t>,
+    std::equal_to<size_t>,
+    ArenaAllocator<std::pair<const size_t, MEMO_ENTRY>>
+>;
+
+/**
+ * The memo table and the stack take their memory from the arena, which
+ * keeps what they free for the next parse into it.
+ */
+struct PARSER_STATE {
+    explicit PARSER_STATE(Rc<SyntaxArena> arena) :
+        Arena{ std::move(arena) },
+        Memo{ MemoTable::allocator_type{ Arena.get() } },
+        Stack{ ArenaAllocator<PARSE_FRAME>{ Arena.get() } }
+    { }
+
+    Rc<BacktrackingLexer>                                 Lexer{ };
+    ParserOptions                                         Options{ };
+    Rc<SyntaxArena>                                       Arena{ };
+    /** Keyed by token position * PR_MEMOIZED_COUNT + rule. */
+    MemoTable                                             Memo;
+
+    std::vector<PARSE_FRAME, ArenaAllocator<PARSE_FRAME>> Stack;
+    /** What the last rule to return produced. */
+    Rc<Expression>                                        Result{ };
+    bool                                                  IsTooDeep{ false };
+};
+
+/**
+ * Suspends the current rule until rule returns, then resumes it at step.
+ * The current frame must not be used after this.
+ */
+static void Call(PARSER_STATE& p, PARSE_RULE rule, PARSE_STEP step, int minPrecedence = 0) {
+    p.Stack.back().Step = step;
+
+    if (p.Stack.size() >= p.Options.MaxDepth) {
+        p.IsTooDeep = true;
+        return;
     }
-    else if (Rc<SyntaxToken> lParen{ l->Accept<LParenSymbol>() }; lParen) {
-        if (Rc<Expression> innerExpression{ ParseExpression(l) }; innerExpression) {
+
+    p.Stack.emplace_back();
+    p.Stack.back().Rule = rule;
+    p.Stack.back().MinPrecedence = minPrecedence;
+}
+
+/**
+ * Ends the current rule with result, remembering it when memoizing. The
+ * current frame must not be used after this.
+ */
+static void Return(PARSER_STATE& p, Rc<Expression> result) {
+    const PARSE_FRAME& f{ p.Stack.back() };
+
+    if (p.Options.ShouldMemoize && f.Rule < PR_MEMOIZED_COUNT)
+        p.Memo[f.MemoKey] = MEMO_ENTRY{ result, p.Lexer->GetPosition() };
+
+    p.Stack.pop_back();
+    p.Result = std::move(result);
+}
+
+/**
+ * Replays the result of the current rule at this position, if it has been
+ * run here before, in place of running it again.
+ *
+ * \return true if the rule has returned
+ */
+static bool Recall(PARSER_STATE& p, PARSE_FRAME& f) {
+    if (!p.Options.ShouldMemoize)
+        return false;
+
+    f.MemoKey = p.Lexer->GetPosition() * PR_MEMOIZED_COUNT + f.Rule;
+
+    auto entry = p.Memo.find(f.MemoKey);
+    if (entry == p.Memo.end())
+        return false;
+
+    p.Lexer->SkipTo(entry->second.EndPosition);
+    p.Result = entry->second.Result;
+    p.Stack.pop_back();
+    return true;
+}
+
+static void StepPrimaryExpression(PARSER_STATE& p, PARSE_FRAME& f) {
+    Rc<BacktrackingLexer>& l{ p.Lexer };
+
+    switch (f.Step) {
+    case PS_START:
+        if (Recall(p, f))
+            return;
+
+        f.Marker.emplace(l->Mark());
+
+        if (Rc<SyntaxToken> token{ l->Accept<IdentifierToken,
+                                             NumericLiteralToken,
+                                             StringLiteralToken>() }; token)
+        {
+            SYNTAX_PRODUCTION production{
+                IsSyntaxNode<IdentifierToken>(token)     ? SP_IDENTIFIER
+                : IsSyntaxNode<NumericLiteralToken>(token) ? SP_NUMERIC_LITERAL
+                                                           : SP_STRING_LITERAL
+            };
+
+            Rc<PrimaryExpression> expression{ p.Arena->New<PrimaryExpression>() };
+            expression->SetChildren(production, { token });
+
+            return Return(p, expression);
+        }
+        else if (Rc<SyntaxToken> lParen{ l->Accept<LParenSymbol>() }; lParen) {
+            f.Op = lParen;
+            return Call(p, PR_BINARY_EXPRESSION, PS_PRIMARY_AFTER_INNER, 1);
+        }
+        break;
+
+    case PS_PRIMARY_AFTER_INNER:
+        if (p.Result) {
             if (Rc<SyntaxToken> rParen{ l->Accept<RParenSymbol>() }; rParen) {
-                Rc<PrimaryExpression> expression{ NewObj<PrimaryExpression>() };
-                expression->SetChildren({ lParen, innerExpression, rParen });
+                Rc<PrimaryExpression> expression{ p.Arena->New<PrimaryExpression>() };
+                expression->SetChildren(SP_PARENTHESIZED_EXPRESSION, { f.Op, p.Result, rParen });
 
-                return expression;
+                return Return(p, expression);
             }
         }
+        break;
+
+    default:
+        break;
     }
 
-    l->Backtrack(marker);
-    return Rc<PrimaryExpression>{ };
+    l->Backtrack(*f.Marker);
+    Return(p, Rc<Expression>{ });
 }
 
-static Rc<Expression> ParsePostfixExpression(Rc<BacktrackingLexer> l) {
-    Rc<Expression> obj{ ParsePrimaryExpression(l) };
-    BacktrackingLexer::Marker marker{ l->Mark() };
-    bool isDone{ false };
+static void StepPostfixExpression(PARSER_STATE& p, PARSE_FRAME& f) {
+    Rc<BacktrackingLexer>& l{ p.Lexer };
+
+    switch (f.Step) {
+    case PS_START:
+        if (Recall(p, f))
+            return;
 
-    while (!isDone) {
-        Rc<PostfixExpression> result{ NewObj<PostfixExpression>() };
-        isDone = true;
+        return Call(p, PR_PRIMARY_EXPRESSION, PS_POSTFIX_AFTER_PRIMARY);
 
+    case PS_POSTFIX_AFTER_PRIMARY:
+        if (!p.Result)
+            return Return(p, p.Result);
+
+        f.Operand = p.Result;
+        f.Marker.emplace(l->Mark());
+        break;
+
+    case PS_POSTFIX_AFTER_INDEX: {
+        Rc<SyntaxToken> rBracket{ p.Result ? l->Accept<RBracketSymbol>() : nullptr };
+        if (!rBracket)
+            return Return(p, f.Operand);
+
+        Rc<PostfixExpression> result{ p.Arena->New<PostfixExpression>() };
+        result->SetChildren(SP_ARRAY_ACCESSOR, { f.Operand, f.Op, p.Result, rBracket });
+        f.Operand = result;
+        break;
+    }
+
+    default:
+        break;
+    }
+
+    for (;;) {
         if (Rc<SyntaxToken> lBracket{ l->Accept<LBracketSymbol>() }; lBracket) {
-            if (Rc<Expression> index{ ParseExpression(l) }; index) {
-                if (Rc<SyntaxToken> rBracket{ l->Accept<RBracketSymbol>() }; rBracket) {
-                    result->SetChildren({ obj, lBracket, index, rBracket });
-                    isDone = false;
-                }
-            }
+            f.Op = lBracket;
+            return Call(p, PR_BINARY_EXPRESSION, PS_POSTFIX_AFTER_INDEX, 1);
         }
         else if (Rc<SyntaxToken> accessor{ l->Accept<DotSymbol, MinusGtSymbol>() }; accessor) {
-            if (Rc<SyntaxToken> memberName{ l->Accept<IdentifierToken>() }; memberName) {
-                result->SetChildren({ obj, accessor, memberName });
-                isDone = false;
-            }
+            Rc<SyntaxToken> memberName{ l->Accept<IdentifierToken>() };
+            if (!memberName)
+                break;
+
+            SYNTAX_PRODUCTION production{
+                IsSyntaxNode<DotSymbol>(accessor) ? SP_STRUCTURE_REFERENCE : SP_STRUCTURE_DEREFERENCE
+            };
+
+            Rc<PostfixExpression> result{ p.Arena->New<PostfixExpression>() };
+            result->SetChildren(production, { f.Operand, accessor, memberName });
+            f.Operand = result;
         }
         else if (Rc<SyntaxToken> op{ l->Accept<PlusPlusSymbol, MinusMinusSymbol>() }; op) {
-            result->SetChildren({ obj, op });
-            isDone = false;
+            SYNTAX_PRODUCTION production{
+                IsSyntaxNode<PlusPlusSymbol>(op) ? SP_POST_INCREMENT : SP_POST_DECREMENT
+            };
+
+            Rc<PostfixExpression> result{ p.Arena->New<PostfixExpression>() };
+            result->SetChildren(production, { f.Operand, op });
+            f.Operand = result;
+        }
+        else {
+            break;
+        }
+    }
+
+    Return(p, f.Operand);
+}
+
+static SYNTAX_PRODUCTION GetUnaryProduction(SYNTAX_KIND op) {
+    switch (op) {
+    case SK_PlusPlusSymbol:    return SP_PRE_INCREMENT;
+    case SK_MinusMinusSymbol:  return SP_PRE_DECREMENT;
+    case SK_AmpersandSymbol:   return SP_ADDRESS_OF;
+    case SK_AsteriskSymbol:    return SP_POINTER_DEREFERENCE;
+    case SK_PlusSymbol:        return SP_POSITIVE;
+    case SK_MinusSymbol:       return SP_NEGATIVE;
+    case SK_TildeSymbol:       return SP_BITWISE_COMPLEMENT;
+    case SK_ExclamationSymbol: return SP_LOGICAL_NOT;
+    default:                   return SP_SIZE_OF;
+    }
+}
+
+static void StepUnaryExpression(PARSER_STATE& p, PARSE_FRAME& f) {
+    Rc<BacktrackingLexer>& l{ p.Lexer };
+
+    switch (f.Step) {
+    case PS_START:
+        if (Recall(p, f))
+            return;
+
+        f.Marker.emplace(l->Mark());
+
+        if (Rc<SyntaxToken> op{ l->Accept<PlusPlusSymbol,
+                                          MinusMinusSymbol,
+                                          AmpersandSymbol,
+                                          AsteriskSymbol,
+                                          PlusSymbol,
+                                          MinusSymbol,
+                                          TildeSymbol,
+                                          ExclamationSymbol,
+                                          SizeOfKeyword>() }; op)
+        {
+            f.Op = op;
+            return Call(p, PR_UNARY_EXPRESSION, PS_UNARY_AFTER_OPERAND);
         }
 
-        if (!isDone) {
-            obj = result;
+        return Call(p, PR_POSTFIX_EXPRESSION, PS_UNARY_AFTER_POSTFIX);
+
+    case PS_UNARY_AFTER_OPERAND:
+        if (p.Result) {
+            Rc<UnaryExpression> expression{ p.Arena->New<UnaryExpression>() };
+            expression->SetChildren(GetUnaryProduction(f.Op->GetKind()), { f.Op, p.Result });
+
+            return Return(p, expression);
         }
+        break;
+
+    case PS_UNARY_AFTER_POSTFIX:
+        if (p.Result)
+            return Return(p, p.Result);
+        break;
+
+    default:
+        break;
     }
 
-    return obj;
+    l->Backtrack(*f.Marker);
+    Return(p, Rc<Expression>{ });
+}
+
+enum OPERATOR_ASSOCIATIVITY {
+    OA_LEFT,
+    OA_RIGHT
+};
+
+struct OPERATOR_INFO {
+    /** 0 for tokens that are not binary operators. */
+    int                    Precedence{ 0 };
+    OPERATOR_ASSOCIATIVITY Associativity{ OA_LEFT };
+    SYNTAX_PRODUCTION      Production{ SP_INVALID };
+    Rc<Expression>         (*NewNode)(SyntaxArena& arena){ nullptr };
+
+    /** The least precedence an operator in the right operand may have. */
+    constexpr int GetRightPrecedence() const {
+        return Associativity == OA_RIGHT ? Precedence : Precedence + 1;
+    }
+};
+
+struct OPERATOR_TABLE {
+    OPERATOR_INFO Operators[SK_COUNT]{ };
+};
+
+template<typename T>
+static Rc<Expression> NewExpressionOf(SyntaxArena& arena) {
+    return arena.New<T>();
+}
+
+static constexpr OPERATOR_TABLE MakeOperatorTable() {
+    OPERATOR_TABLE table{ };
+#define Op(symbolClass, expressionClass, production, precedence, associativity) \
+    table.Operators[SK_##symbolClass] = OPERATOR_INFO{                          \
+        precedence, associativity, production, NewExpressionOf<expressionClass> \
+    }
+#define Sn(className)
+#define Tk(className)
+#include "syntax-kinds.def"
+#undef Tk
+#undef Sn
+#undef Op
+    return table;
 }
 
-static Rc<Expression> ParseUnaryExpression(Rc<BacktrackingLexer> l) {
-    BacktrackingLexer::Marker marker{ l->Mark() };
+/** Indexed by the kind of the operator symbol. */
+static constexpr OPERATOR_TABLE OPERATORS{ MakeOperatorTable() };
 
-    if (Rc<SyntaxToken> op{ l->Accept<PlusPlusSymbol, MinusMinusSymbol>() }; op) {
+/**
+ * Parses unary expressions joined by operators that bind at least as
+ * tightly as the frame's MinPrecedence. Each operator becomes one node
+ * holding its operands; no single-child levels are built in between.
+ */
+static void StepBinaryExpression(PARSER_STATE& p, PARSE_FRAME& f) {
+    Rc<BacktrackingLexer>& l{ p.Lexer };
+
+    switch (f.Step) {
+    case PS_START:
+        return Call(p, PR_UNARY_EXPRESSION, PS_BINARY_AFTER_LEFT);
+
+    case PS_BINARY_AFTER_LEFT:
+        if (!p.Result)
+            return Return(p, p.Result);
+
+        f.Operand = p.Result;
+        break;
+
+    case PS_BINARY_AFTER_RIGHT: {
+        if (!p.Result) {
+            l->Backtrack(*f.Marker);
+            return Return(p, f.Operand);
+        }
+
+        Rc<Expression> result{ f.Info->NewNode(*p.Arena) };
+        result->SetChildren(f.Info->Production, { f.Operand, f.Op, p.Result });
+        f.Operand = result;
+        break;
     }
-    else if (Rc<SyntaxToken> op{ l->Accept<AmpersandSymbol,
-                                           AsteriskSymbol,
-                                           PlusSymbol,
-                                           MinusSymbol,
-                                           TildeSymbol,
-                                           ExclamationSymbol>() }; op)
-    {
+
+    case PS_BINARY_AFTER_IF_TRUE:
+        f.Colon = p.Result ? l->Accept<ColonSymbol>() : nullptr;
+        if (!f.Colon) {
+            l->Backtrack(*f.Marker);
+            return Return(p, f.Operand);
+        }
+
+        f.IfTrue = p.Result;
+        return Call(p, PR_BINARY_EXPRESSION, PS_BINARY_AFTER_IF_FALSE, f.Info->GetRightPrecedence());
+
+    case PS_BINARY_AFTER_IF_FALSE: {
+        if (!p.Result) {
+            l->Backtrack(*f.Marker);
+            return Return(p, f.Operand);
+        }
+
+        Rc<Expression> result{ f.Info->NewNode(*p.Arena) };
+        result->SetChildren(f.Info->Production, { f.Operand, f.Op, f.IfTrue, f.Colon, p.Result });
+        f.Operand = result;
+        break;
     }
-    else if (Rc<SyntaxToken> op{ l->Accept<SizeOfKeyword>() }; op) {
+
+    default:
+        break;
     }
-    else if (Rc<Expression> expression{ ParsePostfixExpression(l) }; expression) {
-        return expression;
+
+    const OPERATOR_INFO& info{ OPERATORS.Operators[l->PeekKind()] };
+    if (info.Precedence == 0 || info.Precedence < f.MinPrecedence)
+        return Return(p, f.Operand);
+
+    f.Marker.emplace(l->Mark());
+    f.Op = l->ReadToken();
+    f.Info = &info;
+
+    if (IsSyntaxNode<QuestionSymbol>(f.Op))
+        return Call(p, PR_BINARY_EXPRESSION, PS_BINARY_AFTER_IF_TRUE, 1);
+
+    Call(p, PR_BINARY_EXPRESSION, PS_BINARY_AFTER_RIGHT, info.GetRightPrecedence());
+}
+
+static Rc<Expression> ParseExpression_Internal(PARSER_STATE& p) {
+    BacktrackingLexer::Marker start{ p.Lexer->Mark() };
+
+    p.Stack.emplace_back();
+    p.Stack.back().Rule = PR_BINARY_EXPRESSION;
+    p.Stack.back().MinPrecedence = 1;
+
+    while (!p.Stack.empty() && !p.IsTooDeep) {
+        PARSE_FRAME& f{ p.Stack.back() };
+
+        switch (f.Rule) {
+        case PR_PRIMARY_EXPRESSION: StepPrimaryExpression(p, f); break;
+        case PR_POSTFIX_EXPRESSION: StepPostfixExpression(p, f); break;
+        case PR_UNARY_EXPRESSION:   StepUnaryExpression(p, f);   break;
+        case PR_BINARY_EXPRESSION:  StepBinaryExpression(p, f);  break;
+        }
+    }
+
+    if (p.IsTooDeep) {
+        const SourceRange& range{ p.Lexer->PeekToken()->GetLexemeRange() };
+
+        if (p.Options.Diagnostics)
+            p.Options.Diagnostics->Report(DK_EXPRESSION_TOO_DEEP, &range, p.Options.MaxDepth);
+        else
+            GetDiagnosticEngine().Report(DK_EXPRESSION_TOO_DEEP, &range, p.Options.MaxDepth);
+
+        // Frames are dropped innermost first so that their marks are released
+        // in the order a streaming lexer releases them fastest.
+        while (!p.Stack.empty())
+            p.Stack.pop_back();
+        p.Lexer->Backtrack(start);
+        return Rc<Expression>{ };
     }
 
-    l->Backtrack(marker);
-    return Rc<Expression>{ };
+    return std::move(p.Result);
 }
 
 Rc<Expression> ParseExpression(Rc<BacktrackingLexer> lexer) {
-    return ParseUnaryExpression(lexer);
-}
\ No newline at end of file
+    return ParseExpression(lexer, ParserOptions{ });
+}
+
+Rc<Expression> ParseExpression(Rc<BacktrackingLexer> lexer, const ParserOptions& options) {
+    ScopedTimer timer{ TP_PARSE_EXPRESSION };
+
+    PARSER_STATE p{ options.Arena ? options.Arena : NewObj<SyntaxArena>() };
+    p.Lexer = lexer;
+    p.Options = options;
+
+    return ParseExpression_Internal(p);
+}
+
+struct DEFERRED_BODY_IMPL {
+    std::vector<Rc<SyntaxToken>> Tokens{ };
+    BodyParser                   Parser{ nullptr };
+    ParserOptions                Options{ };
+
+    bool                         IsParsed{ false };
+    bool                         IsComplete{ false };
+    Rc<Expression>               Contents{ };
+};
+
+DeferredBody::DeferredBody(
+    std::vector<Rc<SyntaxToken>> tokens,
+    BodyParser                   parser,
+    const ParserOptions&         options
+) :
+    b{ NewChild<DEFERRED_BODY_IMPL>() }
+{
+    b->Tokens = std::move(tokens);
+    b->Parser = parser;
+    b->Options = options;
+}
+
+DeferredBody::~DeferredBody() { }
+
+const std::vector<Rc<SyntaxToken>>& DeferredBody::GetTokens() const {
+    return b->Tokens;
+}
+
+const ParserOptions& DeferredBody::GetOptions() const {
+    return b->Options;
+}
+
+bool DeferredBody::IsParsed() const {
+    return b->IsParsed;
+}
+
+Rc<Expression> DeferredBody::GetContents() {
+    return GetContents(b->Options.Arena);
+}
+
+Rc<Expression> DeferredBody::GetContents(
+    const Rc<SyntaxArena>&      arena,
+    const Rc<DiagnosticBuffer>& diagnostics
+) {
+    if (b->IsParsed)
+        return b->Contents;
+
+    // The body's own arena and buffer are left out, as they may be shared
+    // with bodies being parsed on other threads.
+    ParserOptions options{ };
+    options.ShouldMemoize = b->Options.ShouldMemoize;
+    options.MaxDepth = b->Options.MaxDepth;
+    options.Arena = arena;
+    options.Diagnostics = diagnostics ? diagnostics : b->Options.Diagnostics;
+
+    // The brackets are left out and an EofToken put in place of the closer,
+    // so the parser sees the contents as a stream of their own.
+    std::vector<Rc<SyntaxToken>> contents{ b->Tokens.begin() + 1, b->Tokens.end() - 1 };
+    contents.push_back(NewSyntaxToken(SK_EofToken));
+
+    Rc<BacktrackingLexer> lexer{ NewObj<BacktrackingLexer>(NewObj<TokenListLexer>(contents), BLM_EAGER, arena) };
+
+    b->Contents = b->Parser(lexer, options);
+    b->IsComplete = b->Contents != nullptr && lexer->PeekKind() == SK_EofToken;
+    b->IsParsed = true;
+
+    return b->Contents;
+}
+
+bool DeferredBody::IsComplete() {
+    GetContents();
+    return b->IsComplete;
+}
+
+Rc<DeferredBody> DeferBody(
+    Rc<BacktrackingLexer> lexer,
+    BodyParser            parser,
+    const ParserOptions&  options
+) {
+    // The marker keeps the skipped tokens buffered until they are copied.
+    BacktrackingLexer::Marker start{ lexer->Mark() };
+    size_t begin{ lexer->GetPosition() };
+
+    if (!lexer->SkipBalanced())
+        return Rc<DeferredBody>{ };
+
+    return NewObj<DeferredBody>(lexer->GetTokens(begin, lexer->GetPosition()), parser, options);
+}
+
+void ParseDeferredBodies(const std::vector<Rc<DeferredBody>>& bodies, unsigned threadCount) {
+    if (threadCount == 0)
+        threadCount = GetDefaultThreadCount();
+    if (threadCount > bodies.size())
+        threadCount = static_cast<unsigned>(bodies.size());
+
+    // Slots are only touched by their own worker, so the arenas need no
+    // locking of their own.
+    std::vector<Rc<SyntaxArena>> arenas(threadCount);
+    std::vector<Rc<DiagnosticBuffer>> diagnostics(bodies.size());
+
+    // Each body's tokens are only touched by the worker parsing it, but the
+    // files they point into, and the arenas a lexer created them in, are
+    // shared by all of them.
+    if (threadCount > 1) {
+        for (const Rc<DeferredBody>& body : bodies) {
+            for (const Rc<SyntaxToken>& token : body->GetTokens()) {
+                if (const Rc<const SourceFile>& source{ token->GetLexemeRange().Location.Source }; source)
+                    source->MarkShared();
+                if (SyntaxArena* arena{ token->GetArena() }; arena != nullptr)
+                    arena->MarkShared();
+            }
+        }
+    }
+
+    ParallelForWithWorker(bodies.size(), threadCount, [&](size_t index, unsigned worker) {
+        if (arenas[worker] == nullptr)
+            arenas[worker] = NewObj<SyntaxArena>();
+
+        diagnostics[index] = NewObj<DiagnosticBuffer>();
+        bodies[index]->GetContents(arenas[worker], diagnostics[index]);
+    });
+
+    for (size_t i{ 0 }; i < bodies.size(); ++i) {
+        if (const Rc<DiagnosticBuffer>& target{ bodies[i]->GetOptions().Diagnostics }; target)
+            target->Append(*diagnostics[i]);
+        else
+            GetDiagnosticEngine().Flush(*diagnostics[i]);
+    }
+}
@@ -1,6 +1,10 @@
 #ifndef COMBUST_LANGUAGE_PARSER_HH
 #define COMBUST_LANGUAGE_PARSER_HH
 #include "common.hh"
+#include "diagnostic-engine.hh"
+#include "syntax-arena.hh"
+#include <stddef.h>
+#include <vector>
 
 class BacktrackingLexer;
 
@@ -8,7 +12,118 @@ class Expression;
 class Declaration;
 class Statement;
 class SyntaxNode;
+class SyntaxToken;
+
+struct DEFERRED_BODY_IMPL;
+
+struct ParserOptions {
+    /**
+     * Remember the result of every rule at every token position, so that
+     * backtracking never parses the same range with the same rule twice.
+     */
+    bool            ShouldMemoize{ false };
+
+    /**
+     * Arena that receives the parsed nodes, e.g. one shared by a whole
+     * translation unit; each parse gets a new arena if this is null.
+     */
+    Rc<SyntaxArena> Arena{ };
+
+    /**
+     * The most rules that may be in progress at once; each level of
+     * parentheses takes four. Deeper input is reported as an error and
+     * parses to nothing. Rules in progress live on the heap, not the
+     * native stack, so the limit only bounds memory.
+     */
+    size_t          MaxDepth{ 1 << 18 };
+
+    /**
+     * Buffer that receives parse errors; they are reported straight to
+     * GetDiagnosticEngine() if this is null.
+     */
+    Rc<DiagnosticBuffer> Diagnostics{ };
+};
 
 Rc<Expression> ParseExpression(Rc<BacktrackingLexer> lexer);
+Rc<Expression> ParseExpression(Rc<BacktrackingLexer> lexer, const ParserOptions& options);
+
+/** Rule that parses the contents of a deferred body. */
+using BodyParser = Rc<Expression>(*)(Rc<BacktrackingLexer> lexer, const ParserOptions& options);
+
+/**
+ * A bracketed body whose tokens have been set aside instead of parsed.
+ * Nothing inside is looked at until GetContents is first called, so bodies
+ * that are never asked for cost no more than their tokens.
+ */
+class DeferredBody : public Object {
+public:
+    explicit DeferredBody(
+        std::vector<Rc<SyntaxToken>> tokens,
+        BodyParser                   parser,
+        const ParserOptions&         options
+    );
+    virtual ~DeferredBody();
+
+    /**
+     * \return the body's tokens, including the opening and closing brackets
+     */
+    const std::vector<Rc<SyntaxToken>>& GetTokens() const;
+
+    const ParserOptions& GetOptions() const;
+
+    /**
+     * \return true if GetContents has already parsed the body
+     */
+    bool IsParsed() const;
+
+    /**
+     * Parses the tokens between the brackets the first time it is called.
+     *
+     * \return the parsed contents, or nullptr if the parser rejected them
+     */
+    Rc<Expression> GetContents();
+
+    /**
+     * Like GetContents, but a first parse puts the nodes in arena instead
+     * of the one given by the options, and reports errors into diagnostics
+     * if it is not null.
+     */
+    Rc<Expression> GetContents(
+        const Rc<SyntaxArena>&      arena,
+        const Rc<DiagnosticBuffer>& diagnostics = Rc<DiagnosticBuffer>{ }
+    );
+
+    /**
+     * \return true if the parsed contents span every token between the
+     *         brackets; parses the body if it has not been parsed yet
+     */
+    bool IsComplete();
+
+private:
+    Owner<DEFERRED_BODY_IMPL> b;
+};
+
+/**
+ * Skips the group opened by the next token, a '{', '[' or '(', leaving its
+ * contents to be parsed by parser when they are first needed.
+ *
+ * \return the deferred body, or nullptr, consuming nothing, if the next
+ *         token opens no group or the group is never closed
+ */
+Rc<DeferredBody> DeferBody(
+    Rc<BacktrackingLexer> lexer,
+    BodyParser            parser,
+    const ParserOptions&  options = ParserOptions{ }
+);
+
+/**
+ * Parses every body that has not been parsed yet on up to threadCount
+ * threads, or GetDefaultThreadCount() if it is 0. Each thread puts its
+ * nodes in an arena of its own; the results
+ * are kept by the bodies, so they read back in the order given whatever
+ * order they were parsed in. Errors are buffered per body and reported in
+ * that order too. A body must appear only once in bodies.
+ */
+void ParseDeferredBodies(const std::vector<Rc<DeferredBody>>& bodies, unsigned threadCount);
 
 #endif
@@ -4,7 +4,7 @@
 
 class SyntaxToken;
 
-class ILexer {
+class ILexer : public Object {
 public:
     virtual Rc<SyntaxToken> ReadToken() = 0;
 };
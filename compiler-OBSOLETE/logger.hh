@@ -1,37 +1,31 @@
 #ifndef COMBUST_LOGGER_HH
 #define COMBUST_LOGGER_HH
 #include "common.hh"
+#include "diagnostic-engine.hh"
 #include "source.hh"
 
 extern char *g_ProgramName;
 
-extern int g_ErrorsLogged;
+/*
+ * Shorthands that report through GetDiagnosticEngine(), which keeps the
+ * error count. Arguments are stored as given and only formatted if the
+ * diagnostic is written.
+ */
 
-enum LOG_LEVEL {
-    LL_INFO,
-    LL_WARNING,
-    LL_ERROR,
-    LL_FATAL
-};
+template<typename... Args>
+void Log(DIAGNOSTIC_KIND kind, const Args&... args) {
+    GetDiagnosticEngine().Report(kind, nullptr, args...);
+}
 
-void Log(
-    LOG_LEVEL   level,
-    const char *format,
-    ...
-);
+template<typename... Args>
+void LogAt(PCSOURCE_LOC loc, DIAGNOSTIC_KIND kind, const Args&... args) {
+    SourceRange range{ *loc, 1 };
+    GetDiagnosticEngine().Report(kind, &range, args...);
+}
 
-void LogAt(
-    PCSOURCE_LOC loc,
-    LOG_LEVEL    level,
-    const char*  format,
-    ...
-);
-
-void LogAtRange(
-    PCSOURCE_RANGE range,
-    LOG_LEVEL      level,
-    const char*    format,
-    ...
-);
+template<typename... Args>
+void LogAtRange(PCSOURCE_RANGE range, DIAGNOSTIC_KIND kind, const Args&... args) {
+    GetDiagnosticEngine().Report(kind, range, args...);
+}
 
 #endif
@@ -1,27 +1,427 @@
+#include "allocation-profiler.hh"
+#include "backtracking-lexer.hh"
 #include "code-lexer.hh"
+#include "dependency-scanner.hh"
+#include "diagnostic-engine.hh"
+#include "language-parser.hh"
 #include "logger.hh"
+#include "parallel.hh"
 #include "source.hh"
+#include "syntax-arena.hh"
 #include "syntax.hh"
+#include "time-profiler.hh"
+#include "token-cache.hh"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
 
 char *g_ProgramName;
 
-static void PreprocessFile(const char* filePath) {
-    Rc<SourceFile> sourceFile{ OpenSourceFile(filePath) };
-    if (sourceFile == nullptr) {
-        Log(LL_FATAL, "cannot open %s", filePath);
+struct DriverOptions {
+    std::vector<std::string> InputFiles{ };
+    std::vector<std::string> IncludePaths{ };
+
+    /** -M: only scan dependencies and print make rules. */
+    bool                     IsScanOnly{ false };
+    /** -MD: write a .d file next to the normal compilation. */
+    bool                     ShouldWriteDependencyFiles{ false };
+    /** -MF: where the rules go instead of stdout or <input>.d. */
+    std::string              DependencyFile{ };
+    /** -MT: rule target instead of <input>.o. */
+    std::string              DependencyTarget{ };
+
+    unsigned                 ThreadCount{ 0 };
+
+    /** -emit-pch: precompile the single input header into this file. */
+    std::string              PchOutputFile{ };
+    /** -include-pch: start every scan from this precompiled header. */
+    std::string              PchInputFile{ };
+
+    /** -ftoken-cache=: directory of cached token streams, if any. */
+    std::string              TokenCacheDirectory{ };
+    /** -farena-huge-pages: back each file's tokens with huge pages. */
+    SYNTAX_ARENA_BACKING     ArenaBacking{ SAB_HEAP };
+    /** -fparse-bodies: parse the top-level bodies of each file in parallel. */
+    bool                     ShouldParseBodies{ false };
+
+    /** -ferror-limit=: errors written before the rest are only counted. */
+    int                      ErrorLimit{ 20 };
+    /** -w: drop every warning. */
+    bool                     AreWarningsSuppressed{ false };
+    /** -Wno-<flag>: the flags of the warnings to drop. */
+    std::vector<std::string> SuppressedWarnings{ };
+    /** -fdiagnostics-format=: how diagnostics are written. */
+    DIAGNOSTIC_FORMAT        DiagnosticFormat{ DF_TEXT };
+
+    /** -ftime-report: print the time spent in each phase. */
+    bool                     ShouldReportTime{ false };
+    /** -ftime-report=counters: add hardware counts to the report. */
+    bool                     ShouldCountEvents{ false };
+    /** -ftime-trace: write a Chrome trace to <input>.json. */
+    bool                     ShouldTraceTime{ false };
+};
+
+/**
+ * Defers every top-level '{' group in tokens and parses them all on up to
+ * threadCount threads. Errors go to diagnostics in source order.
+ */
+static void ParseBodies(
+    const std::vector<Rc<SyntaxToken>>& tokens,
+    unsigned                            threadCount,
+    const Rc<DiagnosticBuffer>&         diagnostics
+) {
+    ParserOptions options{ };
+    options.Diagnostics = diagnostics;
+
+    Rc<BacktrackingLexer> lexer{ NewObj<BacktrackingLexer>(NewObj<TokenListLexer>(tokens), BLM_STREAMING) };
+    std::vector<Rc<DeferredBody>> bodies{ };
+
+    while (lexer->PeekKind() != SK_EofToken) {
+        if (lexer->PeekKind() == SK_LBraceSymbol) {
+            if (Rc<DeferredBody> body{ DeferBody(lexer, ParseExpression, options) }; body) {
+                bodies.push_back(body);
+                continue;
+            }
+        }
+        (void)lexer->ReadToken();
+    }
+
+    ParseDeferredBodies(bodies, threadCount);
+}
+
+/**
+ * Lexes a file, or loads its tokens from tokenCache when it holds an entry
+ * for the file's current contents, and parses its bodies on up to
+ * bodyThreadCount threads if asked to. The tokens go in the calling
+ * thread's arena, which the next file on the thread reuses. Errors go to
+ * diagnostics.
+ */
+static void PreprocessFile(
+    const char*                 filePath,
+    size_t                      input,
+    TokenCache*                 tokenCache,
+    const DriverOptions&        options,
+    unsigned                    bodyThreadCount,
+    const Rc<DiagnosticBuffer>& diagnostics
+) {
+    ScopedTimer timer{ TP_PREPROCESS_FILE, input, filePath };
+
+    std::vector<char> contents{ };
+    if (!ReadSourceContents(filePath, contents)) {
+        diagnostics->Report(DK_CANNOT_OPEN_FILE, nullptr, filePath);
+        return;
+    }
+
+    bool shouldKeepTokens{ tokenCache != nullptr || options.ShouldParseBodies };
+
+    std::vector<Rc<SyntaxToken>> tokens{ };
+    if (tokenCache != nullptr && tokenCache->Load(filePath, contents, tokens) != nullptr) {
+        if (options.ShouldParseBodies)
+            ParseBodies(tokens, bodyThreadCount, diagnostics);
+        return;
+    }
+
+    Rc<SourceFile> sourceFile{ NewObj<SourceFile>(filePath, contents) };
+
+    {
+        ScopedTimer lexTimer{ TP_CODE_LEXER };
+        Rc<CodeLexer> lexer{ NewObj<CodeLexer>(sourceFile, AcquireThreadArena(options.ArenaBacking)) };
+
+        Rc<SyntaxToken> t{ };
+        do {
+            t = lexer->ReadToken();
+            if (shouldKeepTokens)
+                tokens.push_back(t);
+        }
+        while (t->GetKind() != SK_EofToken);
+    }
+
+    if (tokenCache != nullptr && !tokenCache->Store(*sourceFile, tokens))
+        diagnostics->Report(DK_CANNOT_WRITE_TOKEN_CACHE, nullptr, filePath);
+
+    if (options.ShouldParseBodies)
+        ParseBodies(tokens, bodyThreadCount, diagnostics);
+}
+
+/**
+ * Preprocesses every input in parallel, each thread reusing its own arena
+ * from one file to the next, and writes the diagnostics in input order.
+ */
+static void PreprocessFiles(const DriverOptions& options) {
+    Owner<TokenCache> tokenCache{ };
+    if (!options.TokenCacheDirectory.empty())
+        tokenCache = NewChild<TokenCache>(options.TokenCacheDirectory);
+
+    size_t fileCount{ options.InputFiles.size() };
+    std::vector<Rc<DiagnosticBuffer>> diagnostics(fileCount);
+
+    // Threads the files leave over, e.g. all of them for a single file, go
+    // to parsing each file's bodies.
+    unsigned threadCount{ options.ThreadCount ? options.ThreadCount : GetDefaultThreadCount() };
+    unsigned fileThreadCount{ static_cast<unsigned>(std::min<size_t>(threadCount, fileCount)) };
+    unsigned bodyThreadCount{ fileThreadCount > 1 ? threadCount / fileThreadCount : threadCount };
+
+    ParallelFor(fileCount, threadCount, [&](size_t index) {
+        diagnostics[index] = NewObj<DiagnosticBuffer>(&GetDiagnosticEngine());
+        PreprocessFile(
+            options.InputFiles[index].c_str(),
+            index,
+            tokenCache.get(),
+            options,
+            bodyThreadCount,
+            diagnostics[index]
+        );
+    });
+
+    for (const Rc<DiagnosticBuffer>& buffer : diagnostics)
+        GetDiagnosticEngine().Flush(*buffer);
+}
+
+static bool WriteFile(const std::string& path, const std::string& contents) {
+    FILE* file{ fopen(path.c_str(), "wb") };
+    if (file == nullptr) {
+        Log(DK_CANNOT_WRITE_FILE, path);
+        return false;
+    }
+
+    fwrite(contents.data(), 1, contents.size(), file);
+    fclose(file);
+    return true;
+}
+
+static std::string GetDependencyFileName(const std::string& inputPath) {
+    std::string name{ GetObjectFileName(inputPath) };
+    name.resize(name.size() - 2);
+    return name + ".d";
+}
+
+static std::string GetTraceFileName(const std::string& inputPath) {
+    std::string name{ GetObjectFileName(inputPath) };
+    name.resize(name.size() - 2);
+    return name + ".json";
+}
+
+static void ReportScanDiagnostics(const ScanResult& result, IN_OUT DiagnosticBuffer& buffer) {
+    for (const ScanDiagnostic& diagnostic : result.Diagnostics) {
+        DIAGNOSTIC_KIND kind{ diagnostic.IsError ? DK_SCAN_ERROR : DK_SCAN_WARNING };
+        SourceRange range{ diagnostic.Location, 1 };
+
+        buffer.Report(kind, &range, diagnostic.Message);
+    }
+}
+
+static void EmitPrecompiledHeader(const DriverOptions& options) {
+    if (options.InputFiles.size() != 1) {
+        Log(DK_EMIT_PCH_INPUT_COUNT);
         return;
     }
 
-    Rc<CodeLexer> lexer{ NewObj<CodeLexer>(sourceFile) };
+    DependencyScanner scanner{ options.IncludePaths };
+    DiagnosticBuffer diagnostics{ &GetDiagnosticEngine() };
+
+    ReportScanDiagnostics(scanner.WritePrecompiledHeader(options.InputFiles[0], options.PchOutputFile), diagnostics);
+    GetDiagnosticEngine().Flush(diagnostics);
+}
+
+/**
+ * Scans every input in parallel and writes the make rules, and any
+ * diagnostics, in input order.
+ */
+static void ScanDependencies(const DriverOptions& options) {
+    DependencyScanner scanner{ options.IncludePaths };
+    std::vector<ScanResult> results(options.InputFiles.size());
+    std::vector<DiagnosticBuffer> diagnostics(options.InputFiles.size(), DiagnosticBuffer{ &GetDiagnosticEngine() });
+
+    if (!options.PchInputFile.empty() && !scanner.LoadPrecompiledHeader(options.PchInputFile)) {
+        Log(DK_CANNOT_LOAD_PCH, options.PchInputFile);
+        return;
+    }
+
+    ParallelFor(
+        options.InputFiles.size(),
+        options.ThreadCount ? options.ThreadCount : GetDefaultThreadCount(),
+        [&](size_t index) {
+            ScopedTimer timer{ TP_SCAN_FILE, index, options.InputFiles[index] };
+            results[index] = scanner.ScanFile(options.InputFiles[index]);
+            ReportScanDiagnostics(results[index], diagnostics[index]);
+        }
+    );
+
+    std::string rules{ };
 
-    Rc<SyntaxToken> t{ };
-    do {
-        t = lexer->ReadToken();
+    for (size_t i{ 0 }; i < results.size(); ++i) {
+        const ScanResult& result{ results[i] };
+
+        GetDiagnosticEngine().Flush(diagnostics[i]);
+
+        if (!result.Succeeded)
+            continue;
+
+        std::string target{
+            options.DependencyTarget.empty()
+                ? GetObjectFileName(options.InputFiles[i])
+                : options.DependencyTarget
+        };
+        std::string rule{ FormatMakeRule(target, result.Dependencies) };
+
+        if (options.ShouldWriteDependencyFiles && options.DependencyFile.empty())
+            WriteFile(GetDependencyFileName(options.InputFiles[i]), rule);
+        else
+            rules += rule;
+    }
+
+    if (!options.DependencyFile.empty())
+        WriteFile(options.DependencyFile, rules);
+    else if (!rules.empty())
+        fwrite(rules.data(), 1, rules.size(), stdout);
+}
+
+/**
+ * \return false if the command line is malformed
+ */
+static bool ParseOptions(int argc, char** argv, OUT DriverOptions& options) {
+    for (int i{ 1 }; i < argc; ++i) {
+        const char* arg{ argv[i] };
+
+        auto takeValue = [&](const char* option) -> const char* {
+            size_t length{ strlen(option) };
+            if (arg[length] != 0)
+                return arg + length;
+            if (i + 1 < argc)
+                return argv[++i];
+            Log(DK_MISSING_ARGUMENT, option);
+            return nullptr;
+        };
+
+        if (arg[0] != '-' || arg[1] == 0) {
+            options.InputFiles.push_back(arg);
+        }
+        else if (strncmp(arg, "-I", 2) == 0) {
+            const char* value{ takeValue("-I") };
+            if (!value) return false;
+            options.IncludePaths.push_back(value);
+        }
+        else if (strcmp(arg, "-M") == 0) {
+            options.IsScanOnly = true;
+        }
+        else if (strcmp(arg, "-MD") == 0) {
+            options.ShouldWriteDependencyFiles = true;
+        }
+        else if (strncmp(arg, "-MF", 3) == 0) {
+            const char* value{ takeValue("-MF") };
+            if (!value) return false;
+            options.DependencyFile = value;
+        }
+        else if (strncmp(arg, "-MT", 3) == 0) {
+            const char* value{ takeValue("-MT") };
+            if (!value) return false;
+            options.DependencyTarget = value;
+        }
+        else if (strcmp(arg, "-emit-pch") == 0) {
+            const char* value{ takeValue("-emit-pch") };
+            if (!value) return false;
+            options.PchOutputFile = value;
+        }
+        else if (strcmp(arg, "-include-pch") == 0) {
+            const char* value{ takeValue("-include-pch") };
+            if (!value) return false;
+            options.PchInputFile = value;
+        }
+        else if (strncmp(arg, "-ftoken-cache=", 14) == 0) {
+            options.TokenCacheDirectory = arg + 14;
+        }
+        else if (strcmp(arg, "-farena-huge-pages") == 0) {
+            options.ArenaBacking = SAB_HUGE_PAGES;
+        }
+        else if (strcmp(arg, "-fparse-bodies") == 0) {
+            options.ShouldParseBodies = true;
+        }
+        else if (strncmp(arg, "-ferror-limit=", 14) == 0) {
+            options.ErrorLimit = atoi(arg + 14);
+        }
+        else if (strncmp(arg, "-fdiagnostics-format=", 21) == 0) {
+            const char* value{ arg + 21 };
+
+            if (strcmp(value, "text") == 0)
+                options.DiagnosticFormat = DF_TEXT;
+            else if (strcmp(value, "json") == 0)
+                options.DiagnosticFormat = DF_JSON;
+            else if (strcmp(value, "sarif") == 0)
+                options.DiagnosticFormat = DF_SARIF;
+            else {
+                Log(DK_INVALID_OPTION_VALUE, value, "-fdiagnostics-format=");
+                return false;
+            }
+        }
+        else if (strcmp(arg, "-ftime-report") == 0) {
+            options.ShouldReportTime = true;
+        }
+        else if (strcmp(arg, "-ftime-report=counters") == 0) {
+            options.ShouldReportTime = true;
+            options.ShouldCountEvents = true;
+        }
+        else if (strcmp(arg, "-ftime-trace") == 0) {
+            options.ShouldTraceTime = true;
+        }
+        else if (strcmp(arg, "-w") == 0) {
+            options.AreWarningsSuppressed = true;
+        }
+        else if (strncmp(arg, "-Wno-", 5) == 0) {
+            options.SuppressedWarnings.push_back(arg + 5);
+        }
+        else if (strncmp(arg, "-j", 2) == 0) {
+            const char* value{ takeValue("-j") };
+            if (!value) return false;
+            options.ThreadCount = static_cast<unsigned>(atoi(value));
+        }
+        else {
+            Log(DK_UNKNOWN_OPTION, arg);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Writes what -ftime-report and -ftime-trace ask for and, in builds with
+ * the allocation profiler, the allocation report.
+ */
+static void WriteProfiles(const DriverOptions& options) {
+    if (options.ShouldReportTime) {
+        std::string report{ FormatTimeReport() };
+        fwrite(report.data(), 1, report.size(), stderr);
+    }
+
+    if (options.ShouldTraceTime) {
+        for (size_t i{ 0 }; i < options.InputFiles.size(); ++i) {
+            std::string path{ GetTraceFileName(options.InputFiles[i]) };
+            if (!WriteTimeTrace(path, i))
+                Log(DK_CANNOT_WRITE_FILE, path);
+        }
+    }
+
+#if defined(COMBUST_ALLOCATION_PROFILER)
+    std::string allocationReport{ FormatAllocationReport() };
+    fwrite(allocationReport.data(), 1, allocationReport.size(), stderr);
+#endif
+}
+
+static void ApplyDiagnosticOptions(const DriverOptions& options) {
+    DiagnosticEngine& engine{ GetDiagnosticEngine() };
+
+    engine.SetFormat(options.DiagnosticFormat);
+    engine.SetErrorLimit(options.ErrorLimit);
+    if (options.AreWarningsSuppressed)
+        engine.SuppressAllWarnings();
+
+    for (const std::string& flag : options.SuppressedWarnings) {
+        if (!engine.SuppressWarning(flag))
+            Log(DK_UNKNOWN_WARNING_OPTION, "-Wno-" + flag);
     }
-    while (!IsSyntaxNode<EofToken>(t));
 }
 
 int main(int argc, char** argv) {
@@ -32,13 +432,69 @@ int main(int argc, char** argv) {
         printf("\
 Usage: %s [options] file...\n\
 Options:\n\
+  -I <dir>      Add <dir> to the include search path\n\
+  -M            Only scan #include dependencies and print make rules\n\
+  -MD           Also write make rules to <file>.d\n\
+  -MF <file>    Write make rules to <file>\n\
+  -MT <target>  Use <target> as the make rule target\n\
+  -j <n>        Process up to <n> files in parallel\n\
+  -emit-pch <file>\n\
+                Precompile the input header's preprocessor state to <file>\n\
+  -include-pch <file>\n\
+                Scan every input as if <file>'s header were included first\n\
+  -ftoken-cache=<dir>\n\
+                Reuse the tokens of unchanged files across runs\n\
+  -farena-huge-pages\n\
+                Allocate each file's tokens in 2 MiB chunks backed by huge\n\
+                pages, where the system allows it\n\
+  -fparse-bodies\n\
+                Parse each file's top-level { } bodies, on up to -j threads\n\
+  -ferror-limit=<n>\n\
+                Stop writing errors after <n> of them (0 for no limit)\n\
+  -w            Suppress all warnings\n\
+  -Wno-<flag>   Suppress the warnings named by <flag>\n\
+  -ftime-report Print the time spent in each phase of the compiler\n\
+  -ftime-report=counters\n\
+                Also count cycles, instructions, branch misses and cache\n\
+                misses in each phase, where the system allows it\n\
+  -ftime-trace  Write a Chrome trace of each input's work to <file>.json\n\
+  -fdiagnostics-format=text|json|sarif\n\
+                Write diagnostics as text, one JSON object per line, or a\n\
+                SARIF log\n\
 ", argv[0]);
         return EXIT_FAILURE;
     }
 
-    for (int i{ 1 }; i < argc; ++i) {
-        PreprocessFile(argv[i]);
+    DriverOptions options{ };
+    if (!ParseOptions(argc, argv, options))
+        return EXIT_FAILURE;
+
+    ApplyDiagnosticOptions(options);
+
+    if (options.ShouldReportTime)
+        EnableTimeReport();
+    if (options.ShouldCountEvents)
+        EnableCounterReport();
+    if (options.ShouldTraceTime)
+        EnableTimeTrace();
+
+    if (!options.PchOutputFile.empty()) {
+        EmitPrecompiledHeader(options);
+        WriteProfiles(options);
+        GetDiagnosticEngine().ReportSummary();
+        GetDiagnosticEngine().Finish();
+        return GetDiagnosticEngine().GetErrorCount() ? EXIT_FAILURE : EXIT_SUCCESS;
     }
 
-    return g_ErrorsLogged ? EXIT_FAILURE : EXIT_SUCCESS;
+    if (options.IsScanOnly || options.ShouldWriteDependencyFiles)
+        ScanDependencies(options);
+
+    if (!options.IsScanOnly)
+        PreprocessFiles(options);
+
+    WriteProfiles(options);
+
+    GetDiagnosticEngine().ReportSummary();
+    GetDiagnosticEngine().Finish();
+    return GetDiagnosticEngine().GetErrorCount() ? EXIT_FAILURE : EXIT_SUCCESS;
 }
@@ -0,0 +1,108 @@
+#if defined(_WIN32)
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+#include "mapped-file.hh"
+#include <stdio.h>
+#include <vector>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct MAPPED_FILE_IMPL {
+    const char*       Data{ nullptr };
+    size_t            Size{ 0 };
+#if defined(_WIN32)
+    std::vector<char> Buffer{ };
+#else
+    void*             Mapping{ nullptr };
+#endif
+};
+
+MappedFile::MappedFile() :
+    m{ NewChild<MAPPED_FILE_IMPL>() }
+{ }
+
+MappedFile::~MappedFile() {
+#if !defined(_WIN32)
+    if (m->Mapping != nullptr)
+        munmap(m->Mapping, m->Size);
+#endif
+}
+
+#if defined(_WIN32)
+bool MappedFile::Open(const std::string& path) {
+    FILE* file{ fopen(path.c_str(), "rb") };
+    if (file == nullptr)
+        return false;
+
+    fseek(file, 0, SEEK_END);
+    long length{ ftell(file) };
+    fseek(file, 0, SEEK_SET);
+
+    if (length < 0) {
+        fclose(file);
+        return false;
+    }
+
+    m->Buffer.resize(static_cast<size_t>(length));
+    size_t read{ fread(m->Buffer.data(), 1, m->Buffer.size(), file) };
+    fclose(file);
+
+    if (read != m->Buffer.size())
+        return false;
+
+    m->Data = m->Buffer.data();
+    m->Size = m->Buffer.size();
+    return true;
+}
+#else
+bool MappedFile::Open(const std::string& path) {
+    int fd{ open(path.c_str(), O_RDONLY) };
+    if (fd < 0)
+        return false;
+
+    struct stat status{ };
+    if (fstat(fd, &status) != 0) {
+        close(fd);
+        return false;
+    }
+
+    size_t size{ static_cast<size_t>(status.st_size) };
+    if (size == 0) {
+        close(fd);
+        m->Data = "";
+        m->Size = 0;
+        return true;
+    }
+
+    void* mapping{ mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) };
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+        return false;
+
+    m->Mapping = mapping;
+    m->Data    = static_cast<const char*>(mapping);
+    m->Size    = size;
+    return true;
+}
+#endif
+
+const char* MappedFile::GetData() const {
+    return m->Data;
+}
+
+size_t MappedFile::GetSize() const {
+    return m->Size;
+}
+
+Rc<MappedFile> OpenMappedFile(const std::string& path) {
+    Rc<MappedFile> file{ NewObj<MappedFile>() };
+    if (!file->Open(path))
+        return Rc<MappedFile>{ };
+
+    return file;
+}
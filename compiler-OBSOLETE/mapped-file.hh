@@ -0,0 +1,35 @@
+#ifndef COMBUST_MAPPED_FILE_HH
+#define COMBUST_MAPPED_FILE_HH
+#include "common.hh"
+#include <stddef.h>
+#include <string>
+
+struct MAPPED_FILE_IMPL;
+
+/**
+ * Read-only view of a whole file. The file is memory-mapped where the
+ * platform supports it and read into memory otherwise.
+ */
+class MappedFile : public Object {
+public:
+    explicit MappedFile();
+    virtual ~MappedFile();
+
+    /**
+     * \return false if the file cannot be opened or mapped
+     */
+    bool Open(const std::string& path);
+
+    const char* GetData() const;
+    size_t GetSize() const;
+
+private:
+    Owner<MAPPED_FILE_IMPL> m;
+};
+
+/**
+ * \return the mapped file, or nullptr if it cannot be opened
+ */
+Rc<MappedFile> OpenMappedFile(const std::string& path);
+
+#endif
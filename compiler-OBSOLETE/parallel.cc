@@ -0,0 +1,118 @@
+#include "parallel.hh"
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Indices a worker has yet to call the body for. The worker takes them from
+ * the front; idle workers steal the back half.
+ */
+struct WORK_RANGE {
+    std::mutex Mutex{ };
+    size_t     Begin{ 0 };
+    size_t     End{ 0 };
+};
+
+/**
+ * \return false if range is empty, or else true after taking its first
+ *         index
+ */
+static bool TakeFront(WORK_RANGE& range, OUT size_t& index) {
+    std::lock_guard<std::mutex> lock{ range.Mutex };
+    if (range.Begin == range.End)
+        return false;
+
+    index = range.Begin++;
+    return true;
+}
+
+/**
+ * Moves the back half of the first other worker's range that is not empty
+ * to the thief's own, which must be empty. Only one lock is held at a time,
+ * so workers stealing from each other cannot deadlock.
+ *
+ * \return false if every other range was empty
+ */
+static bool Steal(std::vector<WORK_RANGE>& ranges, unsigned thief) {
+    for (size_t i{ 1 }; i < ranges.size(); ++i) {
+        WORK_RANGE& victim{ ranges[(thief + i) % ranges.size()] };
+        size_t begin{ 0 };
+        size_t end{ 0 };
+
+        {
+            std::lock_guard<std::mutex> lock{ victim.Mutex };
+            if (victim.Begin == victim.End)
+                continue;
+
+            end = victim.End;
+            begin = victim.End - (victim.End - victim.Begin + 1) / 2;
+            victim.End = begin;
+        }
+
+        WORK_RANGE& own{ ranges[thief] };
+        std::lock_guard<std::mutex> lock{ own.Mutex };
+        own.Begin = begin;
+        own.End = end;
+        return true;
+    }
+
+    return false;
+}
+
+unsigned GetDefaultThreadCount() {
+    unsigned count{ std::thread::hardware_concurrency() };
+    return count == 0 ? 1 : count;
+}
+
+void ParallelFor(
+    size_t                                   count,
+    unsigned                                 threadCount,
+    const std::function<void(size_t index)>& body
+)
+{
+    ParallelForWithWorker(count, threadCount, [&](size_t index, unsigned) { body(index); });
+}
+
+void ParallelForWithWorker(
+    size_t                                                   count,
+    unsigned                                                 threadCount,
+    const std::function<void(size_t index, unsigned worker)>& body
+)
+{
+    if (threadCount > count)
+        threadCount = static_cast<unsigned>(count);
+
+    if (threadCount <= 1) {
+        for (size_t i{ 0 }; i < count; ++i)
+            body(i, 0);
+        return;
+    }
+
+    // Each worker starts with an equal share, in order, so that bodies of
+    // similar cost need no stealing at all.
+    std::vector<WORK_RANGE> ranges(threadCount);
+    for (unsigned i{ 0 }; i < threadCount; ++i) {
+        ranges[i].Begin = count * i / threadCount;
+        ranges[i].End = count * (i + 1) / threadCount;
+    }
+
+    auto worker = [&](unsigned number) {
+        do {
+            size_t index{ 0 };
+            while (TakeFront(ranges[number], index))
+                body(index, number);
+        }
+        while (Steal(ranges, number));
+    };
+
+    std::vector<std::thread> threads{ };
+    threads.reserve(threadCount - 1);
+
+    for (unsigned i{ 1 }; i < threadCount; ++i)
+        threads.emplace_back(worker, i);
+
+    worker(0);
+
+    for (std::thread& thread : threads)
+        thread.join();
+}
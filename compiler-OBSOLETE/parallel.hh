@@ -0,0 +1,39 @@
+#ifndef COMBUST_PARALLEL_HH
+#define COMBUST_PARALLEL_HH
+#include "common.hh"
+#include <functional>
+
+/**
+ * \return the number of worker threads to use when none is requested
+ */
+unsigned GetDefaultThreadCount();
+
+/**
+ * Calls body(index) for every index in [0, count) using up to threadCount
+ * threads (the calling thread included), in no particular order; returns
+ * once every call has finished.
+ */
+void ParallelFor(
+    size_t                                   count,
+    unsigned                                 threadCount,
+    const std::function<void(size_t index)>& body
+);
+
+/**
+ * Like ParallelFor, but also passes the number, in [0, threadCount), of
+ * the thread making the call, so that each thread can keep state of its
+ * own. The calling thread is number 0.
+ *
+ * Threads are started per call. Each one starts with an equal, contiguous
+ * share of the indices and, once its share is done, steals the back half
+ * of what another thread has left. A few long bodies among many short
+ * ones, e.g. one huge function in a generated file, thus keep no thread
+ * idle while others still have work queued.
+ */
+void ParallelForWithWorker(
+    size_t                                                   count,
+    unsigned                                                 threadCount,
+    const std::function<void(size_t index, unsigned worker)>& body
+);
+
+#endif
@@ -0,0 +1,150 @@
+#include "performance-counters.hh"
+#if defined(__linux__)
+#include <string.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char* const PERFORMANCE_COUNTER_NAMES[PC_COUNT]{
+    "Cycles",
+    "Instructions",
+    "Branch misses",
+    "L1D misses",
+    "LLC misses"
+};
+
+const char* GetPerformanceCounterName(PERFORMANCE_COUNTER counter) {
+    return PERFORMANCE_COUNTER_NAMES[counter];
+}
+
+#if defined(__linux__)
+
+struct COUNTER_EVENT {
+    uint32_t Type;
+    uint64_t Config;
+};
+
+static constexpr uint64_t MakeCacheMissEvent(uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+static const COUNTER_EVENT COUNTER_EVENTS[PC_COUNT]{
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { PERF_TYPE_HW_CACHE, MakeCacheMissEvent(PERF_COUNT_HW_CACHE_L1D) },
+    { PERF_TYPE_HW_CACHE, MakeCacheMissEvent(PERF_COUNT_HW_CACHE_LL) }
+};
+
+/**
+ * The counters of one thread. The first that opens leads the group, so a
+ * single read returns them all, scheduled onto the PMU together.
+ */
+struct COUNTER_GROUP {
+    bool     IsOpened{ false };
+    int      Leader{ -1 };
+    int      Files[PC_COUNT]{ };
+    /** The counter behind each value in the group's read, in order. */
+    unsigned Order[PC_COUNT]{ };
+    unsigned OpenCount{ 0 };
+    unsigned AvailableMask{ 0 };
+
+    ~COUNTER_GROUP() {
+        for (unsigned i{ 0 }; i < OpenCount; ++i)
+            close(Files[i]);
+    }
+};
+
+static int OpenCounter(const COUNTER_EVENT& event, int leader) {
+    perf_event_attr attributes;
+    memset(&attributes, 0, sizeof(attributes));
+
+    attributes.size           = sizeof(attributes);
+    attributes.type           = event.Type;
+    attributes.config         = event.Config;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv     = 1;
+    attributes.read_format    =
+        PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    long file{ syscall(SYS_perf_event_open, &attributes, 0, -1, leader, PERF_FLAG_FD_CLOEXEC) };
+    return static_cast<int>(file);
+}
+
+static void OpenGroup(IN_OUT COUNTER_GROUP& group) {
+    group.IsOpened = true;
+
+    for (unsigned counter{ 0 }; counter < PC_COUNT; ++counter) {
+        int file{ OpenCounter(COUNTER_EVENTS[counter], group.Leader) };
+        if (file < 0)
+            continue;
+
+        if (group.Leader < 0)
+            group.Leader = file;
+
+        group.Files[group.OpenCount] = file;
+        group.Order[group.OpenCount] = counter;
+        ++group.OpenCount;
+        group.AvailableMask |= 1u << counter;
+    }
+}
+
+bool ReadPerformanceCounters(OUT PerformanceCounterSample& sample) {
+    thread_local COUNTER_GROUP group{ };
+
+    sample = PerformanceCounterSample{ };
+
+    if (!group.IsOpened)
+        OpenGroup(group);
+
+    if (group.Leader < 0)
+        return false;
+
+    /* nr, time enabled, time running, then a value per counter. */
+    uint64_t buffer[3 + PC_COUNT]{ };
+    ssize_t size{ read(group.Leader, buffer, sizeof(buffer)) };
+
+    if (size < static_cast<ssize_t>(3 * sizeof(uint64_t)) || buffer[0] != group.OpenCount)
+        return false;
+
+    sample.TimeEnabled = buffer[1];
+    sample.TimeRunning = buffer[2];
+    sample.AvailableMask = group.AvailableMask;
+
+    for (unsigned i{ 0 }; i < group.OpenCount; ++i)
+        sample.Values[group.Order[i]] = buffer[3 + i];
+
+    return true;
+}
+
+#else
+
+bool ReadPerformanceCounters(OUT PerformanceCounterSample& sample) {
+    sample = PerformanceCounterSample{ };
+    return false;
+}
+
+#endif
+
+void GetPerformanceCounterDeltas(
+    const PerformanceCounterSample& start,
+    const PerformanceCounterSample& end,
+    OUT uint64_t                    (&deltas)[PC_COUNT]
+) {
+    uint64_t enabled{ end.TimeEnabled - start.TimeEnabled };
+    uint64_t running{ end.TimeRunning - start.TimeRunning };
+
+    for (unsigned counter{ 0 }; counter < PC_COUNT; ++counter) {
+        deltas[counter] = 0;
+
+        if (running == 0 || (start.AvailableMask & end.AvailableMask & (1u << counter)) == 0)
+            continue;
+
+        uint64_t delta{ end.Values[counter] - start.Values[counter] };
+        if (running < enabled)
+            delta = static_cast<uint64_t>(static_cast<double>(delta) * enabled / running);
+
+        deltas[counter] = delta;
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef COMBUST_PERFORMANCE_COUNTERS_HH
+#define COMBUST_PERFORMANCE_COUNTERS_HH
+#include "common.hh"
+#include <stdint.h>
+
+/**
+ * Hardware events counted for -ftime-report=counters, in user mode only.
+ */
+enum PERFORMANCE_COUNTER {
+    PC_CYCLES,
+    PC_INSTRUCTIONS,
+    PC_BRANCH_MISSES,
+    PC_L1D_MISSES,
+    PC_LLC_MISSES,
+    PC_COUNT
+};
+
+const char* GetPerformanceCounterName(PERFORMANCE_COUNTER counter);
+
+/**
+ * Running totals of the calling thread's counters, as read at one point.
+ * Only the counters in AvailableMask, a bit per PERFORMANCE_COUNTER, were
+ * read.
+ */
+struct PerformanceCounterSample {
+    uint64_t Values[PC_COUNT]{ };
+    uint64_t TimeEnabled{ 0 };
+    uint64_t TimeRunning{ 0 };
+    unsigned AvailableMask{ 0 };
+};
+
+/**
+ * Reads the calling thread's counters, which are opened as a group on the
+ * thread's first read. Counters the kernel or CPU does not provide are
+ * left out of the sample.
+ *
+ * \return false if no counter is available, e.g. outside of Linux or when
+ *         perf_event_paranoid forbids them
+ */
+bool ReadPerformanceCounters(OUT PerformanceCounterSample& sample);
+
+/**
+ * Computes how much each counter advanced between two samples of the same
+ * thread, scaled up for the time the kernel had the group switched out.
+ */
+void GetPerformanceCounterDeltas(
+    const PerformanceCounterSample& start,
+    const PerformanceCounterSample& end,
+    OUT uint64_t                    (&deltas)[PC_COUNT]
+);
+
+#endif
@@ -1,6 +1,7 @@
 #include "preprocessor-lexer.hh"
 #include "code-lexer.hh"
 #include "source.hh"
+#include "syntax-arena.hh"
 #include "syntax.hh"
 #include <queue>
 #include <string>
@@ -18,13 +19,20 @@ constexpr bool IsIdentifierOrKeyword(char c) noexcept {
 
 struct PREPROCESSOR_LEXER_IMPL {
     std::queue<Rc<SyntaxToken>> tokensToReturn{ };
+    Rc<SyntaxArena>             Arena{ };
 };
 
 PreprocessorLexer::PreprocessorLexer(Rc<const SourceFile> input) :
-    lexer{ NewChild<CodeLexer>(input) },
-    p{ NewChild<PREPROCESSOR_LEXER_IMPL>() }
+    PreprocessorLexer{ input, Rc<SyntaxArena>{ } }
 {}
 
+PreprocessorLexer::PreprocessorLexer(Rc<const SourceFile> input, Rc<SyntaxArena> arena) :
+    lexer{ NewChild<CodeLexer>(input, arena) },
+    p{ NewChild<PREPROCESSOR_LEXER_IMPL>() }
+{
+    p->Arena = arena;
+}
+
 PreprocessorLexer::~PreprocessorLexer() {}
 
 Rc<SyntaxToken> PreprocessorLexer::ReadToken() {
@@ -59,22 +67,25 @@ Rc<SyntaxToken> PreprocessorLexer::ReadToken_Internal() {
         }
 
         if (keyword == "if") {
-            result = NewObj<IfDirective>();
+            result = NewToken<IfDirective>(p->Arena);
         }
         else if (keyword == "ifdef") {
-            result = NewObj<IfDefDirective>();
+            result = NewToken<IfDefDirective>(p->Arena);
         }
         else if (keyword == "ifndef") {
-            result = NewObj<IfNDefDirective>();
+            result = NewToken<IfNDefDirective>(p->Arena);
         }
         else if (keyword == "elif") {
-            result = NewObj<ElifDirective>();
+            result = NewToken<ElifDirective>(p->Arena);
+        }
+        else if (keyword == "else") {
+            result = NewToken<ElseDirective>(p->Arena);
         }
         else if (keyword == "endif") {
-            result = NewObj<EndIfDirective>();
+            result = NewToken<EndIfDirective>(p->Arena);
         }
         else if (keyword == "include") {
-            result = NewObj<IncludeDirective>();
+            result = NewToken<IncludeDirective>(p->Arena);
 
             while (IsWhitespace(lexer->PeekChar()))
                 lexer->ReadChar();
@@ -94,22 +105,25 @@ Rc<SyntaxToken> PreprocessorLexer::ReadToken_Internal() {
             }
         }
         else if (keyword == "define") {
-            result = NewObj<DefineDirective>();
+            result = NewToken<DefineDirective>(p->Arena);
         }
         else if (keyword == "undef") {
-            result = NewObj<UnDefDirective>();
+            result = NewToken<UnDefDirective>(p->Arena);
         }
         else if (keyword == "line") {
-            result = NewObj<LineDirective>();
+            result = NewToken<LineDirective>(p->Arena);
         }
         else if (keyword == "error") {
-            result = NewObj<ErrorDirective>();
+            result = NewToken<ErrorDirective>(p->Arena);
         }
         else if (keyword == "warning") {
-            result = NewObj<WarningDirective>();
+            result = NewToken<WarningDirective>(p->Arena);
+        }
+        else if (keyword == "pragma") {
+            result = NewToken<PragmaDirective>(p->Arena);
         }
         else {
-            Rc<InvalidDirective> directive{ NewObj<InvalidDirective>() };
+            Rc<InvalidDirective> directive{ NewToken<InvalidDirective>(p->Arena) };
             directive->SetName(keyword);
             result = directive;
         }
@@ -5,13 +5,16 @@
 
 class CodeLexer;
 class SourceFile;
+class SyntaxArena;
 class SyntaxToken;
 
 struct PREPROCESSOR_LEXER_IMPL;
 
-class PreprocessorLexer : public Object, public virtual ILexer {
+class PreprocessorLexer : public ILexer {
 public:
     explicit PreprocessorLexer(Rc<const SourceFile> input);
+    /** Creates the tokens in arena, like the CodeLexer it reads through. */
+    PreprocessorLexer(Rc<const SourceFile> input, Rc<SyntaxArena> arena);
     virtual ~PreprocessorLexer();
 
     Rc<SyntaxToken> ReadToken() override;
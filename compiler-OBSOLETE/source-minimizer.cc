@@ -0,0 +1,188 @@
+#include "source-minimizer.hh"
+#include "source.hh"
+#include <vector>
+
+enum MINIMIZER_STATE {
+    MS_CODE,
+    MS_STRING,
+    MS_BLOCK_COMMENT,
+    MS_LINE_COMMENT
+};
+
+/**
+ * Replaces every comment by spaces, keeping new-lines so that line numbers
+ * do not change. String and character literals are copied verbatim.
+ *
+ * A block comment that spans lines within a directive must not end the
+ * directive, so its new-lines become spaces as well and are put back right
+ * after the directive's last line.
+ */
+static void StripComments(
+    const std::vector<char>& input,
+    size_t                   length,
+    OUT std::vector<char>&   output
+)
+{
+    MINIMIZER_STATE state{ MS_CODE };
+    char quote{ 0 };
+    bool isLineBlank{ true };
+    bool isInDirective{ false };
+    size_t deferredNewLines{ 0 };
+
+    output.clear();
+    output.reserve(length);
+
+    for (size_t i{ 0 }; i < length; ++i) {
+        char c{ input[i] };
+        char next{ i + 1 < length ? input[i + 1] : '\0' };
+
+        if (c == '\n' && state != MS_BLOCK_COMMENT) {
+            bool isContinued{ i > 0 && input[i - 1] == '\\' };
+            if (state != MS_LINE_COMMENT || !isContinued)
+                state = MS_CODE;
+
+            output.push_back('\n');
+            isLineBlank = true;
+
+            if (isInDirective && !isContinued) {
+                output.insert(output.end(), deferredNewLines, '\n');
+                deferredNewLines = 0;
+                isInDirective = false;
+            }
+            continue;
+        }
+
+        switch (state) {
+        case MS_CODE:
+            if (c == '/' && next == '*') {
+                state = MS_BLOCK_COMMENT;
+                output.insert(output.end(), 2, ' ');
+                ++i;
+            }
+            else if (c == '/' && next == '/') {
+                state = MS_LINE_COMMENT;
+                output.insert(output.end(), 2, ' ');
+                ++i;
+            }
+            else {
+                // '#' or its trigraph, preceded by nothing but blanks and
+                // comments, starts a directive.
+                if (isLineBlank && (c == '#' || (c == '?' && next == '?' && i + 2 < length && input[i + 2] == '=')))
+                    isInDirective = true;
+                if (c != ' ' && c != '\t' && c != '\r')
+                    isLineBlank = false;
+
+                if (c == '"' || c == '\'') {
+                    state = MS_STRING;
+                    quote = c;
+                }
+                output.push_back(c);
+            }
+            break;
+
+        case MS_STRING:
+            output.push_back(c);
+            if (c == '\\' && next != '\n' && i + 1 < length) {
+                output.push_back(next);
+                ++i;
+            }
+            else if (c == quote) {
+                state = MS_CODE;
+            }
+            break;
+
+        case MS_BLOCK_COMMENT:
+            if (c == '*' && next == '/') {
+                state = MS_CODE;
+                output.insert(output.end(), 2, ' ');
+                ++i;
+            }
+            else if (c == '\n' && !isInDirective) {
+                output.push_back('\n');
+                isLineBlank = true;
+            }
+            else {
+                output.push_back(' ');
+                if (c == '\n')
+                    ++deferredNewLines;
+            }
+            break;
+
+        case MS_LINE_COMMENT:
+            output.push_back(' ');
+            break;
+        }
+    }
+
+    output.insert(output.end(), deferredNewLines, '\n');
+}
+
+/**
+ * \return true if the line starting at begin is a directive
+ */
+static bool IsDirectiveLine(const std::vector<char>& text, size_t begin, size_t end) {
+    size_t i{ begin };
+    while (i < end && (text[i] == ' ' || text[i] == '\t' || text[i] == '\r'))
+        ++i;
+
+    if (i < end && text[i] == '#')
+        return true;
+
+    // Trigraph for '#'.
+    return i + 2 < end && text[i] == '?' && text[i + 1] == '?' && text[i + 2] == '=';
+}
+
+/**
+ * \return true if the line ending right before end continues on the next
+ *         line with a new-line escape
+ */
+static bool IsContinuedLine(const std::vector<char>& text, size_t begin, size_t end) {
+    while (end > begin && (text[end - 1] == ' ' || text[end - 1] == '\t' || text[end - 1] == '\r'))
+        --end;
+    return end > begin && text[end - 1] == '\\';
+}
+
+Rc<SourceFile> MinimizeSource(const SourceFile& source) {
+    const std::vector<char>& contents{ source.Contents };
+
+    size_t length{ 0 };
+    while (length < contents.size() && contents[length] != 0)
+        ++length;
+
+    std::vector<char> text{ };
+    StripComments(contents, length, text);
+
+    std::vector<char> minimized{ };
+    minimized.reserve(length / 4);
+
+    bool isInDirective{ false };
+    bool isInContinuedCode{ false };
+    size_t lineBegin{ 0 };
+
+    while (lineBegin < length) {
+        size_t lineEnd{ lineBegin };
+        while (lineEnd < length && text[lineEnd] != '\n')
+            ++lineEnd;
+
+        bool isContinued{ IsContinuedLine(text, lineBegin, lineEnd) };
+
+        if (!isInContinuedCode
+            && (isInDirective || IsDirectiveLine(text, lineBegin, lineEnd)))
+        {
+            minimized.insert(minimized.end(), text.begin() + lineBegin, text.begin() + lineEnd);
+            isInDirective = isContinued;
+        }
+        else {
+            isInContinuedCode = isContinued;
+        }
+
+        if (lineEnd < length)
+            minimized.push_back('\n');
+
+        lineBegin = lineEnd + 1;
+    }
+
+    minimized.push_back(0);
+
+    return NewObj<SourceFile>(source.Name, minimized);
+}
@@ -0,0 +1,18 @@
+#ifndef COMBUST_SOURCE_MINIMIZER_HH
+#define COMBUST_SOURCE_MINIMIZER_HH
+#include "common.hh"
+
+class SourceFile;
+
+/**
+ * Reduces a source file to its preprocessor directive lines, in the spirit
+ * of a dependency-directives scanner. Comments are replaced by spaces and
+ * every other line is emptied, so line and column numbers of the remaining
+ * directives match the original file.
+ *
+ * The result is meant to be fed to PreprocessorLexer when only directives
+ * matter, e.g. during dependency scanning.
+ */
+Rc<SourceFile> MinimizeSource(const SourceFile& source);
+
+#endif
@@ -1,5 +1,6 @@
 #define _CRT_SECURE_NO_WARNINGS
 #include "source.hh"
+#include "time-profiler.hh"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -11,25 +12,41 @@ SourceFile::SourceFile(
     Name{ name },
     Contents{ contents }
 {
+    lines.push_back(0);
+
     for (size_t i{ 0 }; i < contents.size(); ++i) {
         if (contents[i] == '\n') {
-            lines.push_back(i);
+            lines.push_back(i + 1);
         }
     }
 }
 
+SourceFile::SourceFile(
+    const std::string&       name,
+    const std::vector<char>& contents,
+    const std::vector<int>&  lineStarts
+) :
+    Name{ name },
+    Contents{ contents },
+    lines{ lineStarts }
+{ }
+
 SourceFile::~SourceFile() { }
 
 std::string SourceFile::GetLine(int line) const {
+    if (line < 0 || line >= static_cast<int>(lines.size()))
+        return std::string{ };
+
     int length{ 0 };
+    int size{ static_cast<int>(Contents.size()) };
 
-    for (int i{ lines[line] }; Contents[i] != '\n'; ++i)
+    for (int i{ lines[line] }; i < size && Contents[i] != '\n' && Contents[i] != 0; ++i)
         ++length;
 
     std::string lineContents{ };
     lineContents.reserve(length);
 
-    for (int i{ lines[line] }; Contents[i] != '\n'; ++i)
+    for (int i{ lines[line] }; i < lines[line] + length; ++i)
         lineContents += Contents[i];
 
     return lineContents;
@@ -51,9 +68,20 @@ Rc<SourceFile> CreateSourceFile(
 }
 
 Rc<SourceFile> OpenSourceFile(const std::string& path) {
+    std::vector<char> contents{ };
+    if (!ReadSourceContents(path, contents)) {
+        return Rc<SourceFile>{ };
+    }
+
+    return NewObj<SourceFile>(path, contents);
+}
+
+bool ReadSourceContents(const std::string& path, OUT std::vector<char>& contents) {
+    ScopedTimer timer{ TP_READ_SOURCE };
+
     FILE* file{ fopen(path.c_str(), "rb") };
     if (file == nullptr) {
-        return Rc<SourceFile>{ };
+        return false;
     }
 
     fseek(file, 0, SEEK_END);
@@ -67,8 +95,8 @@ Rc<SourceFile> OpenSourceFile(const std::string& path) {
 
     fclose(file);
 
-    std::vector<char> contents;
-    contents.reserve(length);
+    contents.clear();
+    contents.reserve(length + 3);
 
     for (int i{ 0 }; data[i] != 0; ++i) {
         contents.push_back(data[i]);
@@ -79,5 +107,5 @@ Rc<SourceFile> OpenSourceFile(const std::string& path) {
 
     delete[] data;
 
-    return NewObj<SourceFile>(path, contents);
+    return true;
 }
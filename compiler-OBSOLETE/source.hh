@@ -4,12 +4,27 @@
 #include <string>
 #include <vector>
 
-class SourceFile {
+/**
+ * Contents of a file and where its lines start. Mark a file shared before
+ * tokens or locations pointing into it reach another thread.
+ */
+class SourceFile : public Object {
 public:
     explicit SourceFile(const std::string& name, const std::vector<char>& contents);
+    /**
+     * Adopts a line index computed earlier for the same contents instead of
+     * scanning them for new-lines.
+     */
+    explicit SourceFile(
+        const std::string&       name,
+        const std::vector<char>& contents,
+        const std::vector<int>&  lineStarts
+    );
     virtual ~SourceFile();
 
     std::string GetLine(int line) const;
+    /** \return the offset of the first character of every line */
+    const std::vector<int>& GetLineStarts() const { return lines; }
 
     const std::string Name;
     const std::vector<char> Contents;
@@ -24,6 +39,13 @@ Rc<SourceFile> CreateSourceFile(
 );
 Rc<SourceFile> OpenSourceFile(const std::string& path);
 
+/**
+ * Reads a file the way OpenSourceFile does without building a SourceFile.
+ *
+ * \return false if the file cannot be opened
+ */
+bool ReadSourceContents(const std::string& path, OUT std::vector<char>& contents);
+
 struct SourceLoc {
     Rc<const SourceFile> Source{ };
     int                  Line{ 0 };
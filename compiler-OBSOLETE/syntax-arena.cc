@@ -0,0 +1,284 @@
+#include "syntax-arena.hh"
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+/** Size of a regular chunk; larger requests get a chunk of their own. */
+constexpr size_t SYNTAX_ARENA_CHUNK_SIZE{ 64 * 1024 };
+/** Size, and alignment, of a regular chunk backed by huge pages. */
+constexpr size_t SYNTAX_ARENA_HUGE_CHUNK_SIZE{ 2 * 1024 * 1024 };
+
+/** Blocks are rounded up to a power of two from 1 << this. */
+constexpr size_t SMALLEST_BLOCK_SHIFT{ 4 };
+constexpr size_t BLOCK_CLASS_COUNT{ 32 };
+
+struct ARENA_CHUNK {
+    char*  Memory;
+    size_t Size;
+    /** Mapped rather than from malloc. */
+    bool   IsMapped;
+};
+
+struct ARENA_DESTRUCTOR {
+    void*             Object;
+    void              (*Destroy)(void*);
+    ARENA_DESTRUCTOR* Next;
+};
+
+struct FREE_BLOCK {
+    FREE_BLOCK* Next;
+};
+
+struct SYNTAX_ARENA_IMPL {
+    SYNTAX_ARENA_BACKING        Backing{ SAB_HEAP };
+    size_t                      ChunkSize{ SYNTAX_ARENA_CHUNK_SIZE };
+
+    /** Regular chunks, kept by Reset; those past Current are unused. */
+    std::vector<ARENA_CHUNK>    Chunks{ };
+    size_t                      Current{ 0 };
+    /** Chunks of single oversized requests, given back by Reset. */
+    std::vector<ARENA_CHUNK>    OversizedChunks{ };
+    char*                       Cursor{ nullptr };
+    char*                       Limit{ nullptr };
+    size_t                      ReservedBytes{ 0 };
+
+    /** Most recently created object first. */
+    ARENA_DESTRUCTOR*           Destructors{ nullptr };
+
+    /** Nodes from outside the arena that its nodes point to. */
+    std::vector<Rc<SyntaxNode>> Adopted{ };
+
+    /** Freed blocks of each size class, to be handed out again. */
+    FREE_BLOCK*                 FreeBlocks[BLOCK_CLASS_COUNT]{ };
+};
+
+/**
+ * \return a chunk of at least size bytes; one of exactly the huge chunk
+ *         size is aligned to it and advised to use huge pages if asked for
+ */
+static ARENA_CHUNK ReserveChunk(size_t size, bool isHugePage) {
+#if defined(__linux__)
+    if (isHugePage && size == SYNTAX_ARENA_HUGE_CHUNK_SIZE) {
+        // Twice the size is mapped so that an aligned chunk fits in it, and
+        // what lies outside that chunk is unmapped again.
+        size_t mappedSize{ size * 2 };
+        void* mapping{ mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) };
+
+        if (mapping != MAP_FAILED) {
+            uintptr_t start{ reinterpret_cast<uintptr_t>(mapping) };
+            uintptr_t aligned{ (start + size - 1) & ~(uintptr_t{ size } - 1) };
+
+            if (aligned > start)
+                munmap(mapping, aligned - start);
+            if (aligned + size < start + mappedSize)
+                munmap(reinterpret_cast<void*>(aligned + size), start + mappedSize - aligned - size);
+
+#if defined(MADV_HUGEPAGE)
+            madvise(reinterpret_cast<void*>(aligned), size, MADV_HUGEPAGE);
+#endif
+            return ARENA_CHUNK{ reinterpret_cast<char*>(aligned), size, true };
+        }
+    }
+#else
+    (void)isHugePage;
+#endif
+
+    char* memory{ static_cast<char*>(malloc(size)) };
+    if (memory == nullptr)
+        throw std::bad_alloc{ };
+
+    return ARENA_CHUNK{ memory, size, false };
+}
+
+static void ReleaseChunk(const ARENA_CHUNK& chunk) {
+#if defined(__linux__)
+    if (chunk.IsMapped) {
+        munmap(chunk.Memory, chunk.Size);
+        return;
+    }
+#endif
+    free(chunk.Memory);
+}
+
+SyntaxArena::SyntaxArena(SYNTAX_ARENA_BACKING backing) :
+    a{ NewChild<SYNTAX_ARENA_IMPL>() }
+{
+    a->Backing = backing;
+    a->ChunkSize = backing == SAB_HUGE_PAGES ? SYNTAX_ARENA_HUGE_CHUNK_SIZE : SYNTAX_ARENA_CHUNK_SIZE;
+}
+
+SyntaxArena::~SyntaxArena() {
+    for (ARENA_DESTRUCTOR* entry{ a->Destructors }; entry != nullptr; entry = entry->Next)
+        entry->Destroy(entry->Object);
+
+    for (const ARENA_CHUNK& chunk : a->Chunks)
+        ReleaseChunk(chunk);
+    for (const ARENA_CHUNK& chunk : a->OversizedChunks)
+        ReleaseChunk(chunk);
+}
+
+static uintptr_t AlignUp(uintptr_t address, size_t alignment) {
+    return (address + alignment - 1) & ~(uintptr_t{ alignment } - 1);
+}
+
+void* SyntaxArena::Allocate(size_t size, size_t alignment) {
+    uintptr_t aligned{ AlignUp(reinterpret_cast<uintptr_t>(a->Cursor), alignment) };
+    if (a->Cursor != nullptr && aligned + size <= reinterpret_cast<uintptr_t>(a->Limit)) {
+        a->Cursor = reinterpret_cast<char*>(aligned + size);
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    // Requests too big to share a chunk get one of their own, leaving the
+    // current chunk in use.
+    if (size + alignment > a->ChunkSize / 4) {
+        ARENA_CHUNK chunk{ ReserveChunk(size + alignment, false) };
+        a->OversizedChunks.push_back(chunk);
+        a->ReservedBytes += chunk.Size;
+
+        return reinterpret_cast<void*>(AlignUp(reinterpret_cast<uintptr_t>(chunk.Memory), alignment));
+    }
+
+    // Chunks kept by a reset are used up before new ones are reserved.
+    if (a->Cursor != nullptr)
+        ++a->Current;
+
+    if (a->Current == a->Chunks.size()) {
+        a->Chunks.push_back(ReserveChunk(a->ChunkSize, a->Backing == SAB_HUGE_PAGES));
+        a->ReservedBytes += a->ChunkSize;
+    }
+
+    const ARENA_CHUNK& chunk{ a->Chunks[a->Current] };
+    aligned = AlignUp(reinterpret_cast<uintptr_t>(chunk.Memory), alignment);
+    a->Cursor = reinterpret_cast<char*>(aligned + size);
+    a->Limit = chunk.Memory + chunk.Size;
+
+    return reinterpret_cast<void*>(aligned);
+}
+
+void SyntaxArena::AddDestructor(void* object, void (*destroy)(void*)) {
+    void* storage{ Allocate(sizeof(ARENA_DESTRUCTOR), alignof(ARENA_DESTRUCTOR)) };
+    a->Destructors = new (storage) ARENA_DESTRUCTOR{ object, destroy, a->Destructors };
+}
+
+SyntaxNode** SyntaxArena::NewChildArray(size_t count) {
+    return static_cast<SyntaxNode**>(Allocate(count * sizeof(SyntaxNode*), alignof(SyntaxNode*)));
+}
+
+SyntaxNode* SyntaxArena::Adopt(const Rc<SyntaxNode>& node) {
+    if (node == nullptr)
+        return nullptr;
+
+    if (node->arena == this)
+        return node.get();
+
+    a->Adopted.push_back(node);
+    return node.get();
+}
+
+Rc<SyntaxNode> SyntaxArena::Share(SyntaxNode* node) {
+    if (node == nullptr)
+        return Rc<SyntaxNode>{ };
+
+    return Rc<SyntaxNode>{ node };
+}
+
+/**
+ * \return the size class of a block of size bytes
+ */
+static size_t GetBlockClass(size_t size) {
+    size_t blockClass{ 0 };
+    while ((size_t{ 1 } << (blockClass + SMALLEST_BLOCK_SHIFT)) < size)
+        ++blockClass;
+
+    return blockClass;
+}
+
+static size_t GetBlockClassSize(size_t blockClass) {
+    return size_t{ 1 } << (blockClass + SMALLEST_BLOCK_SHIFT);
+}
+
+void* SyntaxArena::AllocateBlock(size_t size) {
+    size_t blockClass{ GetBlockClass(size) };
+    size_t blockSize{ GetBlockClassSize(blockClass) };
+
+    // Blocks as big as a chunk would waste most of one; they come from the
+    // heap and go straight back to it.
+    if (blockSize > a->ChunkSize / 4) {
+        void* block{ malloc(size) };
+        if (block == nullptr)
+            throw std::bad_alloc{ };
+        return block;
+    }
+
+    if (FREE_BLOCK* block{ a->FreeBlocks[blockClass] }; block != nullptr) {
+        a->FreeBlocks[blockClass] = block->Next;
+        return block;
+    }
+
+    return Allocate(blockSize, alignof(max_align_t));
+}
+
+void SyntaxArena::FreeBlock(void* block, size_t size) {
+    if (block == nullptr)
+        return;
+
+    size_t blockClass{ GetBlockClass(size) };
+    if (GetBlockClassSize(blockClass) > a->ChunkSize / 4) {
+        free(block);
+        return;
+    }
+
+    a->FreeBlocks[blockClass] = new (block) FREE_BLOCK{ a->FreeBlocks[blockClass] };
+}
+
+bool SyntaxArena::Reset() {
+    if (GetReferenceCount() > 1)
+        return false;
+
+    for (ARENA_DESTRUCTOR* entry{ a->Destructors }; entry != nullptr; entry = entry->Next)
+        entry->Destroy(entry->Object);
+
+    a->Destructors = nullptr;
+    a->Adopted.clear();
+
+    for (FREE_BLOCK*& blocks : a->FreeBlocks)
+        blocks = nullptr;
+
+    for (const ARENA_CHUNK& chunk : a->OversizedChunks) {
+        a->ReservedBytes -= chunk.Size;
+        ReleaseChunk(chunk);
+    }
+    a->OversizedChunks.clear();
+
+    a->Current = 0;
+    if (a->Chunks.empty()) {
+        a->Cursor = nullptr;
+        a->Limit = nullptr;
+    }
+    else {
+        a->Cursor = a->Chunks[0].Memory;
+        a->Limit = a->Chunks[0].Memory + a->Chunks[0].Size;
+    }
+
+    return true;
+}
+
+SYNTAX_ARENA_BACKING SyntaxArena::GetBacking() const {
+    return a->Backing;
+}
+
+size_t SyntaxArena::GetReservedBytes() const {
+    return a->ReservedBytes;
+}
+
+Rc<SyntaxArena> AcquireThreadArena(SYNTAX_ARENA_BACKING backing) {
+    thread_local Rc<SyntaxArena> arena{ };
+
+    if (arena == nullptr || arena->GetBacking() != backing || !arena->Reset())
+        arena = NewObj<SyntaxArena>(backing);
+
+    return arena;
+}
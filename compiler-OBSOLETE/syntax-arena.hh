@@ -0,0 +1,159 @@
+#ifndef COMBUST_SYNTAX_ARENA_HH
+#define COMBUST_SYNTAX_ARENA_HH
+#include "common.hh"
+#include "syntax.hh"
+#include <stddef.h>
+#include <new>
+#include <type_traits>
+
+struct SYNTAX_ARENA_IMPL;
+
+enum SYNTAX_ARENA_BACKING {
+    /** Chunks of 64 KiB from malloc. */
+    SAB_HEAP,
+    /**
+     * Chunks of 2 MiB, aligned and advised to be backed by transparent huge
+     * pages where the system supports it, and from malloc elsewhere.
+     */
+    SAB_HUGE_PAGES
+};
+
+/**
+ * Bump allocator that owns the tokens and nodes of a translation unit.
+ * Nodes refer to their children by raw pointer, and an Rc to any node it
+ * created counts as a reference to the arena, so everything in it is
+ * released at once when the last Rc goes away, or by Reset.
+ *
+ * It also hands out blocks for growable containers, such as the parser's
+ * stack, from free lists per power-of-two size, so that containers freed
+ * by one parse are reused by the next.
+ *
+ * Create arenas with NewObj. One arena may hold every tree of a
+ * translation unit.
+ */
+class SyntaxArena : public Object {
+public:
+    explicit SyntaxArena(SYNTAX_ARENA_BACKING backing = SAB_HEAP);
+    virtual ~SyntaxArena();
+
+    /**
+     * \return a new token or expression owned by the arena
+     */
+    template<typename T>
+    [[nodiscard]] Rc<T> New() {
+        static_assert(std::is_base_of<SyntaxNode, T>::value, "the arena only holds syntax nodes");
+
+        T* node{ new (Allocate(sizeof(T), alignof(T))) T() };
+        AddDestructor(node, [](void* object) { static_cast<T*>(object)->~T(); });
+        node->arena = this;
+        node->AliasReferences();
+
+        return Rc<T>{ node };
+    }
+
+    /**
+     * \return uninitialized storage for count child pointers
+     */
+    SyntaxNode** NewChildArray(size_t count);
+
+    /**
+     * Keeps a node that was not created by this arena, such as a token from
+     * a lexer without one, alive for as long as the arena.
+     *
+     * \return node as a raw pointer
+     */
+    SyntaxNode* Adopt(const Rc<SyntaxNode>& node);
+
+    /**
+     * \return an Rc to a node created or adopted by this arena; one to an
+     *         adopted node keeps only that node alive
+     */
+    Rc<SyntaxNode> Share(SyntaxNode* node);
+
+    /**
+     * \return uninitialized storage of at least size bytes, aligned for any
+     *         type, to be given back with FreeBlock
+     */
+    void* AllocateBlock(size_t size);
+
+    /**
+     * Makes a block from AllocateBlock, of the size it was asked for with,
+     * available to later requests of about the same size. Every block must
+     * be freed before the arena is reset or destroyed.
+     */
+    void FreeBlock(void* block, size_t size);
+
+    /**
+     * Destroys everything in the arena and rewinds it to its first chunk,
+     * keeping the memory reserved for the next translation unit. Chunks of
+     * oversized allocations are given back.
+     *
+     * \return false, changing nothing, if anything besides the caller's
+     *         Rc still refers to the arena or its nodes
+     */
+    bool Reset();
+
+    SYNTAX_ARENA_BACKING GetBacking() const;
+
+    /**
+     * \return the number of bytes reserved from the system so far
+     */
+    size_t GetReservedBytes() const;
+
+private:
+    void* Allocate(size_t size, size_t alignment);
+    void AddDestructor(void* object, void (*destroy)(void*));
+
+    Owner<SYNTAX_ARENA_IMPL> a;
+};
+
+/**
+ * \return the calling thread's arena, reset for a new translation unit; a
+ *         new one replaces it if it is still in use or was made with other
+ *         backing. Threads of a parallel run each reuse their own arena
+ *         from one file to the next.
+ */
+Rc<SyntaxArena> AcquireThreadArena(SYNTAX_ARENA_BACKING backing = SAB_HEAP);
+
+/**
+ * \return a new token in arena, or on the heap if arena is null
+ */
+template<typename T>
+[[nodiscard]] Rc<T> NewToken(const Rc<SyntaxArena>& arena) {
+    return arena ? arena->New<T>() : NewObj<T>();
+}
+
+/**
+ * Allocator for standard containers that takes its memory from an arena's
+ * size-class free lists. The arena must outlive the container.
+ */
+template<typename Ty>
+class ArenaAllocator {
+public:
+    using value_type = Ty;
+
+    explicit ArenaAllocator(SyntaxArena* arena) : arena{ arena } {}
+
+    template<typename Other>
+    ArenaAllocator(const ArenaAllocator<Other>& other) : arena{ other.GetArena() } {}
+
+    Ty* allocate(size_t count) {
+        return static_cast<Ty*>(arena->AllocateBlock(count * sizeof(Ty)));
+    }
+
+    void deallocate(Ty* pointer, size_t count) {
+        arena->FreeBlock(pointer, count * sizeof(Ty));
+    }
+
+    SyntaxArena* GetArena() const { return arena; }
+
+    template<typename Other>
+    bool operator==(const ArenaAllocator<Other>& other) const { return arena == other.GetArena(); }
+    template<typename Other>
+    bool operator!=(const ArenaAllocator<Other>& other) const { return arena != other.GetArena(); }
+
+private:
+    SyntaxArena* arena;
+};
+
+#endif
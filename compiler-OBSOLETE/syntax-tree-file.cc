@@ -0,0 +1,292 @@
+#include "syntax-tree-file.hh"
+#include "binary-format.hh"
+#include "mapped-file.hh"
+#include <string.h>
+#include <vector>
+
+/** Bump whenever the layout of a file changes. */
+constexpr uint32_t SYNTAX_TREE_FILE_VERSION{ 1 };
+
+constexpr char SYNTAX_TREE_FILE_MAGIC[8]{ 'C', 'M', 'B', 'T', 'R', 'E', 'E', 0 };
+
+/**
+ * A file is the header followed by, in order: a uint16_t kind per node,
+ * the nodes' child counts as varints, the token records, the operands
+ * (string indices) they refer to, the string table and the string data.
+ * Every field is stored in host byte order.
+ */
+struct SYNTAX_TREE_FILE_HEADER {
+    char     Magic[8];
+    uint32_t Version;
+    uint32_t RecordSize;
+    uint64_t SchemaHash;
+    uint32_t NodeCount;
+    uint32_t ChildCountSize;
+    uint32_t TokenCount;
+    uint32_t OperandCount;
+    uint32_t StringCount;
+    uint32_t Reserved;
+    uint64_t StringDataSize;
+    uint64_t PayloadHash;
+};
+
+struct SYNTAX_TREE_FILE_IMPL {
+    Rc<MappedFile>           File{ };
+    uint32_t                 NodeCount{ 0 };
+    uint32_t                 TokenCount{ 0 };
+
+    /** Point into File. */
+    const char*              Kinds{ nullptr };
+    const char*              Records{ nullptr };
+
+    /** Decoded from the varints when the file is opened. */
+    std::vector<uint32_t>    ChildCounts{ };
+    std::vector<uint32_t>    SubtreeEnds{ };
+    std::vector<uint32_t>    TokenIndices{ };
+
+    std::vector<uint32_t>    Operands{ };
+    std::vector<std::string> Strings{ };
+};
+
+SyntaxTreeFile::SyntaxTreeFile() :
+    f{ NewChild<SYNTAX_TREE_FILE_IMPL>() }
+{ }
+
+SyntaxTreeFile::~SyntaxTreeFile() { }
+
+bool WriteSyntaxTreeFile(const std::string& path, const FlatSyntaxTree& tree) {
+    std::string kinds{ };
+    std::string childCounts{ };
+
+    for (uint32_t i{ 0 }; i < tree.GetNodeCount(); ++i) {
+        uint16_t kind{ static_cast<uint16_t>(tree.Kinds[i]) };
+        AppendBytes(kinds, &kind, sizeof(kind));
+        AppendVarint(childCounts, tree.ChildCounts[i]);
+    }
+
+    std::vector<TOKEN_RECORD> records{ };
+    std::vector<uint32_t>     operands{ };
+    StringTableBuilder        strings{ };
+
+    records.reserve(tree.Tokens.size());
+
+    for (const Rc<SyntaxToken>& token : tree.Tokens)
+        records.push_back(EncodeToken(token, strings, operands));
+
+    std::string payload{ kinds + childCounts };
+    AppendBytes(payload, records.data(), records.size() * sizeof(TOKEN_RECORD));
+    AppendBytes(payload, operands.data(), operands.size() * sizeof(uint32_t));
+    AppendBytes(payload, strings.Strings.data(), strings.Strings.size() * sizeof(STRING_RECORD));
+    payload += strings.Data;
+
+    SYNTAX_TREE_FILE_HEADER header{ };
+    memcpy(header.Magic, SYNTAX_TREE_FILE_MAGIC, sizeof(header.Magic));
+    header.Version        = SYNTAX_TREE_FILE_VERSION;
+    header.RecordSize     = sizeof(TOKEN_RECORD);
+    header.SchemaHash     = GetSyntaxSchemaHash();
+    header.NodeCount      = tree.GetNodeCount();
+    header.ChildCountSize = static_cast<uint32_t>(childCounts.size());
+    header.TokenCount     = static_cast<uint32_t>(records.size());
+    header.OperandCount   = static_cast<uint32_t>(operands.size());
+    header.StringCount    = static_cast<uint32_t>(strings.Strings.size());
+    header.StringDataSize = strings.Data.size();
+    header.PayloadHash    = HashBytes(payload.data(), payload.size());
+
+    std::string contents{ };
+    AppendBytes(contents, &header, sizeof(header));
+    contents += payload;
+
+    return ReplaceFile(path, contents);
+}
+
+/**
+ * Decodes the child counts and checks that they describe one tree whose
+ * tokens are leaves, in the same order as the token records.
+ */
+static bool ReadStructure(
+    SYNTAX_TREE_FILE_IMPL* f,
+    const char*            childCounts,
+    const char*            childCountsEnd
+) {
+    f->ChildCounts.resize(f->NodeCount);
+    f->TokenIndices.resize(f->NodeCount);
+
+    // A preorder sequence is one whole tree if, counting the root as one
+    // open slot, every node fills a slot and the slots run out exactly at
+    // the last node.
+    uint64_t openSlots{ 1 };
+    uint32_t tokenCount{ 0 };
+
+    for (uint32_t i{ 0 }; i < f->NodeCount; ++i) {
+        uint16_t kind{ };
+        memcpy(&kind, f->Kinds + i * sizeof(kind), sizeof(kind));
+
+        uint32_t childCount{ };
+        if (kind >= SK_COUNT || openSlots == 0 || !ReadVarint(childCounts, childCountsEnd, childCount))
+            return false;
+
+        if (IsSyntaxTokenKind(static_cast<SYNTAX_KIND>(kind))) {
+            TOKEN_RECORD record{ };
+            if (childCount != 0 || tokenCount == f->TokenCount)
+                return false;
+
+            memcpy(&record, f->Records + tokenCount * sizeof(TOKEN_RECORD), sizeof(record));
+            if (record.Kind != kind)
+                return false;
+
+            f->TokenIndices[i] = tokenCount++;
+        }
+        else {
+            f->TokenIndices[i] = FlatSyntaxTree::NONE;
+        }
+
+        f->ChildCounts[i] = childCount;
+        openSlots = openSlots - 1 + childCount;
+    }
+
+    if (childCounts != childCountsEnd || tokenCount != f->TokenCount)
+        return false;
+    if (f->NodeCount != 0 && openSlots != 0)
+        return false;
+
+    f->SubtreeEnds.resize(f->NodeCount);
+
+    for (uint32_t i{ f->NodeCount }; i-- > 0; ) {
+        uint32_t end{ i + 1 };
+        for (uint32_t child{ 0 }; child < f->ChildCounts[i]; ++child)
+            end = f->SubtreeEnds[end];
+
+        f->SubtreeEnds[i] = end;
+    }
+
+    return true;
+}
+
+bool SyntaxTreeFile::Open(const std::string& path) {
+    f->File = OpenMappedFile(path);
+    if (f->File == nullptr || f->File->GetSize() < sizeof(SYNTAX_TREE_FILE_HEADER))
+        return false;
+
+    SYNTAX_TREE_FILE_HEADER header{ };
+    memcpy(&header, f->File->GetData(), sizeof(header));
+
+    if (memcmp(header.Magic, SYNTAX_TREE_FILE_MAGIC, sizeof(header.Magic)) != 0
+        || header.Version != SYNTAX_TREE_FILE_VERSION
+        || header.RecordSize != sizeof(TOKEN_RECORD)
+        || header.SchemaHash != GetSyntaxSchemaHash())
+        return false;
+
+    uint64_t kindsSize{ uint64_t{ header.NodeCount } * sizeof(uint16_t) };
+    uint64_t recordsSize{ uint64_t{ header.TokenCount } * sizeof(TOKEN_RECORD) };
+    uint64_t operandsSize{ uint64_t{ header.OperandCount } * sizeof(uint32_t) };
+    uint64_t stringsSize{ uint64_t{ header.StringCount } * sizeof(STRING_RECORD) };
+    uint64_t payloadSize{ f->File->GetSize() - sizeof(SYNTAX_TREE_FILE_HEADER) };
+
+    if (header.StringDataSize > payloadSize
+        || kindsSize + header.ChildCountSize + recordsSize + operandsSize + stringsSize
+               + header.StringDataSize != payloadSize)
+        return false;
+
+    const char* payload{ f->File->GetData() + sizeof(SYNTAX_TREE_FILE_HEADER) };
+    if (HashBytes(payload, payloadSize) != header.PayloadHash)
+        return false;
+
+    const char* kindData{ payload };
+    const char* childCountData{ kindData + kindsSize };
+    const char* recordData{ childCountData + header.ChildCountSize };
+    const char* operandData{ recordData + recordsSize };
+    const char* stringData{ operandData + operandsSize };
+    const char* characterData{ stringData + stringsSize };
+
+    if (!ReadStringTable(stringData, header.StringCount, characterData, header.StringDataSize, f->Strings))
+        return false;
+
+    f->Operands.resize(header.OperandCount);
+    if (!f->Operands.empty())
+        memcpy(f->Operands.data(), operandData, operandsSize);
+    for (uint32_t operand : f->Operands) {
+        if (operand >= header.StringCount)
+            return false;
+    }
+
+    for (uint32_t i{ 0 }; i < header.TokenCount; ++i) {
+        TOKEN_RECORD record{ };
+        memcpy(&record, recordData + i * sizeof(TOKEN_RECORD), sizeof(record));
+
+        if (!IsValidTokenRecord(record, header.OperandCount))
+            return false;
+    }
+
+    f->NodeCount = header.NodeCount;
+    f->TokenCount = header.TokenCount;
+    f->Kinds = kindData;
+    f->Records = recordData;
+
+    return ReadStructure(f.get(), childCountData, recordData);
+}
+
+uint32_t SyntaxTreeFile::GetNodeCount() const {
+    return f->NodeCount;
+}
+
+uint32_t SyntaxTreeFile::GetTokenCount() const {
+    return f->TokenCount;
+}
+
+SYNTAX_KIND SyntaxTreeFile::GetKind(uint32_t node) const {
+    uint16_t kind{ };
+    memcpy(&kind, f->Kinds + node * sizeof(kind), sizeof(kind));
+    return static_cast<SYNTAX_KIND>(kind);
+}
+
+uint32_t SyntaxTreeFile::GetChildCount(uint32_t node) const {
+    return f->ChildCounts[node];
+}
+
+uint32_t SyntaxTreeFile::GetFirstChild(uint32_t node) const {
+    return f->ChildCounts[node] != 0 ? node + 1 : FlatSyntaxTree::NONE;
+}
+
+uint32_t SyntaxTreeFile::GetSubtreeEnd(uint32_t node) const {
+    return f->SubtreeEnds[node];
+}
+
+uint32_t SyntaxTreeFile::GetTokenIndex(uint32_t node) const {
+    return f->TokenIndices[node];
+}
+
+Rc<SyntaxToken> SyntaxTreeFile::GetToken(uint32_t index) const {
+    TOKEN_RECORD record{ };
+    memcpy(&record, f->Records + index * sizeof(TOKEN_RECORD), sizeof(record));
+
+    return DecodeToken(record, f->Operands.data(), f->Strings);
+}
+
+FlatSyntaxTree SyntaxTreeFile::ToFlatSyntaxTree() const {
+    FlatSyntaxTree tree{ };
+    tree.Kinds.reserve(f->NodeCount);
+    tree.FirstChildren.reserve(f->NodeCount);
+
+    for (uint32_t i{ 0 }; i < f->NodeCount; ++i) {
+        tree.Kinds.push_back(GetKind(i));
+        tree.FirstChildren.push_back(GetFirstChild(i));
+    }
+
+    tree.ChildCounts = f->ChildCounts;
+    tree.SubtreeEnds = f->SubtreeEnds;
+    tree.TokenIndices = f->TokenIndices;
+
+    tree.Tokens.reserve(f->TokenCount);
+    for (uint32_t i{ 0 }; i < f->TokenCount; ++i)
+        tree.Tokens.push_back(GetToken(i));
+
+    return tree;
+}
+
+Rc<SyntaxTreeFile> OpenSyntaxTreeFile(const std::string& path) {
+    Rc<SyntaxTreeFile> file{ NewObj<SyntaxTreeFile>() };
+    if (!file->Open(path))
+        return Rc<SyntaxTreeFile>{ };
+
+    return file;
+}
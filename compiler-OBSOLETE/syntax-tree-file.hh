@@ -0,0 +1,72 @@
+#ifndef COMBUST_SYNTAX_TREE_FILE_HH
+#define COMBUST_SYNTAX_TREE_FILE_HH
+#include "common.hh"
+#include "flat-syntax-tree.hh"
+#include "syntax.hh"
+#include <stdint.h>
+#include <string>
+
+struct SYNTAX_TREE_FILE_IMPL;
+
+/**
+ * Parsed tree saved by WriteSyntaxTreeFile, mapped back in read-only.
+ * Nodes are numbered in preorder, as in FlatSyntaxTree. Kinds are read
+ * from the mapping in place and tokens are decoded only when asked for, so
+ * opening a file costs one pass over its child counts, and processes with
+ * the same file open share its pages.
+ *
+ * Files carry a format version and the syntax kind layout they were
+ * written with; Open rejects a file that does not match in every respect.
+ */
+class SyntaxTreeFile : public Object {
+public:
+    explicit SyntaxTreeFile();
+    virtual ~SyntaxTreeFile();
+
+    /**
+     * \return false if the file cannot be mapped or does not hold a valid
+     *         tree
+     */
+    bool Open(const std::string& path);
+
+    uint32_t GetNodeCount() const;
+    uint32_t GetTokenCount() const;
+
+    SYNTAX_KIND GetKind(uint32_t node) const;
+    uint32_t GetChildCount(uint32_t node) const;
+    /** FlatSyntaxTree::NONE for nodes without children. */
+    uint32_t GetFirstChild(uint32_t node) const;
+    /** Index one past the node's subtree, i.e. its next sibling if any. */
+    uint32_t GetSubtreeEnd(uint32_t node) const;
+    /** Index for GetToken, FlatSyntaxTree::NONE for expressions. */
+    uint32_t GetTokenIndex(uint32_t node) const;
+
+    /**
+     * \return a new copy of the token; its lexeme range has a line and
+     *         column but no Source
+     */
+    Rc<SyntaxToken> GetToken(uint32_t index) const;
+
+    /**
+     * \return the whole tree, with every token decoded
+     */
+    FlatSyntaxTree ToFlatSyntaxTree() const;
+
+private:
+    Owner<SYNTAX_TREE_FILE_IMPL> f;
+};
+
+/**
+ * Writes tree as: the node kinds, the child counts as varints, then the
+ * tokens as records with their strings in a table.
+ *
+ * \return false if the file cannot be written
+ */
+bool WriteSyntaxTreeFile(const std::string& path, const FlatSyntaxTree& tree);
+
+/**
+ * \return the opened file, or nullptr if it cannot be opened
+ */
+Rc<SyntaxTreeFile> OpenSyntaxTreeFile(const std::string& path);
+
+#endif
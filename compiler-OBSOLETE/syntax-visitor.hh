@@ -0,0 +1,94 @@
+#ifndef COMBUST_SYNTAX_VISITOR_HH
+#define COMBUST_SYNTAX_VISITOR_HH
+#include "common.hh"
+#include "syntax.hh"
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Visitor that returns R by value and dispatches with a switch over the
+ * node's kind instead of a virtual call, so handlers can be inlined.
+ *
+ * Derive as class V : public StaticSyntaxVisitor<V, R> and define
+ * R Visit<Class>(Class& node) for the classes of interest, e.g.
+ * VisitPrimaryExpression. Every other class goes to VisitDefault, which
+ * returns R() unless the derived class defines its own.
+ */
+template<typename Derived, typename R>
+class StaticSyntaxVisitor {
+public:
+    R Visit(SyntaxNode& node) {
+        switch (node.GetKind()) {
+#define O(className)     \
+        case SK_##className: \
+            return GetDerived().Visit##className(static_cast<className&>(node))
+#define Sn(className) O(className)
+#define Tk(className) O(className)
+#include "syntax-kinds.def"
+#undef Tk
+#undef Sn
+#undef O
+        default:
+            return GetDerived().VisitDefault(node);
+        }
+    }
+
+    R VisitDefault(SyntaxNode& node) {
+        (void) node;
+        return R();
+    }
+
+#define O(className)                              \
+    R Visit##className(className& node) {         \
+        return GetDerived().VisitDefault(node);   \
+    }
+#define Sn(className) O(className)
+#define Tk(className) O(className)
+#include "syntax-kinds.def"
+#undef Tk
+#undef Sn
+#undef O
+
+private:
+    Derived& GetDerived() { return static_cast<Derived&>(*this); }
+};
+
+/**
+ * Calls enter(node) on every node under root, parents first, and
+ * leave(node) once everything under a node has been left. Null children
+ * are skipped. The nodes being walked are kept on the heap, so any depth
+ * of tree can be walked.
+ */
+template<typename Enter, typename Leave>
+void WalkSyntaxTree(SyntaxNode& root, Enter&& enter, Leave&& leave) {
+    struct PENDING {
+        SyntaxNode* Node;
+        uint32_t    NextChild;
+    };
+
+    std::vector<PENDING> pending{ { &root, 0 } };
+    enter(root);
+
+    while (!pending.empty()) {
+        PENDING& top{ pending.back() };
+        SyntaxNode* child{ nullptr };
+
+        if (!IsSyntaxTokenKind(top.Node->GetKind())) {
+            const Expression& expression{ static_cast<const Expression&>(*top.Node) };
+            while (child == nullptr && top.NextChild < expression.GetChildCount())
+                child = expression.GetChildNode(static_cast<int>(top.NextChild++));
+        }
+
+        if (child != nullptr) {
+            enter(*child);
+            pending.push_back(PENDING{ child, 0 });
+        }
+        else {
+            SyntaxNode* node{ top.Node };
+            pending.pop_back();
+            leave(*node);
+        }
+    }
+}
+
+#endif
@@ -1,4 +1,7 @@
 #include "syntax.hh"
+#include "syntax-arena.hh"
+#include "logger.hh"
+#include <stdlib.h>
 
 #define O(className)          \
     className::className() {} \
@@ -11,6 +14,9 @@
 #undef O
 
 #define O(className)                                          \
+    SYNTAX_KIND className::GetKind() const {                   \
+        return SK_##className;                                 \
+    }                                                          \
     Rc<Object> className::Accept(SyntaxNodeVisitor& visitor) { \
         return visitor.Visit(*this);                           \
     }                                                          \
@@ -22,166 +28,199 @@
 #undef Sn
 #undef O
 
-bool PrimaryExpression::IsIdentifier() const {
-    return children.size() == 1 && IsSyntaxNode<IdentifierToken>(children[0]);
-}
-bool PrimaryExpression::IsNumericLiteral() const {
-    return children.size() == 1 && IsSyntaxNode<NumericLiteralToken>(children[0]);
-}
-bool PrimaryExpression::IsStringLiteral() const {
-    return children.size() == 1 && IsSyntaxNode<StringLiteralToken>(children[0]);
-}
-bool PrimaryExpression::IsParenthesizedExpression() const {
-    return children.size() == 3
-        && IsSyntaxNode<LParenSymbol>(children[0])
-        && IsBaseOfSyntaxNode<Expression>(children[1])
-        && IsSyntaxNode<RParenSymbol>(children[2]);
-}
-bool PrimaryExpression::IsValid() const {
-    return IsIdentifier()
-        || IsNumericLiteral()
-        || IsStringLiteral()
-        || IsParenthesizedExpression();
+template<typename T>
+static Rc<SyntaxToken> NewSyntaxTokenOfType() {
+    if constexpr (std::is_base_of<SyntaxToken, T>::value)
+        return NewObj<T>();
+    else
+        return Rc<SyntaxToken>{ };
 }
 
-bool PostfixExpression::IsPassthrough() const {
-    return children.size() == 1 && IsSyntaxNode<PrimaryExpression>(children[0]);
-}
-bool PostfixExpression::IsArrayAccessor() const {
-    return children.size() == 4
-        && (IsSyntaxNode<PrimaryExpression>(children[0])
-            || IsSyntaxNode<PostfixExpression>(children[0]))
-        && IsSyntaxNode<LBracketSymbol>(children[1])
-        && IsBaseOfSyntaxNode<Expression>(children[2])
-        && IsSyntaxNode<RBracketSymbol>(children[3]);
-}
-bool PostfixExpression::IsFunctionCall() const {
-    return false;
-}
-bool PostfixExpression::IsStructureReference() const {
-    return children.size() == 3
-        && (IsSyntaxNode<PrimaryExpression>(children[0])
-            || IsSyntaxNode<PostfixExpression>(children[0]))
-        && IsSyntaxNode<DotSymbol>(children[1])
-        && IsSyntaxNode<IdentifierToken>(children[2]);
-}
-bool PostfixExpression::IsStructureDereference() const {
-    return children.size() == 3
-        && (IsSyntaxNode<PrimaryExpression>(children[0])
-            || IsSyntaxNode<PostfixExpression>(children[0]))
-        && IsSyntaxNode<MinusGtSymbol>(children[1])
-        && IsSyntaxNode<IdentifierToken>(children[2]);
-}
-bool PostfixExpression::IsPostIncrement() const {
-    return children.size() == 2
-        && (IsSyntaxNode<PrimaryExpression>(children[0])
-            || IsSyntaxNode<PostfixExpression>(children[0]))
-        && IsSyntaxNode<PlusPlusSymbol>(children[1]);
-}
-bool PostfixExpression::IsPostDecrement() const {
-    return children.size() == 2
-        && (IsSyntaxNode<PrimaryExpression>(children[0])
-            || IsSyntaxNode<PostfixExpression>(children[0]))
-        && IsSyntaxNode<MinusMinusSymbol>(children[1]);
+Rc<SyntaxToken> NewSyntaxToken(SYNTAX_KIND kind) {
+    switch (kind) {
+#define O(className)  \
+    case SK_##className: \
+        return NewSyntaxTokenOfType<className>()
+#define Sn(className) O(className)
+#define Tk(className) O(className)
+#include "syntax-kinds.def"
+#undef Tk
+#undef Sn
+#undef O
+    default:
+        return Rc<SyntaxToken>{ };
+    }
 }
-bool PostfixExpression::IsValid() const {
-    return IsPassthrough()
-        || IsArrayAccessor()
-        || IsFunctionCall()
-        || IsStructureReference()
-        || IsStructureDereference()
-        || IsPostIncrement()
-        || IsPostDecrement();
+
+bool IsSyntaxTokenKind(SYNTAX_KIND kind) {
+    switch (kind) {
+#define O(className)  \
+    case SK_##className: \
+        return std::is_base_of<SyntaxToken, className>::value
+#define Sn(className) O(className)
+#define Tk(className) O(className)
+#include "syntax-kinds.def"
+#undef Tk
+#undef Sn
+#undef O
+    default:
+        return false;
+    }
 }
 
-bool UnaryExpression::IsPassthrough() const {
-    return children.size() == 1
-        && (IsSyntaxNode<PrimaryExpression>(children[0])
-            || IsSyntaxNode<PostfixExpression>(children[0])
-            || IsSyntaxNode<UnaryExpression>(children[0]));
+const RefCounted* SyntaxNode::GetReferenceOwner() const {
+    if (arena == nullptr)
+        return this;
+
+    return arena;
 }
-bool UnaryExpression::IsPreIncrement() const {
-    return children.size() == 2
-        && IsSyntaxNode<PlusPlusSymbol>(children[0])
-        && (IsSyntaxNode<PrimaryExpression>(children[1])
-            || IsSyntaxNode<PostfixExpression>(children[1])
-            || IsSyntaxNode<UnaryExpression>(children[1]));
+
+Rc<SyntaxNode> Expression::GetChild(const int index) const {
+    return GetArena()->Share(children[index]);
 }
-bool UnaryExpression::IsPreDecrement() const {
-    return children.size() == 2
-        && IsSyntaxNode<MinusMinusSymbol>(children[0])
-        && (IsSyntaxNode<PrimaryExpression>(children[1])
-            || IsSyntaxNode<PostfixExpression>(children[1])
-            || IsSyntaxNode<UnaryExpression>(children[1]));
+
+void Expression::SetChildren(
+    SYNTAX_PRODUCTION                     production,
+    std::initializer_list<Rc<SyntaxNode>> to
+) {
+    SyntaxArena* arena{ GetArena() };
+    children = arena->NewChildArray(to.size());
+    childCount = static_cast<uint32_t>(to.size());
+    this->production = production;
+
+    SyntaxNode** child{ children };
+    for (const Rc<SyntaxNode>& node : to)
+        *child++ = arena->Adopt(node);
+
+#if !defined(NDEBUG)
+    if (SYNTAX_PRODUCTION shape{ DeriveSyntaxProduction(*this) }; shape != production) {
+        Log(DK_PRODUCTION_MISMATCH, GetKind(), production, shape);
+        abort();
+    }
+#endif
 }
-bool UnaryExpression::IsAddressOf() const {
-    return children.size() == 2
-        && IsSyntaxNode<AmpersandSymbol>(children[0])
-        && (IsSyntaxNode<PrimaryExpression>(children[1])
-            || IsSyntaxNode<PostfixExpression>(children[1])
-            || IsSyntaxNode<UnaryExpression>(children[1]));
+
+template<typename T>
+static bool IsNode(const SyntaxNode* node) {
+    return node != nullptr && IsSyntaxNode<T>(node);
 }
-bool UnaryExpression::IsPointerDereference() const {
-    return children.size() == 2
-        && IsSyntaxNode<AsteriskSymbol>(children[0])
-        && (IsSyntaxNode<PrimaryExpression>(children[1])
-            || IsSyntaxNode<PostfixExpression>(children[1])
-            || IsSyntaxNode<UnaryExpression>(children[1]));
+
+static bool IsOperand(const SyntaxNode* node) {
+    return node != nullptr && !IsSyntaxTokenKind(node->GetKind());
 }
-bool UnaryExpression::IsPositive() const {
-    return children.size() == 2
-        && IsSyntaxNode<PlusPlusSymbol>(children[0])
-        && (IsSyntaxNode<PrimaryExpression>(children[1])
-            || IsSyntaxNode<PostfixExpression>(children[1])
-            || IsSyntaxNode<UnaryExpression>(children[1]));
+
+static bool IsPostfixOperand(const SyntaxNode* node) {
+    return IsNode<PrimaryExpression>(node) || IsNode<PostfixExpression>(node);
 }
-bool UnaryExpression::IsNegative() const {
-    return children.size() == 2
-        && IsSyntaxNode<MinusMinusSymbol>(children[0])
-        && (IsSyntaxNode<PrimaryExpression>(children[1])
-            || IsSyntaxNode<PostfixExpression>(children[1])
-            || IsSyntaxNode<UnaryExpression>(children[1]));
+
+static bool IsUnaryOperand(const SyntaxNode* node) {
+    return IsPostfixOperand(node) || IsNode<UnaryExpression>(node);
 }
-bool UnaryExpression::IsBitwiseComplement() const {
-    return children.size() == 2
-        && IsSyntaxNode<TildeSymbol>(children[0])
-        && (IsSyntaxNode<PrimaryExpression>(children[1])
-            || IsSyntaxNode<PostfixExpression>(children[1])
-            || IsSyntaxNode<UnaryExpression>(children[1]));
+
+static SYNTAX_PRODUCTION DeriveBinaryProduction(SYNTAX_KIND expressionKind, SYNTAX_KIND symbolKind) {
+#define Op(symbolClass, expressionClass, production, precedence, associativity) \
+    if (expressionKind == SK_##expressionClass && symbolKind == SK_##symbolClass) \
+        return production
+#define Sn(className)
+#define Tk(className)
+#include "syntax-kinds.def"
+#undef Tk
+#undef Sn
+#undef Op
+    return SP_INVALID;
 }
-bool UnaryExpression::IsLogicalNot() const {
-    return children.size() == 2
-        && IsSyntaxNode<ExclamationSymbol>(children[0])
-        && (IsSyntaxNode<PrimaryExpression>(children[1])
-            || IsSyntaxNode<PostfixExpression>(children[1])
-            || IsSyntaxNode<UnaryExpression>(children[1]));
+
+static SYNTAX_PRODUCTION DerivePrimaryProduction(SyntaxNode* const* c, size_t count) {
+    if (count == 1 && IsNode<IdentifierToken>(c[0]))
+        return SP_IDENTIFIER;
+    if (count == 1 && IsNode<NumericLiteralToken>(c[0]))
+        return SP_NUMERIC_LITERAL;
+    if (count == 1 && IsNode<StringLiteralToken>(c[0]))
+        return SP_STRING_LITERAL;
+    if (count == 3
+        && IsNode<LParenSymbol>(c[0])
+        && IsOperand(c[1])
+        && IsNode<RParenSymbol>(c[2]))
+        return SP_PARENTHESIZED_EXPRESSION;
+    return SP_INVALID;
 }
-bool UnaryExpression::IsSizeOf() const {
-    return children.size() == 2
-        && IsSyntaxNode<SizeOfKeyword>(children[0])
-        && (IsSyntaxNode<PrimaryExpression>(children[1])
-            || IsSyntaxNode<PostfixExpression>(children[1])
-            || IsSyntaxNode<UnaryExpression>(children[1]));
+
+static SYNTAX_PRODUCTION DerivePostfixProduction(SyntaxNode* const* c, size_t count) {
+    if (count == 1 && IsNode<PrimaryExpression>(c[0]))
+        return SP_PASSTHROUGH;
+    if (count == 0 || !IsPostfixOperand(c[0]))
+        return SP_INVALID;
+
+    if (count == 4
+        && IsNode<LBracketSymbol>(c[1])
+        && IsOperand(c[2])
+        && IsNode<RBracketSymbol>(c[3]))
+        return SP_ARRAY_ACCESSOR;
+    if (count == 3 && IsNode<DotSymbol>(c[1]) && IsNode<IdentifierToken>(c[2]))
+        return SP_STRUCTURE_REFERENCE;
+    if (count == 3 && IsNode<MinusGtSymbol>(c[1]) && IsNode<IdentifierToken>(c[2]))
+        return SP_STRUCTURE_DEREFERENCE;
+    if (count == 2 && IsNode<PlusPlusSymbol>(c[1]))
+        return SP_POST_INCREMENT;
+    if (count == 2 && IsNode<MinusMinusSymbol>(c[1]))
+        return SP_POST_DECREMENT;
+    return SP_INVALID;
 }
-bool UnaryExpression::IsParenthesizedSizeOf() const {
-    return children.size() == 4
-        && IsSyntaxNode<SizeOfKeyword>(children[0])
-        && IsSyntaxNode<LParenSymbol>(children[1])
-        && (IsSyntaxNode<PrimaryExpression>(children[2])
-            || IsSyntaxNode<PostfixExpression>(children[2])
-            || IsSyntaxNode<UnaryExpression>(children[2]))
-        && IsSyntaxNode<RParenSymbol>(children[3]);
+
+static SYNTAX_PRODUCTION DeriveUnaryProduction(SyntaxNode* const* c, size_t count) {
+    if (count == 1 && IsUnaryOperand(c[0]))
+        return SP_PASSTHROUGH;
+    if (count == 4
+        && IsNode<SizeOfKeyword>(c[0])
+        && IsNode<LParenSymbol>(c[1])
+        && IsUnaryOperand(c[2])
+        && IsNode<RParenSymbol>(c[3]))
+        return SP_PARENTHESIZED_SIZE_OF;
+    if (count != 2 || c[0] == nullptr || !IsUnaryOperand(c[1]))
+        return SP_INVALID;
+
+    switch (c[0]->GetKind()) {
+    case SK_PlusPlusSymbol:    return SP_PRE_INCREMENT;
+    case SK_MinusMinusSymbol:  return SP_PRE_DECREMENT;
+    case SK_AmpersandSymbol:   return SP_ADDRESS_OF;
+    case SK_AsteriskSymbol:    return SP_POINTER_DEREFERENCE;
+    case SK_PlusSymbol:        return SP_POSITIVE;
+    case SK_MinusSymbol:       return SP_NEGATIVE;
+    case SK_TildeSymbol:       return SP_BITWISE_COMPLEMENT;
+    case SK_ExclamationSymbol: return SP_LOGICAL_NOT;
+    case SK_SizeOfKeyword:     return SP_SIZE_OF;
+    default:                   return SP_INVALID;
+    }
 }
-bool UnaryExpression::IsValid() const {
-    return IsPassthrough()
-        || IsPreIncrement()
-        || IsPreDecrement()
-        || IsAddressOf()
-        || IsPointerDereference()
-        || IsPositive()
-        || IsNegative()
-        || IsBitwiseComplement()
-        || IsLogicalNot()
-        || IsSizeOf()
-        || IsParenthesizedSizeOf();
+
+SYNTAX_PRODUCTION DeriveSyntaxProduction(const Expression& expression) {
+    SyntaxNode* const* c{ expression.GetChildNodes() };
+    size_t count{ expression.GetChildCount() };
+    SYNTAX_KIND kind{ expression.GetKind() };
+
+    switch (kind) {
+    case SK_PrimaryExpression:
+        return DerivePrimaryProduction(c, count);
+    case SK_PostfixExpression:
+        return DerivePostfixProduction(c, count);
+    case SK_UnaryExpression:
+        return DeriveUnaryProduction(c, count);
+    case SK_ConditionalExpression:
+        if (count == 5
+            && IsOperand(c[0])
+            && IsNode<QuestionSymbol>(c[1])
+            && IsOperand(c[2])
+            && IsNode<ColonSymbol>(c[3])
+            && IsOperand(c[4]))
+            return SP_CONDITIONAL;
+        break;
+    default:
+        if (count == 3 && IsOperand(c[0]) && c[1] != nullptr && IsOperand(c[2]))
+            return DeriveBinaryProduction(kind, c[1]->GetKind());
+        break;
+    }
+
+    if (count == 1 && IsOperand(c[0]))
+        return SP_PASSTHROUGH;
+    return SP_INVALID;
 }
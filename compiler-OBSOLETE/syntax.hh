@@ -2,7 +2,9 @@
 #define COMBUST_SYNTAX_HH
 #include "common.hh"
 #include "source.hh"
+#include <stddef.h>
 #include <stdint.h>
+#include <initializer_list>
 #include <string>
 #include <type_traits>
 
@@ -16,6 +18,79 @@
 #undef O
 
 
+/**
+ * Has one member per entry of syntax-kinds.def. A kind's value is the offset
+ * of its member, which numbers the kinds densely in declaration order.
+ */
+struct SYNTAX_KIND_TABLE {
+#define O(className) char className
+#define Sn(className) O(className)
+#define Tk(className) O(className)
+#include "syntax-kinds.def"
+#undef Tk
+#undef Sn
+#undef O
+};
+
+using SYNTAX_KIND = uint16_t;
+
+constexpr SYNTAX_KIND SK_COUNT{ sizeof(SYNTAX_KIND_TABLE) };
+
+#define O(className) \
+    constexpr SYNTAX_KIND SK_##className{ offsetof(SYNTAX_KIND_TABLE, className) }
+#define Sn(className) O(className)
+#define Tk(className) O(className)
+#include "syntax-kinds.def"
+#undef Tk
+#undef Sn
+#undef O
+
+/**
+ * SyntaxKindOf<T>::Value is the kind of syntax class T.
+ */
+template<typename T>
+struct SyntaxKindOf;
+
+#define O(className)                                            \
+    template<>                                                  \
+    struct SyntaxKindOf<className> {                            \
+        static constexpr SYNTAX_KIND Value{ SK_##className };   \
+    }
+#define Sn(className) O(className)
+#define Tk(className) O(className)
+#include "syntax-kinds.def"
+#undef Tk
+#undef Sn
+#undef O
+
+/**
+ * Set of syntax kinds that can be built at compile time, so that testing a
+ * node against several classes is one bit test.
+ */
+class SyntaxKindSet {
+public:
+    constexpr SyntaxKindSet() {}
+
+    template<typename... Types>
+    [[nodiscard]] static constexpr SyntaxKindSet Of() {
+        SyntaxKindSet set{ };
+        (set.Add(SyntaxKindOf<Types>::Value), ...);
+        return set;
+    }
+
+    constexpr void Add(const SYNTAX_KIND kind) {
+        words[kind / 64] |= uint64_t{ 1 } << (kind % 64);
+    }
+
+    [[nodiscard]] constexpr bool Contains(const SYNTAX_KIND kind) const {
+        return (words[kind / 64] >> (kind % 64)) & 1;
+    }
+
+private:
+    uint64_t words[(SK_COUNT + 63) / 64]{ };
+};
+
+
 class SyntaxNodeVisitor : public Object {
 public:
 #define O(className) virtual Rc<Object> Visit(className& obj) = 0
@@ -28,17 +103,29 @@ public:
 };
 
 
+class SyntaxArena;
+
 class SyntaxNode : public Object {
 public:
     const SourceRange& GetLexemeRange() const { return lexemeRange; }
     void SetLexemeRange(const SourceRange& to) { lexemeRange = to; }
 
+    /** \return the arena that created the node, null if it is on the heap */
+    SyntaxArena* GetArena() const { return arena; }
+
+    virtual SYNTAX_KIND GetKind() const = 0;
     virtual Rc<Object> Accept(SyntaxNodeVisitor& visitor) = 0;
 protected:
     explicit SyntaxNode() {}
     virtual ~SyntaxNode() {}
+
+    /** \return the arena, if any, which references to the node count towards */
+    const RefCounted* GetReferenceOwner() const override;
 private:
-    SourceRange lexemeRange{ };
+    friend class SyntaxArena;
+
+    SourceRange  lexemeRange{ };
+    SyntaxArena* arena{ nullptr };
 };
 
 using SyntaxNodeVector = std::vector<Rc<SyntaxNode>>;
@@ -46,9 +133,13 @@ using SyntaxNodeVector = std::vector<Rc<SyntaxNode>>;
 class SyntaxToken : public SyntaxNode {
 public:
     static constexpr uint32_t BEGINNING_OF_LINE = 0x1;
+    /** The parser expected this token but the input did not contain it. */
+    static constexpr uint32_t IS_MISSING = 0x2;
 
     uint32_t GetFlags() const { return flags; }
     void SetFlags(const uint32_t to) { flags = to; }
+    bool HasFlag(const uint32_t flag) const { return (flags & flag) != 0; }
+    void SetFlag(const uint32_t flag) { flags |= flag; }
 protected:
     explicit SyntaxToken() {}
     virtual ~SyntaxToken() {}
@@ -56,20 +147,112 @@ private:
     uint32_t    flags{ 0 };
 };
 
+/**
+ * The rule of the grammar an expression was built by, recorded when its
+ * children are set so that asking for it does not re-examine them.
+ */
+enum SYNTAX_PRODUCTION : uint8_t {
+    /** Incomplete or unrecognized children. */
+    SP_INVALID,
+    /** A single expression; the parser no longer builds these. */
+    SP_PASSTHROUGH,
+
+    SP_IDENTIFIER,
+    SP_NUMERIC_LITERAL,
+    SP_STRING_LITERAL,
+    SP_PARENTHESIZED_EXPRESSION,
+
+    SP_ARRAY_ACCESSOR,
+    SP_FUNCTION_CALL,
+    SP_STRUCTURE_REFERENCE,
+    SP_STRUCTURE_DEREFERENCE,
+    SP_POST_INCREMENT,
+    SP_POST_DECREMENT,
+
+    SP_PRE_INCREMENT,
+    SP_PRE_DECREMENT,
+    SP_ADDRESS_OF,
+    SP_POINTER_DEREFERENCE,
+    SP_POSITIVE,
+    SP_NEGATIVE,
+    SP_BITWISE_COMPLEMENT,
+    SP_LOGICAL_NOT,
+    SP_SIZE_OF,
+    SP_PARENTHESIZED_SIZE_OF,
+
+    SP_CAST,
+
+    SP_MULTIPLICATION,
+    SP_DIVISION,
+    SP_MODULO,
+    SP_ADDITION,
+    SP_SUBTRACTION,
+    SP_LEFT_SHIFT,
+    SP_RIGHT_SHIFT,
+    SP_LESS_THAN,
+    SP_GREATER_THAN,
+    SP_LESS_THAN_OR_EQUAL_TO,
+    SP_GREATER_THAN_OR_EQUAL_TO,
+    SP_EQUAL,
+    SP_NOT_EQUAL,
+    SP_BITWISE_AND,
+    SP_BITWISE_XOR,
+    SP_BITWISE_OR,
+    SP_LOGICAL_AND,
+    SP_LOGICAL_OR,
+
+    SP_CONDITIONAL,
+
+    SP_ASSIGNMENT,
+    SP_MULTIPLY_ASSIGNMENT,
+    SP_DIVIDE_ASSIGNMENT,
+    SP_MODULO_ASSIGNMENT,
+    SP_ADDITION_ASSIGNMENT,
+    SP_SUBTRACTION_ASSIGNMENT,
+    SP_LEFT_SHIFT_ASSIGNMENT,
+    SP_RIGHT_SHIFT_ASSIGNMENT,
+    SP_BITWISE_AND_ASSIGNMENT,
+    SP_BITWISE_XOR_ASSIGNMENT,
+    SP_BITWISE_OR_ASSIGNMENT,
+
+    SP_COMMA
+};
+
+/**
+ * Expressions are created by a SyntaxArena, which also holds their child
+ * arrays; see SyntaxArena::New. Their constructors are private to it, as
+ * an expression anywhere else would have nowhere to put its children.
+ */
 class Expression : public SyntaxNode {
 public:
-    Rc<SyntaxNode> GetChild(const int index) { return children[index]; }
-    const SyntaxNodeVector& GetChildren() const { return children; }
-    SyntaxNodeVector& GetChildren() { return children; }
-    void SetChildren(const SyntaxNodeVector& to) { children = to; }
-
-    virtual bool IsValid() const = 0;
+    /**
+     * \return the child as an Rc that keeps the whole tree alive
+     */
+    Rc<SyntaxNode> GetChild(const int index) const;
+    SyntaxNode* GetChildNode(const int index) const { return children[index]; }
+    SyntaxNode* const* GetChildNodes() const { return children; }
+    size_t GetChildCount() const { return childCount; }
+
+    /**
+     * Replaces the children with copies in the arena that owns this
+     * expression, which was built by the given production. Children from
+     * elsewhere are kept alive by the arena.
+     *
+     * Unless NDEBUG is defined, a production that does not match the shape
+     * of the children is a fatal error.
+     */
+    void SetChildren(SYNTAX_PRODUCTION production, std::initializer_list<Rc<SyntaxNode>> to);
+
+    SYNTAX_PRODUCTION GetProduction() const { return production; }
+    bool IsValid() const { return production != SP_INVALID; }
 
 protected:
     explicit Expression() {}
     virtual ~Expression() {}
 
-    SyntaxNodeVector children{ };
+    SyntaxNode**      children{ nullptr };
+    uint32_t          childCount{ 0 };
+    SYNTAX_PRODUCTION production{ SP_INVALID };
 };
 
 class Declaration : public SyntaxNode {
@@ -91,6 +274,7 @@ protected:
     public:                                                \
         explicit className();                              \
         virtual ~className();                              \
+        SYNTAX_KIND GetKind() const override;              \
         Rc<Object> Accept(SyntaxNodeVisitor& visitor) override; \
     }
 #include "syntax-kinds.def"
@@ -103,6 +287,7 @@ public:
     virtual ~InvalidDirective() {}
     const std::string& GetName() const { return name; }
     void SetName(const std::string& to) { name = to; }
+    SYNTAX_KIND GetKind() const override;
     Rc<Object> Accept(SyntaxNodeVisitor& visitor) override;
 private:
     std::string name{ };
@@ -114,6 +299,7 @@ public:
     virtual ~StrayToken() {}
     char GetOffendingChar() const { return offendingChar; }
     void SetOffendingChar(const char to) { offendingChar = to; }
+    SYNTAX_KIND GetKind() const override;
     Rc<Object> Accept(SyntaxNodeVisitor& visitor) override;
 private:
     char offendingChar{ 0 };
@@ -129,6 +315,7 @@ public:
     void SetOpeningToken(const std::string& to) { openingToken = to; }
     const std::string& GetClosingToken() const { return closingToken; }
     void SetClosingToken(const std::string& to) { closingToken = to; }
+    SYNTAX_KIND GetKind() const override;
     Rc<Object> Accept(SyntaxNodeVisitor& visitor) override;
 private:
     std::string contents{ };
@@ -142,6 +329,7 @@ public:
     virtual ~IdentifierToken() {}
     const std::string& GetName() const { return name; }
     void SetName(const std::string& to) { name = to; }
+    SYNTAX_KIND GetKind() const override;
     Rc<Object> Accept(SyntaxNodeVisitor& visitor) override;
 private:
     std::string name{ };
@@ -161,6 +349,7 @@ public:
     void SetPrefix(const std::string& to) { prefix = to; }
     const std::string& GetSuffix() const { return suffix; }
     void SetSuffix(const std::string& to) { suffix = to; }
+    SYNTAX_KIND GetKind() const override;
     Rc<Object> Accept(SyntaxNodeVisitor& visitor) override;
 private:
     std::string wholeValue{ };
@@ -180,6 +369,7 @@ public:
     void SetOpeningQuote(const char to) { openingQuote = to; }
     char GetClosingQuote() const { return closingQuote; }
     void SetClosingQuote(const char to) { closingQuote = to; }
+    SYNTAX_KIND GetKind() const override;
     Rc<Object> Accept(SyntaxNodeVisitor& visitor) override;
 private:
     std::string value{ };
@@ -194,238 +384,303 @@ private:
  */
 class PrimaryExpression : public Expression {
 public:
-    explicit PrimaryExpression() {}
     virtual ~PrimaryExpression() {}
-    bool IsIdentifier() const;
-    bool IsNumericLiteral() const;
-    bool IsStringLiteral() const;
-    bool IsParenthesizedExpression() const;
-    bool IsValid() const override;
+    bool IsIdentifier() const { return production == SP_IDENTIFIER; }
+    bool IsNumericLiteral() const { return production == SP_NUMERIC_LITERAL; }
+    bool IsStringLiteral() const { return production == SP_STRING_LITERAL; }
+    bool IsParenthesizedExpression() const { return production == SP_PARENTHESIZED_EXPRESSION; }
+    SYNTAX_KIND GetKind() const override;
     Rc<Object> Accept(SyntaxNodeVisitor& visitor) override;
+
+private:
+    friend class SyntaxArena;
+
+    explicit PrimaryExpression() {}
 };
 
 class PostfixExpression : public Expression {
 public:
-    explicit PostfixExpression() {}
     virtual ~PostfixExpression() {}
-    bool IsPassthrough() const;
-    bool IsArrayAccessor() const;
-    bool IsFunctionCall() const;
-    bool IsStructureReference() const;
-    bool IsStructureDereference() const;
-    bool IsPostIncrement() const;
-    bool IsPostDecrement() const;
-    bool IsValid() const override;
+    bool IsPassthrough() const { return production == SP_PASSTHROUGH; }
+    bool IsArrayAccessor() const { return production == SP_ARRAY_ACCESSOR; }
+    bool IsFunctionCall() const { return production == SP_FUNCTION_CALL; }
+    bool IsStructureReference() const { return production == SP_STRUCTURE_REFERENCE; }
+    bool IsStructureDereference() const { return production == SP_STRUCTURE_DEREFERENCE; }
+    bool IsPostIncrement() const { return production == SP_POST_INCREMENT; }
+    bool IsPostDecrement() const { return production == SP_POST_DECREMENT; }
+    SYNTAX_KIND GetKind() const override;
     Rc<Object> Accept(SyntaxNodeVisitor& visitor) override;
+
+private:
+    friend class SyntaxArena;
+
+    explicit PostfixExpression() {}
 };
 
 class UnaryExpression : public Expression {
 public:
-    explicit UnaryExpression() {}
     virtual ~UnaryExpression() {}
-    bool IsPassthrough() const;
-    bool IsPreIncrement() const;
-    bool IsPreDecrement() const;
-    bool IsAddressOf() const;
-    bool IsPointerDereference() const;
-    bool IsPositive() const;
-    bool IsNegative() const;
-    bool IsBitwiseComplement() const;
-    bool IsLogicalNot() const;
-    bool IsSizeOf() const;
-    bool IsParenthesizedSizeOf() const;
-    bool IsValid() const override;
+    bool IsPassthrough() const { return production == SP_PASSTHROUGH; }
+    bool IsPreIncrement() const { return production == SP_PRE_INCREMENT; }
+    bool IsPreDecrement() const { return production == SP_PRE_DECREMENT; }
+    bool IsAddressOf() const { return production == SP_ADDRESS_OF; }
+    bool IsPointerDereference() const { return production == SP_POINTER_DEREFERENCE; }
+    bool IsPositive() const { return production == SP_POSITIVE; }
+    bool IsNegative() const { return production == SP_NEGATIVE; }
+    bool IsBitwiseComplement() const { return production == SP_BITWISE_COMPLEMENT; }
+    bool IsLogicalNot() const { return production == SP_LOGICAL_NOT; }
+    bool IsSizeOf() const { return production == SP_SIZE_OF; }
+    bool IsParenthesizedSizeOf() const { return production == SP_PARENTHESIZED_SIZE_OF; }
+    SYNTAX_KIND GetKind() const override;
     Rc<Object> Accept(SyntaxNodeVisitor& visitor) override;
+
+private:
+    friend class SyntaxArena;
+
+    explicit UnaryExpression() {}
 };
 
 class CastExpression : public Expression {
 public:
-    explicit CastExpression() {}
     virtual ~CastExpression() {}
-    bool IsPassthrough() const;
-    bool IsCast() const;
-    bool IsValid() const override;
+    bool IsPassthrough() const { return production == SP_PASSTHROUGH; }
+    bool IsCast() const { return production == SP_CAST; }
+    SYNTAX_KIND GetKind() const override;
     Rc<Object> Accept(SyntaxNodeVisitor& visitor) override;
+
+private:
+    friend class SyntaxArena;
+
+    explicit CastExpression() {}
 };
 
 class MultiplicativeExpression : public Expression {
 public:
-    explicit MultiplicativeExpression() {}
     virtual ~MultiplicativeExpression() {}
-    bool IsPassthrough() const;
-    bool IsMultiplication() const;
-    bool IsDivision() const;
-    bool IsModulo() const;
-    bool IsValid() const override;
+    bool IsPassthrough() const { return production == SP_PASSTHROUGH; }
+    bool IsMultiplication() const { return production == SP_MULTIPLICATION; }
+    bool IsDivision() const { return production == SP_DIVISION; }
+    bool IsModulo() const { return production == SP_MODULO; }
+    SYNTAX_KIND GetKind() const override;
     Rc<Object> Accept(SyntaxNodeVisitor& visitor) override;
+
+private:
+    friend class SyntaxArena;
+
+    explicit MultiplicativeExpression() {}
 };
 
 class AdditiveExpression : public Expression {
 public:
-    explicit AdditiveExpression() {}
     virtual ~AdditiveExpression() {}
-    bool IsPassthrough() const;
-    bool IsAddition() const;
-    bool IsSubtraction() const;
-    bool IsValid() const override;
+    bool IsPassthrough() const { return production == SP_PASSTHROUGH; }
+    bool IsAddition() const { return production == SP_ADDITION; }
+    bool IsSubtraction() const { return production == SP_SUBTRACTION; }
+    SYNTAX_KIND GetKind() const override;
     Rc<Object> Accept(SyntaxNodeVisitor& visitor) override;
+
+private:
+    friend class SyntaxArena;
+
+    explicit AdditiveExpression() {}
 };
 
 class ShiftExpression : public Expression {
-    explicit ShiftExpression() {}
+public:
     virtual ~ShiftExpression() {}
-    bool IsPassthrough() const;
-    bool IsLeftShift() const;
-    bool IsRightShift() const;
-    bool IsValid() const override;
+    bool IsPassthrough() const { return production == SP_PASSTHROUGH; }
+    bool IsLeftShift() const { return production == SP_LEFT_SHIFT; }
+    bool IsRightShift() const { return production == SP_RIGHT_SHIFT; }
+    SYNTAX_KIND GetKind() const override;
     Rc<Object> Accept(SyntaxNodeVisitor& visitor) override;
+
+private:
+    friend class SyntaxArena;
+
+    explicit ShiftExpression() {}
 };
 
 class RelationalExpression : public Expression {
 public:
-    explicit RelationalExpression() {}
     virtual ~RelationalExpression() {}
-    bool IsPassthrough() const;
-    bool IsLessThan() const;
-    bool IsGreaterThan() const;
-    bool IsLessThanOrEqualTo() const;
-    bool IsGreaterThanOrEqualTo() const;
-    bool IsValid() const override;
+    bool IsPassthrough() const { return production == SP_PASSTHROUGH; }
+    bool IsLessThan() const { return production == SP_LESS_THAN; }
+    bool IsGreaterThan() const { return production == SP_GREATER_THAN; }
+    bool IsLessThanOrEqualTo() const { return production == SP_LESS_THAN_OR_EQUAL_TO; }
+    bool IsGreaterThanOrEqualTo() const { return production == SP_GREATER_THAN_OR_EQUAL_TO; }
+    SYNTAX_KIND GetKind() const override;
     Rc<Object> Accept(SyntaxNodeVisitor& visitor) override;
+
+private:
+    friend class SyntaxArena;
+
+    explicit RelationalExpression() {}
 };
 
 class EqualityExpression : public Expression {
 public:
-    explicit EqualityExpression() {}
     virtual ~EqualityExpression() {}
-    bool IsPassthrough() const;
-    bool IsEqual() const;
-    bool IsNotEqual() const;
-    bool IsValid() const override;
+    bool IsPassthrough() const { return production == SP_PASSTHROUGH; }
+    bool IsEqual() const { return production == SP_EQUAL; }
+    bool IsNotEqual() const { return production == SP_NOT_EQUAL; }
+    SYNTAX_KIND GetKind() const override;
     Rc<Object> Accept(SyntaxNodeVisitor& visitor) override;
+
+private:
+    friend class SyntaxArena;
+
+    explicit EqualityExpression() {}
 };
 
 class AndExpression : public Expression {
 public:
-    explicit AndExpression() {}
     virtual ~AndExpression() {}
-    bool IsPassthrough() const;
-    bool IsBitwiseAnd() const;
-    bool IsValid() const override;
+    bool IsPassthrough() const { return production == SP_PASSTHROUGH; }
+    bool IsBitwiseAnd() const { return production == SP_BITWISE_AND; }
+    SYNTAX_KIND GetKind() const override;
     Rc<Object> Accept(SyntaxNodeVisitor& visitor) override;
+
+private:
+    friend class SyntaxArena;
+
+    explicit AndExpression() {}
 };
 
 class ExclusiveOrExpression : public Expression {
 public:
-    explicit ExclusiveOrExpression() {}
     virtual ~ExclusiveOrExpression() {}
-    bool IsPassthrough() const;
-    bool IsBitwiseXor() const;
-    bool IsValid() const override;
+    bool IsPassthrough() const { return production == SP_PASSTHROUGH; }
+    bool IsBitwiseXor() const { return production == SP_BITWISE_XOR; }
+    SYNTAX_KIND GetKind() const override;
     Rc<Object> Accept(SyntaxNodeVisitor& visitor) override;
+
+private:
+    friend class SyntaxArena;
+
+    explicit ExclusiveOrExpression() {}
 };
 
 class InclusiveOrExpression : public Expression {
 public:
-    explicit InclusiveOrExpression() {}
     virtual ~InclusiveOrExpression() {}
-    bool IsPassthrough() const;
-    bool IsBitwiseOr() const;
-    bool IsValid() const override;
+    bool IsPassthrough() const { return production == SP_PASSTHROUGH; }
+    bool IsBitwiseOr() const { return production == SP_BITWISE_OR; }
+    SYNTAX_KIND GetKind() const override;
     Rc<Object> Accept(SyntaxNodeVisitor& visitor) override;
+
+private:
+    friend class SyntaxArena;
+
+    explicit InclusiveOrExpression() {}
 };
 
 class LogicalAndExpression : public Expression {
 public:
-    explicit LogicalAndExpression() {}
     virtual ~LogicalAndExpression() {}
-    bool IsPassthrough() const;
-    bool IsLogicalAnd() const;
-    bool IsValid() const override;
+    bool IsPassthrough() const { return production == SP_PASSTHROUGH; }
+    bool IsLogicalAnd() const { return production == SP_LOGICAL_AND; }
+    SYNTAX_KIND GetKind() const override;
     Rc<Object> Accept(SyntaxNodeVisitor& visitor) override;
+
+private:
+    friend class SyntaxArena;
+
+    explicit LogicalAndExpression() {}
 };
 
 class LogicalOrExpression : public Expression {
 public:
-    explicit LogicalOrExpression() {}
     virtual ~LogicalOrExpression() {}
-    bool IsPassthrough() const;
-    bool IsLogicalOr() const;
-    bool IsValid() const override;
+    bool IsPassthrough() const { return production == SP_PASSTHROUGH; }
+    bool IsLogicalOr() const { return production == SP_LOGICAL_OR; }
+    SYNTAX_KIND GetKind() const override;
     Rc<Object> Accept(SyntaxNodeVisitor& visitor) override;
+
+private:
+    friend class SyntaxArena;
+
+    explicit LogicalOrExpression() {}
 };
 
 class ConditionalExpression : public Expression {
 public:
-    explicit ConditionalExpression() {}
     virtual ~ConditionalExpression() {}
-    bool IsPassthrough() const;
-    bool IsConditional() const;
-    bool IsValid() const override;
+    bool IsPassthrough() const { return production == SP_PASSTHROUGH; }
+    bool IsConditional() const { return production == SP_CONDITIONAL; }
+    SYNTAX_KIND GetKind() const override;
     Rc<Object> Accept(SyntaxNodeVisitor& visitor) override;
+
+private:
+    friend class SyntaxArena;
+
+    explicit ConditionalExpression() {}
 };
 
 class AssignmentExpression : public Expression {
 public:
-    explicit AssignmentExpression() {}
     virtual ~AssignmentExpression() {}
-    bool IsPassthrough() const;
-    bool IsAssignment() const;
-    bool IsMultiplyAssignment() const;
-    bool IsDivideAssignment() const;
-    bool IsModuloAssignment() const;
-    bool IsAdditionAssignment() const;
-    bool IsSubtractionAssignment() const;
-    bool IsLeftShiftAssignment() const;
-    bool IsRightShiftAssignment() const;
-    bool IsBitwiseAndAssignment() const;
-    bool IsBitwiseXorAssignment() const;
-    bool IsBitwiseOrAssignment() const;
-    bool IsValid() const override;
+    bool IsPassthrough() const { return production == SP_PASSTHROUGH; }
+    bool IsAssignment() const { return production == SP_ASSIGNMENT; }
+    bool IsMultiplyAssignment() const { return production == SP_MULTIPLY_ASSIGNMENT; }
+    bool IsDivideAssignment() const { return production == SP_DIVIDE_ASSIGNMENT; }
+    bool IsModuloAssignment() const { return production == SP_MODULO_ASSIGNMENT; }
+    bool IsAdditionAssignment() const { return production == SP_ADDITION_ASSIGNMENT; }
+    bool IsSubtractionAssignment() const { return production == SP_SUBTRACTION_ASSIGNMENT; }
+    bool IsLeftShiftAssignment() const { return production == SP_LEFT_SHIFT_ASSIGNMENT; }
+    bool IsRightShiftAssignment() const { return production == SP_RIGHT_SHIFT_ASSIGNMENT; }
+    bool IsBitwiseAndAssignment() const { return production == SP_BITWISE_AND_ASSIGNMENT; }
+    bool IsBitwiseXorAssignment() const { return production == SP_BITWISE_XOR_ASSIGNMENT; }
+    bool IsBitwiseOrAssignment() const { return production == SP_BITWISE_OR_ASSIGNMENT; }
+    SYNTAX_KIND GetKind() const override;
     Rc<Object> Accept(SyntaxNodeVisitor& visitor) override;
+
+private:
+    friend class SyntaxArena;
+
+    explicit AssignmentExpression() {}
 };
 
 class CommaExpression : public Expression {
 public:
-    explicit CommaExpression() {}
     virtual ~CommaExpression() {}
-    bool IsPassthrough() const;
-    bool IsComma() const;
-    bool IsValid() const override;
+    bool IsPassthrough() const { return production == SP_PASSTHROUGH; }
+    bool IsComma() const { return production == SP_COMMA; }
+    SYNTAX_KIND GetKind() const override;
     Rc<Object> Accept(SyntaxNodeVisitor& visitor) override;
+
+private:
+    friend class SyntaxArena;
+
+    explicit CommaExpression() {}
 };
 
 
-template<typename T>
-class IsSyntaxNodeVisitor : public SyntaxNodeVisitor {
-public:
-    explicit IsSyntaxNodeVisitor() {}
-    virtual ~IsSyntaxNodeVisitor() {}
-    bool GetResult() const { return result; }
+/**
+ * \return a default-constructed token of the given kind, or nullptr if kind
+ *         does not name a token class
+ */
+Rc<SyntaxToken> NewSyntaxToken(SYNTAX_KIND kind);
 
-#define O(className)                                     \
-    Rc<Object> Visit(className& obj) override {          \
-        (void) obj;                                      \
-        if constexpr (std::is_same<T, className>::value) \
-            result = true;                               \
-        return Rc<Object>{ };                            \
-    }
-#define Sn(className) O(className)
-#define Tk(className) O(className)
-#include "syntax-kinds.def"
-#undef Tk
-#undef Sn
-#undef O
+/**
+ * \return true if kind names a token class
+ */
+bool IsSyntaxTokenKind(SYNTAX_KIND kind);
 
-private:
-    bool result{ false };
-};
+/**
+ * Works out which production an expression's children fit, the slow way.
+ * Used to check the production recorded by SetChildren.
+ */
+SYNTAX_PRODUCTION DeriveSyntaxProduction(const Expression& expression);
+
+
+template<typename T, typename U>
+[[nodiscard]] inline bool IsSyntaxNode(const Rc<U>& node) {
+    return node->GetKind() == SyntaxKindOf<T>::Value;
+}
 
 template<typename T>
-[[nodiscard]] inline bool IsSyntaxNode(Rc<SyntaxNode> node) {
-    IsSyntaxNodeVisitor<T> visitorFunction{ };
-    node->Accept(visitorFunction);
-    return visitorFunction.GetResult();
+[[nodiscard]] inline bool IsSyntaxNode(const SyntaxNode* node) {
+    return node->GetKind() == SyntaxKindOf<T>::Value;
 }
 
 
@@ -455,10 +710,15 @@ private:
 };
 
 template<typename T>
-[[nodiscard]] inline bool IsBaseOfSyntaxNode(Rc<SyntaxNode> node) {
+[[nodiscard]] inline bool IsBaseOfSyntaxNode(SyntaxNode* node) {
     IsBaseOfSyntaxNodeVisitor<T> visitorFunction{ };
     node->Accept(visitorFunction);
     return visitorFunction.GetResult();
 }
 
+template<typename T>
+[[nodiscard]] inline bool IsBaseOfSyntaxNode(Rc<SyntaxNode> node) {
+    return IsBaseOfSyntaxNode<T>(node.get());
+}
+
 #endif
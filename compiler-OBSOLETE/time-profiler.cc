@@ -0,0 +1,375 @@
+#include "time-profiler.hh"
+#include "json-writer.hh"
+#include "performance-counters.hh"
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+bool g_IsTimeProfilingEnabled{ false };
+
+static const char* const TIME_PHASE_NAMES[TP_COUNT]{
+    "ReadSourceContents",
+    "MinimizeSource",
+    "CodeLexer",
+    "PreprocessorLexer",
+    "BacktrackingLexer",
+    "ParseExpression",
+    "ScanFile",
+    "PreprocessFile"
+};
+
+const char* GetTimePhaseName(TIME_PHASE phase) {
+    return TIME_PHASE_NAMES[phase];
+}
+
+struct TRACE_EVENT {
+    TIME_PHASE  Phase;
+    size_t      Input;
+    int64_t     StartTime;
+    int64_t     Duration;
+    std::string Detail;
+};
+
+/**
+ * Spans recorded by one thread. Owned by the profiler rather than by the
+ * thread, so they outlive the parallel loop's worker threads.
+ */
+struct THREAD_TRACE {
+    unsigned                 Id{ 0 };
+    std::vector<TRACE_EVENT> Events{ };
+    size_t                   CurrentInput{ SIZE_MAX };
+};
+
+struct TIME_PROFILER_STATE {
+    bool                              IsTracing{ false };
+    bool                              IsCounting{ false };
+    std::chrono::steady_clock::time_point
+                                      Origin{ std::chrono::steady_clock::now() };
+
+    /** In nanoseconds. */
+    std::atomic<int64_t>              Totals[TP_COUNT]{ };
+    std::atomic<int64_t>              Counts[TP_COUNT]{ };
+    std::atomic<uint64_t>             CounterTotals[TP_COUNT][PC_COUNT]{ };
+    /** The counters read by any thread, a bit per PERFORMANCE_COUNTER. */
+    std::atomic<unsigned>             CounterMask{ 0 };
+
+    std::mutex                        Mutex{ };
+    std::vector<Owner<THREAD_TRACE>>  Threads{ };
+    /** Bumped by ResetTimeProfiler, which frees every thread's trace. */
+    unsigned                          Generation{ 0 };
+};
+
+static TIME_PROFILER_STATE& GetState() {
+    static TIME_PROFILER_STATE state{ };
+    return state;
+}
+
+static int64_t GetTime() {
+    auto elapsed{ std::chrono::steady_clock::now() - GetState().Origin };
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
+
+/**
+ * Counter samples taken where the calling thread's running timers started,
+ * innermost last. Timers are scoped, so they stop in the reverse order.
+ */
+static std::vector<PerformanceCounterSample>& GetCounterStack() {
+    thread_local std::vector<PerformanceCounterSample> stack{ };
+    return stack;
+}
+
+static THREAD_TRACE* GetThreadTrace() {
+    thread_local THREAD_TRACE* trace{ nullptr };
+    thread_local unsigned generation{ 0 };
+    TIME_PROFILER_STATE& state{ GetState() };
+
+    if (trace == nullptr || generation != state.Generation) {
+        std::lock_guard<std::mutex> lock{ state.Mutex };
+
+        state.Threads.push_back(NewChild<THREAD_TRACE>());
+        trace = state.Threads.back().get();
+        trace->Id = static_cast<unsigned>(state.Threads.size() - 1);
+        generation = state.Generation;
+    }
+
+    return trace;
+}
+
+void EnableTimeReport() {
+    g_IsTimeProfilingEnabled = true;
+}
+
+void EnableTimeTrace() {
+    GetState().IsTracing = true;
+    g_IsTimeProfilingEnabled = true;
+}
+
+void EnableCounterReport() {
+    GetState().IsCounting = true;
+    g_IsTimeProfilingEnabled = true;
+}
+
+void ResetTimeProfiler() {
+    TIME_PROFILER_STATE& state{ GetState() };
+    std::lock_guard<std::mutex> lock{ state.Mutex };
+
+    g_IsTimeProfilingEnabled = false;
+    state.IsTracing = false;
+    state.IsCounting = false;
+
+    for (int phase{ 0 }; phase < TP_COUNT; ++phase) {
+        state.Totals[phase] = 0;
+        state.Counts[phase] = 0;
+
+        for (int counter{ 0 }; counter < PC_COUNT; ++counter)
+            state.CounterTotals[phase][counter] = 0;
+    }
+
+    state.CounterMask = 0;
+
+    state.Threads.clear();
+    ++state.Generation;
+}
+
+ScopedTimer::ScopedTimer(TIME_PHASE phase, size_t input, const std::string& detail) :
+    phase{ phase },
+    input{ input }
+{
+#if defined(COMBUST_ALLOCATION_PROFILER)
+    previousAllocationPhase = SetAllocationPhase(phase);
+#endif
+    if (!g_IsTimeProfilingEnabled)
+        return;
+
+    if (GetState().IsTracing) {
+        THREAD_TRACE* trace{ GetThreadTrace() };
+        previousInput = trace->CurrentInput;
+        trace->CurrentInput = input;
+        this->detail = detail;
+    }
+
+    Start();
+}
+
+void ScopedTimer::Start() {
+    isRunning = true;
+
+    if (GetState().IsCounting) {
+        std::vector<PerformanceCounterSample>& stack{ GetCounterStack() };
+        stack.emplace_back();
+        ReadPerformanceCounters(stack.back());
+        isCounting = true;
+    }
+
+    startTime = GetTime();
+}
+
+void ScopedTimer::Stop() {
+    int64_t duration{ GetTime() - startTime };
+    TIME_PROFILER_STATE& state{ GetState() };
+
+    if (isCounting) {
+        std::vector<PerformanceCounterSample>& stack{ GetCounterStack() };
+        PerformanceCounterSample end{ };
+
+        if (ReadPerformanceCounters(end)) {
+            uint64_t deltas[PC_COUNT];
+            GetPerformanceCounterDeltas(stack.back(), end, deltas);
+
+            for (int counter{ 0 }; counter < PC_COUNT; ++counter)
+                state.CounterTotals[phase][counter].fetch_add(deltas[counter], std::memory_order_relaxed);
+
+            state.CounterMask.fetch_or(stack.back().AvailableMask & end.AvailableMask, std::memory_order_relaxed);
+        }
+
+        stack.pop_back();
+    }
+
+    state.Totals[phase].fetch_add(duration, std::memory_order_relaxed);
+    state.Counts[phase].fetch_add(1, std::memory_order_relaxed);
+
+    if (!state.IsTracing)
+        return;
+
+    THREAD_TRACE* trace{ GetThreadTrace() };
+    trace->Events.push_back(TRACE_EVENT{ phase, trace->CurrentInput, startTime, duration, std::move(detail) });
+
+    if (input != NO_INPUT)
+        trace->CurrentInput = previousInput;
+}
+
+/**
+ * Appends the counts of each phase, with a dash for counters no thread
+ * could read.
+ */
+static void AppendCounterReport(IN_OUT std::string& report, unsigned counterMask) {
+    TIME_PROFILER_STATE& state{ GetState() };
+    char line[128];
+
+    report += "\n  Hardware counters, user mode only:\n";
+
+    for (int counter{ 0 }; counter < PC_COUNT; ++counter) {
+        snprintf(line, sizeof(line), "%15s", GetPerformanceCounterName(static_cast<PERFORMANCE_COUNTER>(counter)));
+        report += line;
+    }
+
+    report += "  Phase\n";
+
+    for (int phase{ 0 }; phase < TP_COUNT; ++phase) {
+        if (state.Counts[phase].load(std::memory_order_relaxed) == 0)
+            continue;
+
+        for (int counter{ 0 }; counter < PC_COUNT; ++counter) {
+            if ((counterMask & (1u << counter)) == 0) {
+                report += "              -";
+                continue;
+            }
+
+            snprintf(
+                line,
+                sizeof(line),
+                "%15llu",
+                static_cast<unsigned long long>(state.CounterTotals[phase][counter].load(std::memory_order_relaxed))
+            );
+            report += line;
+        }
+
+        report += "  ";
+        report += TIME_PHASE_NAMES[phase];
+        report += '\n';
+    }
+}
+
+std::string FormatTimeReport() {
+    TIME_PROFILER_STATE& state{ GetState() };
+    std::string report{ };
+    char line[128];
+
+    report += "===------------------------------------------------------------===\n";
+    report += "                     Phase timing report\n";
+    report += "===------------------------------------------------------------===\n";
+
+    snprintf(line, sizeof(line), "  Total wall time: %.3f ms\n\n", GetTime() / 1e6);
+    report += line;
+    report += "   Time (ms)      Calls  Phase\n";
+
+    for (int phase{ 0 }; phase < TP_COUNT; ++phase) {
+        int64_t count{ state.Counts[phase].load(std::memory_order_relaxed) };
+        if (count == 0)
+            continue;
+
+        snprintf(
+            line,
+            sizeof(line),
+            "  %10.3f %10lld  %s\n",
+            state.Totals[phase].load(std::memory_order_relaxed) / 1e6,
+            static_cast<long long>(count),
+            TIME_PHASE_NAMES[phase]
+        );
+        report += line;
+    }
+
+    unsigned counterMask{ state.CounterMask.load(std::memory_order_relaxed) };
+    if (counterMask != 0)
+        AppendCounterReport(report, counterMask);
+
+    return report;
+}
+
+/**
+ * Appends a complete ("X") event, with times in microseconds as the
+ * format expects.
+ */
+static void AppendTraceEvent(IN_OUT std::string& json, const TRACE_EVENT& event, unsigned threadId) {
+    json += '{';
+    AppendJsonKey(json, "ph");
+    AppendJsonString(json, "X");
+    json += ',';
+    AppendJsonKey(json, "name");
+    AppendJsonString(json, TIME_PHASE_NAMES[event.Phase]);
+    json += ',';
+    AppendJsonKey(json, "pid");
+    AppendJsonNumber(json, 1);
+    json += ',';
+    AppendJsonKey(json, "tid");
+    AppendJsonNumber(json, threadId);
+    json += ',';
+    AppendJsonKey(json, "ts");
+    AppendJsonNumber(json, event.StartTime / 1000);
+    json += ',';
+    AppendJsonKey(json, "dur");
+    AppendJsonNumber(json, event.Duration / 1000);
+
+    if (!event.Detail.empty()) {
+        json += ',';
+        AppendJsonKey(json, "args");
+        json += '{';
+        AppendJsonKey(json, "detail");
+        AppendJsonString(json, event.Detail);
+        json += '}';
+    }
+
+    json += '}';
+}
+
+static void AppendThreadName(IN_OUT std::string& json, unsigned threadId) {
+    json += '{';
+    AppendJsonKey(json, "ph");
+    AppendJsonString(json, "M");
+    json += ',';
+    AppendJsonKey(json, "name");
+    AppendJsonString(json, "thread_name");
+    json += ',';
+    AppendJsonKey(json, "pid");
+    AppendJsonNumber(json, 1);
+    json += ',';
+    AppendJsonKey(json, "tid");
+    AppendJsonNumber(json, threadId);
+    json += ',';
+    AppendJsonKey(json, "args");
+    json += '{';
+    AppendJsonKey(json, "name");
+    AppendJsonString(json, "thread " + std::to_string(threadId));
+    json += "}}";
+}
+
+bool WriteTimeTrace(const std::string& path, size_t input) {
+    TIME_PROFILER_STATE& state{ GetState() };
+    std::string json{ "{\"traceEvents\":[\n" };
+    bool isFirst{ true };
+
+    {
+        std::lock_guard<std::mutex> lock{ state.Mutex };
+
+        for (const Owner<THREAD_TRACE>& trace : state.Threads) {
+            bool hasEvents{ false };
+
+            for (const TRACE_EVENT& event : trace->Events) {
+                if (event.Input != input)
+                    continue;
+
+                if (!hasEvents) {
+                    if (!isFirst)
+                        json += ",\n";
+                    AppendThreadName(json, trace->Id);
+                    hasEvents = true;
+                    isFirst = false;
+                }
+
+                json += ",\n";
+                AppendTraceEvent(json, event, trace->Id);
+            }
+        }
+    }
+
+    json += "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    FILE* file{ fopen(path.c_str(), "wb") };
+    if (file == nullptr)
+        return false;
+
+    fwrite(json.data(), 1, json.size(), file);
+    return fclose(file) == 0;
+}
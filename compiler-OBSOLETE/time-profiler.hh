@@ -0,0 +1,120 @@
+#ifndef COMBUST_TIME_PROFILER_HH
+#define COMBUST_TIME_PROFILER_HH
+#include "common.hh"
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/**
+ * Parts of the compiler timed by -ftime-report and -ftime-trace. Phases
+ * nest, e.g. lexing within a file's work item, and each is timed
+ * inclusively of the phases within it.
+ */
+enum TIME_PHASE {
+    TP_READ_SOURCE,
+    TP_MINIMIZE_SOURCE,
+    TP_CODE_LEXER,
+    TP_PREPROCESSOR_LEXER,
+    TP_BACKTRACKING_LEXER,
+    TP_PARSE_EXPRESSION,
+    TP_SCAN_FILE,
+    TP_PREPROCESS_FILE,
+    TP_COUNT
+};
+
+const char* GetTimePhaseName(TIME_PHASE phase);
+
+/** Read by every timer; only changed while no timer is running. */
+extern bool g_IsTimeProfilingEnabled;
+
+/**
+ * Totals the time spent in each phase, for FormatTimeReport.
+ */
+void EnableTimeReport();
+
+/**
+ * Also records each timed span, with the thread it ran on, for
+ * WriteTimeTrace.
+ */
+void EnableTimeTrace();
+
+/**
+ * Also reads the hardware counters of the running thread where each timed
+ * phase starts and ends, for FormatTimeReport. Where the counters are not
+ * available, the report goes without them.
+ */
+void EnableCounterReport();
+
+/**
+ * Disables profiling and discards everything recorded so far.
+ */
+void ResetTimeProfiler();
+
+/**
+ * Times the scope it lives in. Costs a branch on a global when profiling
+ * is disabled. Allocations made within it count towards its phase in the
+ * allocation profiler.
+ */
+class ScopedTimer {
+public:
+    explicit ScopedTimer(TIME_PHASE phase) :
+        phase{ phase }
+    {
+#if defined(COMBUST_ALLOCATION_PROFILER)
+        previousAllocationPhase = SetAllocationPhase(phase);
+#endif
+        if (g_IsTimeProfilingEnabled)
+            Start();
+    }
+
+    /**
+     * Times the work done for one of the driver's inputs. Spans recorded
+     * on this thread until the timer ends belong to that input's trace.
+     */
+    ScopedTimer(TIME_PHASE phase, size_t input, const std::string& detail);
+
+    ~ScopedTimer() {
+        if (isRunning)
+            Stop();
+#if defined(COMBUST_ALLOCATION_PROFILER)
+        SetAllocationPhase(previousAllocationPhase);
+#endif
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    void Start();
+    void Stop();
+
+    TIME_PHASE  phase;
+    bool        isRunning{ false };
+    bool        isCounting{ false };
+    int64_t     startTime{ 0 };
+    size_t      input{ NO_INPUT };
+    size_t      previousInput{ NO_INPUT };
+    std::string detail{ };
+#if defined(COMBUST_ALLOCATION_PROFILER)
+    unsigned    previousAllocationPhase{ TP_COUNT };
+#endif
+
+    static constexpr size_t NO_INPUT{ SIZE_MAX };
+};
+
+/**
+ * \return a table of the total time spent in, and number of entries to,
+ *         each phase entered so far, summed over all threads, followed by
+ *         their hardware counts if those were read
+ */
+std::string FormatTimeReport();
+
+/**
+ * Writes the spans recorded for an input as Chrome trace-event JSON, with
+ * a track per thread that worked on it.
+ *
+ * \return false if the file cannot be written
+ */
+bool WriteTimeTrace(const std::string& path, size_t input);
+
+#endif
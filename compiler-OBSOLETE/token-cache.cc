@@ -0,0 +1,232 @@
+#if defined(_WIN32)
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+#include "token-cache.hh"
+#include "mapped-file.hh"
+#include "source.hh"
+#include "syntax.hh"
+#include "binary-format.hh"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+/** Bump whenever the layout of an entry changes. */
+constexpr uint32_t TOKEN_CACHE_VERSION{ 1 };
+
+constexpr char TOKEN_CACHE_MAGIC[8]{ 'C', 'M', 'B', 'T', 'O', 'K', 'S', 0 };
+
+/**
+ * An entry is the header followed by, in order: the token records, the
+ * operands (string indices) they refer to, the string table, the line index
+ * and the string data. Every field is stored in host byte order; a cache
+ * written on a machine of the other byte order fails the version check.
+ */
+struct TOKEN_CACHE_HEADER {
+    char     Magic[8];
+    uint32_t Version;
+    uint32_t RecordSize;
+    uint64_t SchemaHash;
+    uint64_t ContentHash;
+    uint64_t ContentSize;
+    uint32_t TokenCount;
+    uint32_t OperandCount;
+    uint32_t StringCount;
+    uint32_t LineCount;
+    uint64_t StringDataSize;
+    uint64_t PayloadHash;
+};
+
+struct TOKEN_CACHE_IMPL {
+    std::string Directory{ };
+};
+
+TokenCache::TokenCache(const std::string& directory) :
+    c{ NewChild<TOKEN_CACHE_IMPL>() }
+{
+    c->Directory = directory;
+
+    if (!c->Directory.empty()) {
+#if defined(_WIN32)
+        _mkdir(c->Directory.c_str());
+#else
+        mkdir(c->Directory.c_str(), 0777);
+#endif
+    }
+}
+
+TokenCache::~TokenCache() {}
+
+std::string TokenCache::GetEntryPath(const std::vector<char>& contents) const {
+    char name[32]{ };
+    snprintf(
+        name,
+        sizeof(name),
+        "%016llx.tok",
+        static_cast<unsigned long long>(HashBytes(contents.data(), contents.size()))
+    );
+
+    if (c->Directory.empty())
+        return name;
+
+    return c->Directory + "/" + name;
+}
+
+bool TokenCache::Store(
+    const SourceFile&                   source,
+    const std::vector<Rc<SyntaxToken>>& tokens
+) {
+    std::vector<TOKEN_RECORD> records{ };
+    std::vector<uint32_t>     operands{ };
+    StringTableBuilder        strings{ };
+
+    records.reserve(tokens.size());
+
+    for (const Rc<SyntaxToken>& token : tokens)
+        records.push_back(EncodeToken(token, strings, operands));
+
+    const std::vector<int>& lineStarts{ source.GetLineStarts() };
+
+    std::string payload{ };
+    AppendBytes(payload, records.data(), records.size() * sizeof(TOKEN_RECORD));
+    AppendBytes(payload, operands.data(), operands.size() * sizeof(uint32_t));
+    AppendBytes(payload, strings.Strings.data(), strings.Strings.size() * sizeof(STRING_RECORD));
+    for (int lineStart : lineStarts) {
+        int32_t value{ lineStart };
+        AppendBytes(payload, &value, sizeof(value));
+    }
+    payload += strings.Data;
+
+    TOKEN_CACHE_HEADER header{ };
+    memcpy(header.Magic, TOKEN_CACHE_MAGIC, sizeof(header.Magic));
+    header.Version        = TOKEN_CACHE_VERSION;
+    header.RecordSize     = sizeof(TOKEN_RECORD);
+    header.SchemaHash     = GetSyntaxSchemaHash();
+    header.ContentHash    = HashBytes(source.Contents.data(), source.Contents.size());
+    header.ContentSize    = source.Contents.size();
+    header.TokenCount     = static_cast<uint32_t>(records.size());
+    header.OperandCount   = static_cast<uint32_t>(operands.size());
+    header.StringCount    = static_cast<uint32_t>(strings.Strings.size());
+    header.LineCount      = static_cast<uint32_t>(lineStarts.size());
+    header.StringDataSize = strings.Data.size();
+    header.PayloadHash    = HashBytes(payload.data(), payload.size());
+
+    std::string entry{ };
+    AppendBytes(entry, &header, sizeof(header));
+    entry += payload;
+
+    return ReplaceFile(GetEntryPath(source.Contents), entry);
+}
+
+Rc<SourceFile> TokenCache::Load(
+    const std::string&                name,
+    const std::vector<char>&          contents,
+    OUT std::vector<Rc<SyntaxToken>>& tokens
+) {
+    tokens.clear();
+
+    Rc<MappedFile> file{ OpenMappedFile(GetEntryPath(contents)) };
+    if (file == nullptr || file->GetSize() < sizeof(TOKEN_CACHE_HEADER))
+        return Rc<SourceFile>{ };
+
+    TOKEN_CACHE_HEADER header{ };
+    memcpy(&header, file->GetData(), sizeof(header));
+
+    if (memcmp(header.Magic, TOKEN_CACHE_MAGIC, sizeof(header.Magic)) != 0
+        || header.Version != TOKEN_CACHE_VERSION
+        || header.RecordSize != sizeof(TOKEN_RECORD)
+        || header.SchemaHash != GetSyntaxSchemaHash()
+        || header.ContentSize != contents.size()
+        || header.ContentHash != HashBytes(contents.data(), contents.size()))
+        return Rc<SourceFile>{ };
+
+    uint64_t recordsSize{ uint64_t{ header.TokenCount } * sizeof(TOKEN_RECORD) };
+    uint64_t operandsSize{ uint64_t{ header.OperandCount } * sizeof(uint32_t) };
+    uint64_t stringsSize{ uint64_t{ header.StringCount } * sizeof(STRING_RECORD) };
+    uint64_t linesSize{ uint64_t{ header.LineCount } * sizeof(int32_t) };
+    uint64_t payloadSize{ file->GetSize() - sizeof(TOKEN_CACHE_HEADER) };
+
+    if (header.StringDataSize > payloadSize
+        || recordsSize + operandsSize + stringsSize + linesSize + header.StringDataSize != payloadSize)
+        return Rc<SourceFile>{ };
+
+    const char* payload{ file->GetData() + sizeof(TOKEN_CACHE_HEADER) };
+    if (HashBytes(payload, payloadSize) != header.PayloadHash)
+        return Rc<SourceFile>{ };
+
+    const char* recordData{ payload };
+    const char* operandData{ recordData + recordsSize };
+    const char* stringData{ operandData + operandsSize };
+    const char* lineData{ stringData + stringsSize };
+    const char* characterData{ lineData + linesSize };
+
+    std::vector<int> lineStarts(header.LineCount);
+    for (uint32_t i{ 0 }; i < header.LineCount; ++i) {
+        int32_t lineStart{ };
+        memcpy(&lineStart, lineData + i * sizeof(int32_t), sizeof(lineStart));
+
+        if (lineStart < (i == 0 ? 0 : lineStarts[i - 1] + 1)
+            || static_cast<uint64_t>(lineStart) > contents.size())
+            return Rc<SourceFile>{ };
+        lineStarts[i] = lineStart;
+    }
+    if (lineStarts.empty() || lineStarts[0] != 0)
+        return Rc<SourceFile>{ };
+
+    std::vector<std::string> strings{ };
+    if (!ReadStringTable(stringData, header.StringCount, characterData, header.StringDataSize, strings))
+        return Rc<SourceFile>{ };
+
+    std::vector<uint32_t> operands(header.OperandCount);
+    if (!operands.empty())
+        memcpy(operands.data(), operandData, operandsSize);
+    for (uint32_t operand : operands) {
+        if (operand >= header.StringCount)
+            return Rc<SourceFile>{ };
+    }
+
+    Rc<SourceFile> source{ NewObj<SourceFile>(name, contents, lineStarts) };
+
+    tokens.reserve(header.TokenCount);
+
+    for (uint32_t i{ 0 }; i < header.TokenCount; ++i) {
+        TOKEN_RECORD record{ };
+        memcpy(&record, recordData + i * sizeof(TOKEN_RECORD), sizeof(record));
+
+        if (!IsValidTokenRecord(record, header.OperandCount)
+            || static_cast<uint32_t>(record.Line) >= header.LineCount) {
+            tokens.clear();
+            return Rc<SourceFile>{ };
+        }
+
+        Rc<SyntaxToken> token{ DecodeToken(record, operands.data(), strings) };
+
+        SourceRange range{ token->GetLexemeRange() };
+        range.Location.Source = source;
+
+        token->SetLexemeRange(range);
+        tokens.push_back(token);
+    }
+
+    return source;
+}
+
+TokenListLexer::TokenListLexer(const std::vector<Rc<SyntaxToken>>& tokens) :
+    tokens{ tokens }
+{ }
+
+TokenListLexer::~TokenListLexer() {}
+
+Rc<SyntaxToken> TokenListLexer::ReadToken() {
+    if (tokens.empty())
+        return Rc<SyntaxToken>{ };
+
+    if (position < tokens.size())
+        return tokens[position++];
+
+    return tokens.back();
+}
@@ -0,0 +1,74 @@
+#ifndef COMBUST_TOKEN_CACHE_HH
+#define COMBUST_TOKEN_CACHE_HH
+#include "common.hh"
+#include "lexer.hh"
+#include <string>
+#include <vector>
+
+class SourceFile;
+class SyntaxToken;
+
+struct TOKEN_CACHE_IMPL;
+
+/**
+ * On-disk cache of lexed token streams, keyed by a hash of the lexed
+ * contents. Each entry holds fixed-size token records, the strings they
+ * refer to and the file's line index, and is mapped back in on a hit.
+ *
+ * Entries carry a format version, the syntax kind layout they were written
+ * with and a checksum; an entry that does not match in every respect is
+ * treated as a miss, so callers fall back to lexing.
+ */
+class TokenCache : public Object {
+public:
+    explicit TokenCache(const std::string& directory);
+    virtual ~TokenCache();
+
+    /**
+     * Looks up the tokens of contents read earlier with ReadSourceContents.
+     *
+     * \return the source file the loaded tokens point into, or nullptr if
+     *         there is no valid entry for contents
+     */
+    Rc<SourceFile> Load(
+        const std::string&                 name,
+        const std::vector<char>&           contents,
+        OUT std::vector<Rc<SyntaxToken>>&  tokens
+    );
+
+    /**
+     * Writes the tokens lexed from source, replacing any previous entry.
+     *
+     * \return false if the entry cannot be written
+     */
+    bool Store(
+        const SourceFile&                   source,
+        const std::vector<Rc<SyntaxToken>>& tokens
+    );
+
+    /**
+     * \return the path of the entry for contents
+     */
+    std::string GetEntryPath(const std::vector<char>& contents) const;
+
+private:
+    Owner<TOKEN_CACHE_IMPL> c;
+};
+
+/**
+ * Replays a token stream, such as one loaded from a TokenCache. Once the
+ * stream is exhausted its last token (normally EofToken) is returned again.
+ */
+class TokenListLexer : public ILexer {
+public:
+    explicit TokenListLexer(const std::vector<Rc<SyntaxToken>>& tokens);
+    virtual ~TokenListLexer();
+
+    Rc<SyntaxToken> ReadToken() override;
+
+private:
+    std::vector<Rc<SyntaxToken>> tokens;
+    size_t                       position{ 0 };
+};
+
+#endif
@@ -0,0 +1,85 @@
+#include <catch.hpp>
+#include "../allocation-profiler.hh"
+#include "../code-lexer.hh"
+#include "../source.hh"
+#include "../syntax.hh"
+#include "../time-profiler.hh"
+#include <typeinfo>
+
+// Without the profiler every count is 0; make check also builds the tests
+// with it.
+#if defined(COMBUST_ALLOCATION_PROFILER)
+
+/** Lexing tests/lexer.c, 4699 tokens, takes one object per token and a few more. */
+static const uint64_t LEXER_TEST_ALLOCATION_BUDGET{ 5000 };
+
+struct AllocationTestObject : public Object {
+    int Value{ 0 };
+};
+
+struct UnallocatedTestObject { };
+
+static int CountTokens(const Rc<SourceFile>& sourceFile) {
+    Rc<CodeLexer> lexer{ NewObj<CodeLexer>(sourceFile) };
+    int count{ 0 };
+
+    while (!IsSyntaxNode<EofToken>(lexer->ReadToken()))
+        ++count;
+
+    return count;
+}
+
+TEST_CASE("AllocationProfiler LexerBudget") {
+    Rc<SourceFile> sourceFile{ OpenSourceFile("tests/lexer.c") };
+    REQUIRE(sourceFile);
+
+    AllocationStats before{ GetAllocationStats() };
+    int tokenCount{ CountTokens(sourceFile) };
+    AllocationStats after{ GetAllocationStats() };
+
+    uint64_t count{ after.Count - before.Count };
+    INFO(count << " allocations for " << tokenCount << " tokens");
+    REQUIRE(count > static_cast<uint64_t>(tokenCount));
+    REQUIRE(count < LEXER_TEST_ALLOCATION_BUDGET);
+}
+
+TEST_CASE("AllocationProfiler PerType") {
+    AllocationStats before{ GetAllocationStats(typeid(EofToken)) };
+    Rc<SourceFile> sourceFile{ CreateSourceFile("", "a b c") };
+    CountTokens(sourceFile);
+    AllocationStats after{ GetAllocationStats(typeid(EofToken)) };
+
+    REQUIRE(after.Count == before.Count + 1);
+    REQUIRE(after.Bytes >= before.Bytes + sizeof(EofToken));
+    REQUIRE(GetAllocationStats(typeid(UnallocatedTestObject)).Count == 0);
+}
+
+TEST_CASE("AllocationProfiler PerPhase") {
+    AllocationStats before{ GetAllocationStats(TP_PARSE_EXPRESSION) };
+
+    {
+        ScopedTimer timer{ TP_PARSE_EXPRESSION };
+        Rc<AllocationTestObject> object{ NewObj<AllocationTestObject>() };
+    }
+
+    Rc<AllocationTestObject> object{ NewObj<AllocationTestObject>() };
+    AllocationStats after{ GetAllocationStats(TP_PARSE_EXPRESSION) };
+
+    REQUIRE(after.Count == before.Count + 1);
+}
+
+TEST_CASE("AllocationProfiler LiveBytes") {
+    ResetPeakLiveBytes();
+    int64_t live{ GetLiveBytes() };
+
+    {
+        Owner<AllocationTestObject> object{ NewChild<AllocationTestObject>() };
+        REQUIRE(GetLiveBytes() == live + static_cast<int64_t>(sizeof(AllocationTestObject)));
+    }
+
+    REQUIRE(GetLiveBytes() == live);
+    REQUIRE(GetPeakLiveBytes() >= live + static_cast<int64_t>(sizeof(AllocationTestObject)));
+    REQUIRE(FormatAllocationReport().find("AllocationTestObject") != std::string::npos);
+}
+
+#endif
@@ -0,0 +1,194 @@
+#include <catch.hpp>
+#include "../backtracking-lexer.hh"
+#include "../code-lexer.hh"
+#include "../lexer.hh"
+#include "../source.hh"
+#include "../syntax.hh"
+#include "../token-cache.hh"
+
+/**
+ * Produces count identifiers and then EofToken, counting the reads.
+ */
+class CountingLexer : public ILexer {
+public:
+    explicit CountingLexer(int count) : count{ count } {}
+
+    Rc<SyntaxToken> ReadToken() override {
+        ++ReadCount;
+        if (ReadCount > count)
+            return NewObj<EofToken>();
+
+        Rc<IdentifierToken> token{ NewObj<IdentifierToken>() };
+        token->SetName("t" + std::to_string(ReadCount - 1));
+        return token;
+    }
+
+    int ReadCount{ 0 };
+
+private:
+    int count{ 0 };
+};
+
+static std::string GetName(const Rc<SyntaxToken>& token) {
+    return As<IdentifierToken>(token)->GetName();
+}
+
+TEST_CASE("BacktrackingLexer Streaming ReadsOnDemand") {
+    Rc<CountingLexer> source{ NewObj<CountingLexer>(10) };
+    BacktrackingLexer lexer{ source, BLM_STREAMING };
+    REQUIRE(source->ReadCount == 0);
+
+    REQUIRE(GetName(lexer.PeekToken()) == "t0");
+    REQUIRE(source->ReadCount == 1);
+
+    REQUIRE(GetName(lexer.ReadToken()) == "t0");
+    REQUIRE(GetName(lexer.ReadToken()) == "t1");
+    REQUIRE(source->ReadCount == 2);
+}
+
+TEST_CASE("BacktrackingLexer Streaming Backtrack") {
+    BacktrackingLexer lexer{ NewObj<CountingLexer>(10), BLM_STREAMING };
+    lexer.ReadToken();
+
+    {
+        BacktrackingLexer::Marker marker{ lexer.Mark() };
+        for (int i{ 0 }; i < 5; ++i)
+            lexer.ReadToken();
+        REQUIRE(lexer.GetBufferedTokenCount() >= 5);
+
+        lexer.Backtrack(marker);
+        REQUIRE(GetName(lexer.ReadToken()) == "t1");
+    }
+
+    REQUIRE(lexer.GetBufferedTokenCount() <= 5);
+    REQUIRE(GetName(lexer.ReadToken()) == "t2");
+}
+
+TEST_CASE("BacktrackingLexer Streaming BoundedWindow") {
+    BacktrackingLexer lexer{ NewObj<CountingLexer>(100000), BLM_STREAMING };
+
+    Rc<SyntaxToken> token{ };
+    size_t maxBuffered{ 0 };
+    do {
+        BacktrackingLexer::Marker marker{ lexer.Mark() };
+        token = lexer.ReadToken();
+        if (lexer.GetBufferedTokenCount() > maxBuffered)
+            maxBuffered = lexer.GetBufferedTokenCount();
+    }
+    while (token->GetKind() != SK_EofToken);
+
+    REQUIRE(maxBuffered <= 2);
+    REQUIRE(lexer.ReadToken()->GetKind() == SK_EofToken);
+}
+
+TEST_CASE("BacktrackingLexer Streaming OutOfOrderRelease") {
+    BacktrackingLexer lexer{ NewObj<CountingLexer>(10), BLM_STREAMING };
+
+    BacktrackingLexer::Marker first{ lexer.Mark() };
+    lexer.ReadToken();
+    BacktrackingLexer::Marker second{ lexer.Mark() };
+    lexer.ReadToken();
+    BacktrackingLexer::Marker third{ lexer.Mark() };
+    lexer.ReadToken();
+
+    // Assigning over the oldest marker releases it first.
+    first = lexer.Mark();
+    lexer.Backtrack(second);
+    REQUIRE(GetName(lexer.ReadToken()) == "t1");
+
+    // Only the token before the second marker may go.
+    for (int i{ 0 }; i < 5; ++i)
+        lexer.ReadToken();
+    REQUIRE(lexer.GetBufferedTokenCount() == 6);
+
+    lexer.Backtrack(second);
+    REQUIRE(GetName(lexer.ReadToken()) == "t1");
+}
+
+TEST_CASE("BacktrackingLexer Eager ReadsEverything") {
+    Rc<CountingLexer> source{ NewObj<CountingLexer>(10) };
+    BacktrackingLexer lexer{ source };
+    REQUIRE(source->ReadCount == 11);
+
+    BacktrackingLexer::Marker marker{ lexer.Mark() };
+    for (int i{ 0 }; i < 20; ++i)
+        lexer.ReadToken();
+    REQUIRE(lexer.PeekToken()->GetKind() == SK_EofToken);
+
+    lexer.Backtrack(marker);
+    REQUIRE(GetName(lexer.PeekToken()) == "t0");
+}
+
+TEST_CASE("BacktrackingLexer AcceptAnyOf") {
+    BacktrackingLexer lexer{ NewObj<CountingLexer>(1) };
+
+    REQUIRE(!lexer.Accept<PlusSymbol, MinusSymbol, EofToken>());
+    REQUIRE(lexer.Accept<PlusSymbol, IdentifierToken>());
+    REQUIRE(lexer.Accept<PlusSymbol, MinusSymbol, EofToken>());
+}
+
+TEST_CASE("BacktrackingLexer ExpectMissing") {
+    BacktrackingLexer lexer{ NewObj<CountingLexer>(1) };
+
+    Rc<SyntaxToken> missing{ lexer.Expect<SemicolonSymbol>() };
+    REQUIRE(missing->GetKind() == SK_SemicolonSymbol);
+    REQUIRE(missing->HasFlag(SyntaxToken::IS_MISSING));
+    REQUIRE(missing->IsShared());
+    REQUIRE(lexer.GetPosition() == 0);
+
+    // Failing again allocates nothing: the placeholder is reused.
+    REQUIRE(lexer.Expect<SemicolonSymbol>() == missing);
+
+    Rc<SyntaxToken> present{ lexer.Expect<IdentifierToken>() };
+    REQUIRE(!present->HasFlag(SyntaxToken::IS_MISSING));
+    REQUIRE(lexer.Materialize<IdentifierToken>(present) == present);
+}
+
+TEST_CASE("BacktrackingLexer ExpectMissing MaterializeInArenaAtNextToken") {
+    Rc<SyntaxArena> arena{ NewObj<SyntaxArena>() };
+    Rc<SourceFile> sourceFile{ CreateSourceFile("", "a\n  b") };
+    BacktrackingLexer lexer{ NewObj<CodeLexer>(sourceFile), BLM_EAGER, arena };
+    REQUIRE(lexer.Expect<IdentifierToken>());
+
+    Rc<SyntaxToken> missing{ lexer.Materialize<SemicolonSymbol>(lexer.Expect<SemicolonSymbol>()) };
+    REQUIRE(missing->GetKind() == SK_SemicolonSymbol);
+    REQUIRE(missing->HasFlag(SyntaxToken::IS_MISSING));
+    REQUIRE(missing->GetArena() == arena.get());
+    REQUIRE(missing->GetLexemeRange().Length == 0);
+
+    const SourceLoc& location{ missing->GetLexemeRange().Location };
+    const SourceLoc& next{ lexer.PeekToken()->GetLexemeRange().Location };
+    REQUIRE(location.Source == sourceFile);
+    REQUIRE(location.Line == next.Line);
+    REQUIRE(location.Column == next.Column);
+}
+
+static Rc<BacktrackingLexer> LexKinds(std::initializer_list<SYNTAX_KIND> kinds) {
+    std::vector<Rc<SyntaxToken>> tokens{ };
+    for (SYNTAX_KIND kind : kinds)
+        tokens.push_back(NewSyntaxToken(kind));
+    tokens.push_back(NewSyntaxToken(SK_EofToken));
+
+    return NewObj<BacktrackingLexer>(NewObj<TokenListLexer>(tokens), BLM_STREAMING);
+}
+
+TEST_CASE("BacktrackingLexer SkipBalanced Nested") {
+    Rc<BacktrackingLexer> lexer{ LexKinds({
+        SK_LBraceSymbol, SK_LBraceSymbol, SK_RBraceSymbol, SK_RParenSymbol, SK_RBraceSymbol, SK_SemicolonSymbol
+    }) };
+
+    REQUIRE(lexer->SkipBalanced());
+    REQUIRE(lexer->GetPosition() == 5);
+    REQUIRE(lexer->PeekKind() == SK_SemicolonSymbol);
+}
+
+TEST_CASE("BacktrackingLexer SkipBalanced Unbalanced") {
+    Rc<BacktrackingLexer> lexer{ LexKinds({ SK_LParenSymbol, SK_LParenSymbol, SK_RParenSymbol }) };
+    REQUIRE(!lexer->SkipBalanced());
+    REQUIRE(lexer->GetPosition() == 0);
+
+    lexer->ReadToken();
+    REQUIRE(lexer->SkipBalanced());
+    REQUIRE(lexer->PeekKind() == SK_EofToken);
+    REQUIRE(!lexer->SkipBalanced());
+}
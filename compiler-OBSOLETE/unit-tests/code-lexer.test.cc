@@ -2,6 +2,7 @@
 #include "../code-lexer.hh"
 #include "../source.hh"
 #include "../syntax.hh"
+#include "../syntax-arena.hh"
 
 TEST_CASE("CodeLexer EmptyFile") {
     Rc<SourceFile> sourceFile{ CreateSourceFile("", "") };
@@ -823,3 +824,19 @@ TEST_CASE("CodeLexer PipePipeSymbol") {
     Rc<SyntaxToken> token{ lexer->ReadToken() };
     REQUIRE(IsSyntaxNode<PipePipeSymbol>(token));
 }
+
+TEST_CASE("CodeLexer TokensInArena") {
+    Rc<SourceFile> sourceFile{ CreateSourceFile("", "int x = 1;") };
+    Rc<SyntaxArena> arena{ NewObj<SyntaxArena>() };
+    Rc<CodeLexer> lexer{ NewObj<CodeLexer>(sourceFile, arena) };
+
+    Rc<SyntaxToken> token{ lexer->ReadToken() };
+    REQUIRE(IsSyntaxNode<IntKeyword>(token));
+    REQUIRE(token->GetArena() == arena.get());
+
+    lexer.reset();
+    REQUIRE(arena.use_count() == 2);
+
+    token.reset();
+    REQUIRE(arena.use_count() == 1);
+}
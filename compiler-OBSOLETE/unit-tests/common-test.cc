@@ -0,0 +1,104 @@
+#include <catch.hpp>
+#include "../common.hh"
+#include "../parallel.hh"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+/**
+ * Sets a flag when destroyed.
+ */
+class Tracked : public Object {
+public:
+    explicit Tracked(bool* isDestroyed) : isDestroyed{ isDestroyed } {}
+    virtual ~Tracked() { *isDestroyed = true; }
+
+private:
+    bool* isDestroyed;
+};
+
+class DerivedTracked : public Tracked {
+public:
+    explicit DerivedTracked(bool* isDestroyed) : Tracked{ isDestroyed } {}
+};
+
+TEST_CASE("Rc ReleasesLastReference") {
+    bool isDestroyed{ false };
+    Rc<Tracked> first{ NewObj<Tracked>(&isDestroyed) };
+    REQUIRE(first.use_count() == 1);
+
+    {
+        Rc<Tracked> second{ first };
+        REQUIRE(first.use_count() == 2);
+        Rc<Tracked> third{ std::move(second) };
+        REQUIRE(first.use_count() == 2);
+        REQUIRE(second == nullptr);
+    }
+
+    REQUIRE(first.use_count() == 1);
+    first.reset();
+    REQUIRE(isDestroyed);
+}
+
+TEST_CASE("Rc ConvertsBetweenBaseAndDerived") {
+    bool isDestroyed{ false };
+    Rc<DerivedTracked> derived{ NewObj<DerivedTracked>(&isDestroyed) };
+    Rc<Object> object{ derived };
+    Rc<const Tracked> base{ derived };
+
+    REQUIRE(object == derived);
+    REQUIRE(As<DerivedTracked>(object) == derived);
+    REQUIRE(derived.use_count() == 3);
+
+    derived.reset();
+    base.reset();
+    REQUIRE(!isDestroyed);
+    object.reset();
+    REQUIRE(isDestroyed);
+}
+
+TEST_CASE("Rc SharedAcrossThreads") {
+    bool isDestroyed{ false };
+    Rc<Tracked> object{ NewObj<Tracked>(&isDestroyed) };
+    REQUIRE(!object->IsShared());
+
+    object->MarkShared();
+    REQUIRE(object->IsShared());
+
+    ParallelFor(16, 4, [&](size_t) {
+        for (int i{ 0 }; i < 10000; ++i) {
+            Rc<Tracked> copy{ object };
+            Rc<Object> other{ copy };
+        }
+    });
+
+    REQUIRE(object.use_count() == 1);
+    object.reset();
+    REQUIRE(isDestroyed);
+}
+
+TEST_CASE("ParallelFor StealsFromBusyWorkers") {
+    constexpr size_t COUNT{ 64 };
+    std::atomic<int> calls[COUNT]{ };
+    std::atomic<unsigned> workers[COUNT]{ };
+
+    // Thread 0 starts with indices 0 to 15 and is held up by the first, so
+    // the others must take the rest of its share.
+    ParallelForWithWorker(COUNT, 4, [&](size_t index, unsigned worker) {
+        if (index == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds{ 200 });
+
+        ++calls[index];
+        workers[index] = worker;
+    });
+
+    for (size_t i{ 0 }; i < COUNT; ++i)
+        REQUIRE(calls[i] == 1);
+
+    size_t stolen{ 0 };
+    for (size_t i{ 1 }; i < COUNT / 4; ++i) {
+        if (workers[i] != 0)
+            ++stolen;
+    }
+    REQUIRE(stolen > 0);
+}
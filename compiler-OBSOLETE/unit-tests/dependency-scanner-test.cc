@@ -0,0 +1,204 @@
+#include <catch.hpp>
+#include "../dependency-scanner.hh"
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+using Dependencies = std::vector<std::string>;
+
+TEST_CASE("DependencyScanner NoIncludes") {
+    DependencyScanner scanner{ { } };
+    scanner.AddVirtualFile("main.c", "int main(void) { return 0; }");
+
+    ScanResult result{ scanner.ScanFile("main.c") };
+    REQUIRE(result.Succeeded);
+    REQUIRE(result.Dependencies == Dependencies{ "main.c" });
+}
+
+TEST_CASE("DependencyScanner QuotedAndAngledIncludes") {
+    DependencyScanner scanner{ { "include" } };
+    scanner.AddVirtualFile("src/main.c", "#include \"local.h\"\n#include <system.h>\n");
+    scanner.AddVirtualFile("src/local.h", "");
+    scanner.AddVirtualFile("include/system.h", "");
+
+    ScanResult result{ scanner.ScanFile("src/main.c") };
+    REQUIRE(result.Succeeded);
+    REQUIRE(result.Dependencies == Dependencies{ "src/main.c", "src/local.h", "include/system.h" });
+}
+
+TEST_CASE("DependencyScanner MissingInclude") {
+    DependencyScanner scanner{ { } };
+    scanner.AddVirtualFile("main.c", "#include \"missing.h\"\n");
+
+    ScanResult result{ scanner.ScanFile("main.c") };
+    REQUIRE(!result.Succeeded);
+    REQUIRE(result.Diagnostics.size() == 1);
+}
+
+TEST_CASE("DependencyScanner InactiveBlocksAreSkipped") {
+    DependencyScanner scanner{ { } };
+    scanner.AddVirtualFile(
+        "main.c",
+        "#define USE_B 1\n"
+        "#ifdef USE_A\n"
+        "#include \"a.h\"\n"
+        "#elif USE_B && !defined(USE_C)\n"
+        "#include \"b.h\"\n"
+        "#else\n"
+        "#include \"c.h\"\n"
+        "#endif\n"
+        "#if 0\n"
+        "#include \"missing.h\"\n"
+        "#endif\n"
+    );
+    scanner.AddVirtualFile("b.h", "");
+
+    ScanResult result{ scanner.ScanFile("main.c") };
+    REQUIRE(result.Succeeded);
+    REQUIRE(result.Dependencies == Dependencies{ "main.c", "b.h" });
+}
+
+TEST_CASE("DependencyScanner IncludeGuardAndPragmaOnce") {
+    DependencyScanner scanner{ { } };
+    scanner.AddVirtualFile(
+        "main.c",
+        "#include \"guarded.h\"\n"
+        "#include \"once.h\"\n"
+        "#include \"guarded.h\"\n"
+        "#include \"once.h\"\n"
+    );
+    scanner.AddVirtualFile(
+        "guarded.h",
+        "/* comment */\n#ifndef GUARDED_H\n#define GUARDED_H\n#include \"inner.h\"\n#endif\n"
+    );
+    scanner.AddVirtualFile(
+        "once.h",
+        "#pragma once\n#ifdef ONCE_H\n#error included twice\n#endif\n#define ONCE_H\n"
+    );
+    scanner.AddVirtualFile("inner.h", "");
+
+    ScanResult result{ scanner.ScanFile("main.c") };
+    REQUIRE(result.Succeeded);
+    REQUIRE(result.Dependencies == Dependencies{ "main.c", "guarded.h", "inner.h", "once.h" });
+}
+
+TEST_CASE("DependencyScanner GuardWithElseIsRescanned") {
+    DependencyScanner scanner{ { } };
+    scanner.AddVirtualFile(
+        "main.c",
+        "#include \"guarded.h\"\n"
+        "#define GUARDED_H\n"
+        "#include \"guarded.h\"\n"
+    );
+    scanner.AddVirtualFile(
+        "guarded.h",
+        "#ifndef GUARDED_H\n#define OTHER_H\n#else\n#include \"else.h\"\n#endif\n"
+    );
+    scanner.AddVirtualFile("else.h", "");
+
+    ScanResult result{ scanner.ScanFile("main.c") };
+    REQUIRE(result.Succeeded);
+    REQUIRE(result.Dependencies == Dependencies{ "main.c", "guarded.h", "else.h" });
+}
+
+TEST_CASE("DependencyScanner ShortCircuitedOperandsAreNotEvaluated") {
+    const char* const conditions[]{
+        "!(N != 0 && 10 / N > 2)",
+        "N == 0 || 10 % N",
+        "defined(N) ? 1 : 1 / N",
+        "!defined(N) ? DIVIDE : 1"
+    };
+
+    for (const char* condition : conditions) {
+        DependencyScanner scanner{ { } };
+        scanner.AddVirtualFile(
+            "main.c",
+            std::string{ "#define N 0\n#define DIVIDE 1 / N\n#if " } + condition + "\n#include \"b.h\"\n#endif\n"
+        );
+        scanner.AddVirtualFile("b.h", "");
+
+        ScanResult result{ scanner.ScanFile("main.c") };
+        INFO(condition);
+        REQUIRE(result.Succeeded);
+        REQUIRE(result.Diagnostics.empty());
+        REQUIRE(result.Dependencies == Dependencies{ "main.c", "b.h" });
+    }
+
+    DependencyScanner scanner{ { } };
+    scanner.AddVirtualFile("main.c", "#define N 0\n#if N == 0 && 10 / N\n#endif\n");
+
+    ScanResult result{ scanner.ScanFile("main.c") };
+    REQUIRE(!result.Succeeded);
+    REQUIRE(result.Diagnostics.size() == 1);
+}
+
+static const char* const TEST_PCH_FILE{ "dependency-scanner-test.pch" };
+
+static void AddPreludeFiles(DependencyScanner& scanner) {
+    scanner.AddVirtualFile(
+        "prelude.h",
+        "#ifndef PRELUDE_H\n#define PRELUDE_H\n#include \"config.h\"\n#define FEATURE_LEVEL (2 + 1)\n#endif\n"
+    );
+    scanner.AddVirtualFile("config.h", "#pragma once\n#define HAS_FEATURE(x) 0\n#define USE_FAST 1\n");
+}
+
+TEST_CASE("DependencyScanner PrecompiledHeader") {
+    DependencyScanner emitter{ { } };
+    AddPreludeFiles(emitter);
+
+    ScanResult emitted{ emitter.WritePrecompiledHeader("prelude.h", TEST_PCH_FILE) };
+    REQUIRE(emitted.Succeeded);
+    REQUIRE(emitted.Dependencies == Dependencies{ "prelude.h", "config.h" });
+
+    // The prelude's headers deliberately do not exist for this scanner:
+    // everything it needs about them has to come from the snapshot.
+    DependencyScanner scanner{ { } };
+    bool isLoaded{ scanner.LoadPrecompiledHeader(TEST_PCH_FILE) };
+    remove(TEST_PCH_FILE);
+    REQUIRE(isLoaded);
+
+    scanner.AddVirtualFile("prelude.h", "#error prelude.h was rescanned\n");
+    scanner.AddVirtualFile("config.h", "#error config.h was rescanned\n");
+    scanner.AddVirtualFile(
+        "main.c",
+        "#include \"prelude.h\"\n"
+        "#include \"config.h\"\n"
+        "#if FEATURE_LEVEL == 3 && USE_FAST\n"
+        "#include \"fast.h\"\n"
+        "#endif\n"
+        "#undef USE_FAST\n"
+        "#ifdef USE_FAST\n"
+        "#include \"missing.h\"\n"
+        "#endif\n"
+    );
+    scanner.AddVirtualFile("fast.h", "");
+
+    ScanResult result{ scanner.ScanFile("main.c") };
+    REQUIRE(result.Succeeded);
+    REQUIRE(result.Dependencies == Dependencies{ "main.c", TEST_PCH_FILE, "prelude.h", "config.h", "fast.h" });
+}
+
+TEST_CASE("DependencyScanner PrecompiledHeaderMismatch") {
+    DependencyScanner emitter{ { } };
+    AddPreludeFiles(emitter);
+    REQUIRE(emitter.WritePrecompiledHeader("prelude.h", TEST_PCH_FILE).Succeeded);
+
+    DependencyScanner otherPaths{ { "include" } };
+    REQUIRE(!otherPaths.LoadPrecompiledHeader(TEST_PCH_FILE));
+
+    FILE* file{ fopen(TEST_PCH_FILE, "r+b") };
+    REQUIRE(file != nullptr);
+    fseek(file, -1, SEEK_END);
+    fputc('!', file);
+    fclose(file);
+
+    DependencyScanner corrupt{ { } };
+    bool isLoaded{ corrupt.LoadPrecompiledHeader(TEST_PCH_FILE) };
+    remove(TEST_PCH_FILE);
+    REQUIRE(!isLoaded);
+}
+
+TEST_CASE("DependencyScanner FormatMakeRule") {
+    REQUIRE(FormatMakeRule("main.o", { "main.c", "a b.h" }) == "main.o: main.c a\\ b.h\n");
+    REQUIRE(GetObjectFileName("src/main.c") == "main.o");
+}
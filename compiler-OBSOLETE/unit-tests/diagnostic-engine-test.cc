@@ -0,0 +1,284 @@
+#include <catch.hpp>
+#include "../backtracking-lexer.hh"
+#include "../code-lexer.hh"
+#include "../diagnostic-engine.hh"
+#include "../language-parser.hh"
+#include "../parallel.hh"
+#include "../source.hh"
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/**
+ * \return everything written to file so far
+ */
+static std::string ReadBack(FILE* file) {
+    std::string contents{ };
+    rewind(file);
+
+    for (int c{ fgetc(file) }; c != EOF; c = fgetc(file))
+        contents += static_cast<char>(c);
+
+    return contents;
+}
+
+static size_t CountOccurrences(const std::string& text, const std::string& pattern) {
+    size_t count{ 0 };
+    for (size_t at{ text.find(pattern) }; at != std::string::npos; at = text.find(pattern, at + 1))
+        ++count;
+    return count;
+}
+
+TEST_CASE("DiagnosticEngine SourceExcerpt") {
+    Rc<SourceFile> sourceFile{ CreateSourceFile("a.c", "int x;\nfoo = bar;\n") };
+    SourceRange range{ SourceLoc{ sourceFile, 1, 6 }, 3 };
+
+    DiagnosticBuffer buffer{ };
+    buffer.Report(DK_SCAN_WARNING, &range, "unknown name 'bar'");
+
+    std::string text{ buffer.Format() };
+    REQUIRE(text.find("a.c:2:7: ") != std::string::npos);
+    REQUIRE(text.find("warning: ") != std::string::npos);
+    REQUIRE(text.find("unknown name 'bar'\nfoo = bar;\n      ^~~\n") != std::string::npos);
+    REQUIRE(buffer.GetWarningCount() == 1);
+    REQUIRE(buffer.GetErrorCount() == 0);
+}
+
+TEST_CASE("DiagnosticEngine LongMessage") {
+    std::string name(1000, 'n');
+
+    DiagnosticBuffer buffer{ };
+    buffer.Report(DK_SCAN_ERROR, nullptr, "bad name " + name + ".");
+
+    REQUIRE(buffer.Format().find(name + ".\n") != std::string::npos);
+    REQUIRE(buffer.GetErrorCount() == 1);
+}
+
+TEST_CASE("DiagnosticEngine ArgumentsFormattedLate") {
+    DiagnosticBuffer buffer{ };
+    buffer.Report(DK_PRODUCTION_MISMATCH, nullptr, 1, 2u, static_cast<size_t>(3));
+
+    DiagnosticBuffer other{ };
+    other.Report(DK_CANNOT_OPEN_FILE, nullptr, std::string{ "b.c" });
+    buffer.Append(other);
+
+    REQUIRE(other.IsEmpty());
+    REQUIRE(buffer.GetRecords().size() == 2);
+    REQUIRE(buffer.GetErrorCount() == 2);
+
+    std::string text{ buffer.Format() };
+    REQUIRE(text.find("syntax node of kind 1 recorded as production 2 but shaped like 3\n") != std::string::npos);
+    REQUIRE(text.find("cannot open b.c\n") != std::string::npos);
+}
+
+TEST_CASE("DiagnosticEngine ErrorLimit") {
+    FILE* output{ tmpfile() };
+    REQUIRE(output != nullptr);
+
+    DiagnosticEngine engine{ output };
+    engine.SetErrorLimit(3);
+
+    std::vector<DiagnosticBuffer> buffers(10);
+    for (size_t i{ 0 }; i < buffers.size(); ++i)
+        buffers[i].Report(DK_SCAN_ERROR, nullptr, "error " + std::to_string(i));
+
+    for (DiagnosticBuffer& buffer : buffers)
+        engine.Flush(buffer);
+
+    // Once the limit is reached, a buffer that knows its engine drops
+    // errors without storing them.
+    DiagnosticBuffer late{ &engine };
+    late.Report(DK_SCAN_ERROR, nullptr, "error 10");
+    REQUIRE(late.GetRecords().empty());
+    engine.Flush(late);
+
+    engine.Report(DK_CANNOT_OPEN_FILE, nullptr, "x.c");
+    engine.ReportSummary();
+
+    std::string text{ ReadBack(output) };
+    fclose(output);
+
+    REQUIRE(CountOccurrences(text, "error ") == 3);
+    REQUIRE(text.find("error 2\n") != std::string::npos);
+    REQUIRE(text.find("error 3\n") == std::string::npos);
+    REQUIRE(text.find("cannot open x.c") != std::string::npos);
+    REQUIRE(text.find("8 more errors not shown (-ferror-limit=3)") != std::string::npos);
+
+    REQUIRE(engine.GetErrorCount() == 12);
+    REQUIRE(engine.GetDroppedErrorCount() == 8);
+}
+
+TEST_CASE("DiagnosticEngine SuppressedWarnings") {
+    FILE* output{ tmpfile() };
+    REQUIRE(output != nullptr);
+
+    DiagnosticEngine engine{ output };
+    REQUIRE(engine.SuppressWarning("token-cache"));
+    REQUIRE(!engine.SuppressWarning("no-such-warning"));
+
+    engine.Report(DK_CANNOT_WRITE_TOKEN_CACHE, nullptr, "a.c");
+    engine.Report(DK_SCAN_WARNING, nullptr, "shown");
+
+    DiagnosticBuffer buffer{ &engine };
+    buffer.Report(DK_CANNOT_WRITE_TOKEN_CACHE, nullptr, "b.c");
+    REQUIRE(buffer.GetRecords().empty());
+    engine.Flush(buffer);
+
+    engine.SuppressAllWarnings();
+    engine.Report(DK_SCAN_WARNING, nullptr, "hidden");
+    engine.Report(DK_SCAN_ERROR, nullptr, "still an error");
+    engine.ReportSummary();
+
+    std::string text{ ReadBack(output) };
+    fclose(output);
+
+    REQUIRE(text.find("a.c") == std::string::npos);
+    REQUIRE(text.find("b.c") == std::string::npos);
+    REQUIRE(text.find("hidden") == std::string::npos);
+    REQUIRE(text.find("shown") != std::string::npos);
+    REQUIRE(text.find("still an error") != std::string::npos);
+    REQUIRE(text.find("3 warnings suppressed") != std::string::npos);
+
+    REQUIRE(engine.GetWarningCount() == 1);
+    REQUIRE(engine.GetSuppressedWarningCount() == 3);
+    REQUIRE(engine.GetErrorCount() == 1);
+}
+
+TEST_CASE("DiagnosticEngine JsonLines") {
+    Rc<SourceFile> sourceFile{ CreateSourceFile("dir/a.c", "int x;\nfoo = bar;\n") };
+    SourceRange range{ SourceLoc{ sourceFile, 1, 6 }, 3 };
+
+    DiagnosticBuffer buffer{ };
+    buffer.Report(DK_SCAN_WARNING, &range, "say \"hi\"\tnow");
+    buffer.Report(DK_CANNOT_OPEN_FILE, nullptr, "b.c");
+
+    REQUIRE(buffer.Format(DF_JSON) ==
+        "{\"severity\":\"warning\",\"kind\":\"SCAN_WARNING\",\"flag\":\"scan\","
+        "\"message\":\"say \\\"hi\\\"\\tnow\",\"file\":\"dir/a.c\","
+        "\"offset\":13,\"length\":3,\"line\":2,\"column\":7}\n"
+        "{\"severity\":\"fatal\",\"kind\":\"CANNOT_OPEN_FILE\",\"message\":\"cannot open b.c\"}\n"
+    );
+}
+
+TEST_CASE("DiagnosticEngine SarifLog") {
+    FILE* output{ tmpfile() };
+    REQUIRE(output != nullptr);
+
+    Rc<SourceFile> sourceFile{ CreateSourceFile("a.c", "int x;\n") };
+    SourceRange range{ SourceLoc{ sourceFile, 0, 4 }, 1 };
+
+    DiagnosticEngine engine{ output };
+    engine.SetFormat(DF_SARIF);
+
+    ParallelFor(100, 8, [&](size_t index) {
+        engine.Report(DK_SCAN_ERROR, &range, "error " + std::to_string(index));
+    });
+    engine.Finish();
+
+    std::string text{ ReadBack(output) };
+    fclose(output);
+
+    REQUIRE(text.rfind("{\"version\":\"2.1.0\",", 0) == 0);
+    REQUIRE(text.find("\n]}]}\n") == text.size() - 6);
+    REQUIRE(CountOccurrences(text, "{\"ruleId\":\"SCAN_ERROR\",\"level\":\"error\"") == 100);
+    REQUIRE(CountOccurrences(text, "},\n{\"ruleId\"") == 99);
+    REQUIRE(CountOccurrences(text, "\"region\":{\"startLine\":1,\"startColumn\":5,\"endColumn\":6,"
+                                   "\"byteOffset\":4,\"byteLength\":1}") == 100);
+}
+
+TEST_CASE("DiagnosticEngine EmptySarifLog") {
+    FILE* output{ tmpfile() };
+    REQUIRE(output != nullptr);
+
+    DiagnosticEngine engine{ output };
+    engine.SetFormat(DF_SARIF);
+    engine.Finish();
+
+    std::string text{ ReadBack(output) };
+    fclose(output);
+
+    REQUIRE(text.find("\"results\":[\n\n]}]}\n") != std::string::npos);
+}
+
+TEST_CASE("DiagnosticEngine ConcurrentReports") {
+    FILE* output{ tmpfile() };
+    REQUIRE(output != nullptr);
+
+    DiagnosticEngine engine{ output };
+    ParallelFor(4000, 8, [&](size_t index) {
+        engine.Report(index % 4 == 0 ? DK_SCAN_WARNING : DK_SCAN_ERROR, nullptr, "diagnostic " + std::to_string(index));
+    });
+
+    std::string text{ ReadBack(output) };
+    fclose(output);
+
+    REQUIRE(engine.GetErrorCount() == 3000);
+    REQUIRE(engine.GetWarningCount() == 1000);
+    REQUIRE(CountOccurrences(text, "\n") == 4000);
+    REQUIRE(CountOccurrences(text, "diagnostic ") == 4000);
+}
+
+TEST_CASE("DiagnosticEngine FlushInTaskOrder") {
+    FILE* output{ tmpfile() };
+    REQUIRE(output != nullptr);
+
+    DiagnosticEngine engine{ output };
+    std::vector<DiagnosticBuffer> buffers(100);
+
+    ParallelFor(buffers.size(), 8, [&](size_t index) {
+        char message[32];
+        snprintf(message, sizeof(message), "task %03zu", index);
+        buffers[index].Report(DK_SCAN_ERROR, nullptr, message);
+    });
+
+    for (DiagnosticBuffer& buffer : buffers)
+        engine.Flush(buffer);
+
+    std::string text{ ReadBack(output) };
+    fclose(output);
+
+    size_t previous{ 0 };
+    for (size_t i{ 0 }; i < buffers.size(); ++i) {
+        char message[32];
+        snprintf(message, sizeof(message), "task %03zu", i);
+
+        size_t at{ text.find(message) };
+        REQUIRE(at != std::string::npos);
+        REQUIRE(at >= previous);
+        previous = at;
+
+        REQUIRE(buffers[i].IsEmpty());
+    }
+}
+
+TEST_CASE("DiagnosticEngine ParsedBodiesInSourceOrder") {
+    std::string source{ };
+    for (int i{ 0 }; i < 50; ++i)
+        source += i % 5 == 0 ? "{ ((((x)))) } " : "{ x } ";
+
+    Rc<SourceFile> sourceFile{ CreateSourceFile("bodies.c", source) };
+    Rc<BacktrackingLexer> lexer{ NewObj<BacktrackingLexer>(NewObj<CodeLexer>(sourceFile)) };
+
+    ParserOptions options{ };
+    options.MaxDepth = 8;
+    options.Diagnostics = NewObj<DiagnosticBuffer>();
+
+    std::vector<Rc<DeferredBody>> bodies{ };
+    while (Rc<DeferredBody> body{ DeferBody(lexer, ParseExpression, options) })
+        bodies.push_back(body);
+
+    ParseDeferredBodies(bodies, 4);
+
+    std::string text{ options.Diagnostics->Format() };
+    REQUIRE(options.Diagnostics->GetErrorCount() == 10);
+
+    std::vector<int> columns{ };
+    const std::string prefix{ "bodies.c:1:" };
+
+    for (size_t at{ text.find(prefix) }; at != std::string::npos; at = text.find(prefix, at + 1))
+        columns.push_back(std::stoi(text.substr(at + prefix.size())));
+
+    REQUIRE(columns.size() == 10);
+    for (size_t i{ 1 }; i < columns.size(); ++i)
+        REQUIRE(columns[i - 1] < columns[i]);
+}
@@ -1,6 +1,7 @@
 #include <catch.hpp>
 #include "../backtracking-lexer.hh"
 #include "../code-lexer.hh"
+#include "../diagnostic-engine.hh"
 #include "../language-parser.hh"
 #include "../source.hh"
 #include "../syntax.hh"
@@ -450,3 +451,303 @@ TEST_CASE("ExpressionParser PostfixExpression PostDecrement_Chained") {
     M<MinusMinusSymbol>(leftPostfixExpression->GetChild(1));
     M<MinusMinusSymbol>(rightPostfixExpression->GetChild(1));
 }
+
+TEST_CASE("ExpressionParser Memoize ArrayAccess_Chained") {
+    Rc<SourceFile> sourceFile{ CreateSourceFile("", "FooBar[(1000)][2000]") };
+    Rc<CodeLexer> codeLexer{ NewObj<CodeLexer>(sourceFile) };
+    Rc<BacktrackingLexer> backtrackingLexer{ NewObj<BacktrackingLexer>(codeLexer) };
+
+    ParserOptions options{ };
+    options.ShouldMemoize = true;
+
+    Rc<PostfixExpression> rightPostfixExpression{ M<PostfixExpression>(ParseExpression(backtrackingLexer, options)) };
+    REQUIRE(rightPostfixExpression->IsArrayAccessor());
+    REQUIRE(rightPostfixExpression->IsValid());
+
+    Rc<PostfixExpression> leftPostfixExpression{ M<PostfixExpression>(rightPostfixExpression->GetChild(0)) };
+    REQUIRE(leftPostfixExpression->IsArrayAccessor());
+    REQUIRE(leftPostfixExpression->IsValid());
+
+    Rc<PrimaryExpression> leftIndex{ M<PrimaryExpression>(leftPostfixExpression->GetChild(2)) };
+    REQUIRE(leftIndex->IsParenthesizedExpression());
+
+    Rc<PrimaryExpression> rightIndex{ M<PrimaryExpression>(rightPostfixExpression->GetChild(2)) };
+    REQUIRE(rightIndex->IsNumericLiteral());
+
+    REQUIRE(backtrackingLexer->ReadToken()->GetKind() == SK_EofToken);
+}
+
+TEST_CASE("ExpressionParser BinaryExpression Precedence") {
+    Rc<AdditiveExpression> addition{ Setup<AdditiveExpression>("a + b * c") };
+    REQUIRE(addition->IsAddition());
+    REQUIRE(addition->IsValid());
+
+    Rc<PrimaryExpression> left{ M<PrimaryExpression>(addition->GetChild(0)) };
+    REQUIRE(M<IdentifierToken>(left->GetChild(0))->GetName() == "a");
+
+    Rc<MultiplicativeExpression> right{ M<MultiplicativeExpression>(addition->GetChild(2)) };
+    REQUIRE(right->IsMultiplication());
+    REQUIRE(right->IsValid());
+}
+
+TEST_CASE("ExpressionParser BinaryExpression LeftAssociative") {
+    Rc<AdditiveExpression> outer{ Setup<AdditiveExpression>("a - b - c") };
+    REQUIRE(outer->IsSubtraction());
+
+    Rc<AdditiveExpression> inner{ M<AdditiveExpression>(outer->GetChild(0)) };
+    REQUIRE(inner->IsSubtraction());
+
+    Rc<PrimaryExpression> right{ M<PrimaryExpression>(outer->GetChild(2)) };
+    REQUIRE(M<IdentifierToken>(right->GetChild(0))->GetName() == "c");
+}
+
+TEST_CASE("ExpressionParser BinaryExpression UnaryOperands") {
+    Rc<RelationalExpression> comparison{ Setup<RelationalExpression>("-a << 2 <= ~b") };
+    REQUIRE(comparison->IsLessThanOrEqualTo());
+
+    Rc<ShiftExpression> shift{ M<ShiftExpression>(comparison->GetChild(0)) };
+    REQUIRE(shift->IsLeftShift());
+
+    Rc<UnaryExpression> negation{ M<UnaryExpression>(shift->GetChild(0)) };
+    REQUIRE(negation->IsNegative());
+
+    Rc<UnaryExpression> complement{ M<UnaryExpression>(comparison->GetChild(2)) };
+    REQUIRE(complement->IsBitwiseComplement());
+}
+
+TEST_CASE("ExpressionParser BinaryExpression MissingRightOperand") {
+    Rc<SourceFile> sourceFile{ CreateSourceFile("", "a || b &&") };
+    Rc<CodeLexer> codeLexer{ NewObj<CodeLexer>(sourceFile) };
+    Rc<BacktrackingLexer> backtrackingLexer{ NewObj<BacktrackingLexer>(codeLexer) };
+
+    Rc<LogicalOrExpression> expression{ M<LogicalOrExpression>(ParseExpression(backtrackingLexer)) };
+    REQUIRE(expression->IsLogicalOr());
+    M<PrimaryExpression>(expression->GetChild(2));
+
+    REQUIRE(backtrackingLexer->ReadToken()->GetKind() == SK_AmpersandAmpersandSymbol);
+}
+
+TEST_CASE("ExpressionParser AssignmentExpression RightAssociative") {
+    Rc<AssignmentExpression> outer{ Setup<AssignmentExpression>("a = b += c") };
+    REQUIRE(outer->IsAssignment());
+    REQUIRE(outer->IsValid());
+
+    Rc<AssignmentExpression> inner{ M<AssignmentExpression>(outer->GetChild(2)) };
+    REQUIRE(inner->IsAdditionAssignment());
+    REQUIRE(inner->IsValid());
+}
+
+TEST_CASE("ExpressionParser ConditionalExpression Nested") {
+    Rc<ConditionalExpression> outer{ Setup<ConditionalExpression>("a ? b, c : d ? e : f") };
+    REQUIRE(outer->IsConditional());
+    REQUIRE(outer->IsValid());
+
+    Rc<CommaExpression> ifTrue{ M<CommaExpression>(outer->GetChild(2)) };
+    REQUIRE(ifTrue->IsComma());
+
+    Rc<ConditionalExpression> ifFalse{ M<ConditionalExpression>(outer->GetChild(4)) };
+    REQUIRE(ifFalse->IsConditional());
+}
+
+TEST_CASE("ExpressionParser CommaExpression AssignmentOperands") {
+    Rc<CommaExpression> comma{ Setup<CommaExpression>("a = 1, b = 2") };
+    REQUIRE(comma->IsComma());
+    REQUIRE(comma->IsValid());
+
+    M<AssignmentExpression>(comma->GetChild(0));
+    M<AssignmentExpression>(comma->GetChild(2));
+}
+
+static void RequireDerivedProductions(const Rc<SyntaxNode>& node) {
+    if (IsSyntaxTokenKind(node->GetKind()))
+        return;
+
+    Rc<Expression> expression{ As<Expression>(node) };
+    REQUIRE(expression->GetProduction() != SP_INVALID);
+    REQUIRE(DeriveSyntaxProduction(*expression) == expression->GetProduction());
+
+    for (size_t i{ 0 }; i < expression->GetChildCount(); ++i)
+        RequireDerivedProductions(expression->GetChild(static_cast<int>(i)));
+}
+
+TEST_CASE("ExpressionParser Production MatchesShape") {
+    const char* const inputs[]{
+        "a",
+        "15",
+        "\"s\"",
+        "(a)",
+        "a[1].b->c++--",
+        "++a, --a, &a, *a, +a, -a, ~a, !a, sizeof a, sizeof(a)",
+        "a * b / c % d + e - f << g >> h",
+        "a < b > c <= d >= e == f != g & h ^ i | j && k || l",
+        "a = b *= c /= d %= e += f -= g <<= h >>= i &= j ^= k |= l ? m : n"
+    };
+
+    for (const char* input : inputs) {
+        INFO(input);
+        Rc<SourceFile> sourceFile{ CreateSourceFile("", input) };
+        Rc<BacktrackingLexer> backtrackingLexer{ NewObj<BacktrackingLexer>(NewObj<CodeLexer>(sourceFile)) };
+
+        Rc<Expression> expression{ ParseExpression(backtrackingLexer) };
+        REQUIRE(expression);
+        RequireDerivedProductions(expression);
+        REQUIRE(backtrackingLexer->ReadToken()->GetKind() == SK_EofToken);
+    }
+}
+
+TEST_CASE("ExpressionParser Production Recorded") {
+    Rc<UnaryExpression> sizeOf{ Setup<UnaryExpression>("sizeof(x)") };
+    REQUIRE(sizeOf->GetProduction() == SP_SIZE_OF);
+    REQUIRE(M<PrimaryExpression>(sizeOf->GetChild(1))->GetProduction() == SP_PARENTHESIZED_EXPRESSION);
+
+    Rc<PostfixExpression> member{ Setup<PostfixExpression>("p->q") };
+    REQUIRE(member->GetProduction() == SP_STRUCTURE_DEREFERENCE);
+    REQUIRE(!member->IsStructureReference());
+}
+
+static Rc<BacktrackingLexer> Lex(const std::string& source) {
+    Rc<SourceFile> sourceFile{ CreateSourceFile("", source) };
+    return NewObj<BacktrackingLexer>(NewObj<CodeLexer>(sourceFile), BLM_STREAMING);
+}
+
+TEST_CASE("ExpressionParser DeferBody ParsedOnDemand") {
+    Rc<BacktrackingLexer> lexer{ Lex("{ a + (b * c) } d") };
+
+    Rc<DeferredBody> body{ DeferBody(lexer, ParseExpression) };
+    REQUIRE(body);
+    REQUIRE(!body->IsParsed());
+    REQUIRE(body->GetTokens().size() == 9);
+    REQUIRE(M<IdentifierToken>(lexer->ReadToken())->GetName() == "d");
+
+    Rc<AdditiveExpression> contents{ M<AdditiveExpression>(body->GetContents()) };
+    REQUIRE(body->IsParsed());
+    REQUIRE(body->IsComplete());
+    REQUIRE(M<MultiplicativeExpression>(M<PrimaryExpression>(contents->GetChild(2))->GetChild(1)));
+    REQUIRE(body->GetContents() == contents);
+}
+
+TEST_CASE("ExpressionParser DeferBody Incomplete") {
+    Rc<BacktrackingLexer> lexer{ Lex("{ a b }") };
+
+    Rc<DeferredBody> body{ DeferBody(lexer, ParseExpression) };
+    REQUIRE(M<PrimaryExpression>(body->GetContents()));
+    REQUIRE(!body->IsComplete());
+}
+
+TEST_CASE("ExpressionParser DeferBody NoGroup") {
+    Rc<BacktrackingLexer> lexer{ Lex("a { b") };
+    REQUIRE(!DeferBody(lexer, ParseExpression));
+
+    lexer->ReadToken();
+    REQUIRE(!DeferBody(lexer, ParseExpression));
+    REQUIRE(lexer->PeekKind() == SK_LBraceSymbol);
+}
+
+TEST_CASE("ExpressionParser DeferBody ParseInParallel") {
+    std::string source{ };
+    for (int i{ 0 }; i < 200; ++i)
+        source += (i % 2 == 0 ? "{ a + b * c } " : "{ x = y ? z : w } ");
+
+    Rc<BacktrackingLexer> lexer{ Lex(source) };
+    std::vector<Rc<DeferredBody>> bodies{ };
+    while (Rc<DeferredBody> body{ DeferBody(lexer, ParseExpression) })
+        bodies.push_back(body);
+    REQUIRE(bodies.size() == 200);
+
+    ParseDeferredBodies(bodies, 4);
+
+    for (size_t i{ 0 }; i < bodies.size(); ++i) {
+        REQUIRE(bodies[i]->IsParsed());
+        REQUIRE(bodies[i]->IsComplete());
+
+        Rc<Expression> contents{ bodies[i]->GetContents() };
+        if (i % 2 == 0)
+            REQUIRE(M<AdditiveExpression>(contents)->IsAddition());
+        else
+            REQUIRE(M<AssignmentExpression>(contents)->IsAssignment());
+    }
+}
+
+TEST_CASE("ExpressionParser DeferBody DefaultThreadCount") {
+    Rc<BacktrackingLexer> lexer{ Lex("{ a } { b + c }") };
+    std::vector<Rc<DeferredBody>> bodies{ };
+    while (Rc<DeferredBody> body{ DeferBody(lexer, ParseExpression) })
+        bodies.push_back(body);
+
+    ParseDeferredBodies(bodies, 0);
+    REQUIRE(bodies[0]->IsComplete());
+    REQUIRE(M<AdditiveExpression>(bodies[1]->GetContents())->IsAddition());
+
+    ParseDeferredBodies(std::vector<Rc<DeferredBody>>{ }, 0);
+}
+
+TEST_CASE("ExpressionParser Nesting DeepParentheses") {
+    constexpr int DEPTH{ 50000 };
+    Rc<Expression> expression{
+        Setup<PrimaryExpression>(std::string(DEPTH, '(') + "x" + std::string(DEPTH, ')'))
+    };
+
+    for (int i{ 0 }; i < DEPTH; ++i) {
+        REQUIRE(As<PrimaryExpression>(expression)->IsParenthesizedExpression());
+        expression = As<Expression>(expression->GetChild(1));
+    }
+    REQUIRE(M<PrimaryExpression>(expression)->IsIdentifier());
+}
+
+TEST_CASE("ExpressionParser Nesting LongChains") {
+    constexpr int LENGTH{ 50000 };
+    std::string sum{ "x" };
+    std::string assignments{ "x" };
+    std::string negations{ "x" };
+
+    for (int i{ 0 }; i < LENGTH; ++i) {
+        sum += " + x";
+        assignments += " = x";
+        negations = "- " + negations;
+    }
+
+    // Left associative: the chain grows down the left operands.
+    Rc<Expression> expression{ Setup<AdditiveExpression>(sum) };
+    for (int i{ 0 }; i < LENGTH; ++i)
+        expression = As<Expression>(expression->GetChild(0));
+    REQUIRE(M<PrimaryExpression>(expression)->IsIdentifier());
+
+    // Right associative: down the right operands.
+    expression = Setup<AssignmentExpression>(assignments);
+    for (int i{ 0 }; i < LENGTH; ++i)
+        expression = As<Expression>(expression->GetChild(2));
+    REQUIRE(M<PrimaryExpression>(expression)->IsIdentifier());
+
+    expression = Setup<UnaryExpression>(negations);
+    for (int i{ 0 }; i < LENGTH; ++i)
+        expression = As<Expression>(expression->GetChild(1));
+    REQUIRE(M<PrimaryExpression>(expression)->IsIdentifier());
+}
+
+TEST_CASE("ExpressionParser Nesting DepthLimit") {
+    ParserOptions options{ };
+    options.MaxDepth = 4 * 100;
+    options.Diagnostics = NewObj<DiagnosticBuffer>();
+
+    Rc<BacktrackingLexer> shallow{ Lex(std::string(90, '(') + "x" + std::string(90, ')')) };
+    REQUIRE(ParseExpression(shallow, options));
+
+    Rc<BacktrackingLexer> deep{ Lex(std::string(110, '(') + "x" + std::string(110, ')')) };
+    REQUIRE(!ParseExpression(deep, options));
+    REQUIRE(deep->GetPosition() == 0);
+    REQUIRE(options.Diagnostics->GetErrorCount() == 1);
+}
+
+TEST_CASE("ExpressionParser Nesting DepthLimitStreaming") {
+    // Every open frame holds a mark on the streaming lexer; giving up must
+    // not take time quadratic in their number.
+    constexpr int DEPTH{ 100000 };
+    ParserOptions options{ };
+    options.MaxDepth = DEPTH;
+    options.Diagnostics = NewObj<DiagnosticBuffer>();
+
+    Rc<BacktrackingLexer> deep{ Lex(std::string(DEPTH, '(') + "x" + std::string(DEPTH, ')')) };
+    REQUIRE(!ParseExpression(deep, options));
+    REQUIRE(deep->GetPosition() == 0);
+    REQUIRE(options.Diagnostics->GetErrorCount() == 1);
+}
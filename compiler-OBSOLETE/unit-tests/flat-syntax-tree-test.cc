@@ -0,0 +1,75 @@
+#include <catch.hpp>
+#include "../backtracking-lexer.hh"
+#include "../code-lexer.hh"
+#include "../flat-syntax-tree.hh"
+#include "../language-parser.hh"
+#include "../source.hh"
+#include "../syntax.hh"
+#include <vector>
+
+static FlatSyntaxTree Flatten(const std::string& source) {
+    Rc<SourceFile> sourceFile{ CreateSourceFile("", source) };
+    Rc<CodeLexer> codeLexer{ NewObj<CodeLexer>(sourceFile) };
+    Rc<BacktrackingLexer> backtrackingLexer{ NewObj<BacktrackingLexer>(codeLexer) };
+
+    return FlattenSyntaxTree(ParseExpression(backtrackingLexer));
+}
+
+TEST_CASE("FlatSyntaxTree Empty") {
+    FlatSyntaxTree tree{ Flatten("") };
+    REQUIRE(tree.GetNodeCount() == 0);
+    REQUIRE(tree.Tokens.empty());
+}
+
+TEST_CASE("FlatSyntaxTree Preorder") {
+    FlatSyntaxTree tree{ Flatten("a + b * c") };
+
+    std::vector<SYNTAX_KIND> expected{
+        SK_AdditiveExpression,
+            SK_PrimaryExpression, SK_IdentifierToken,
+            SK_PlusSymbol,
+            SK_MultiplicativeExpression,
+                SK_PrimaryExpression, SK_IdentifierToken,
+                SK_AsteriskSymbol,
+                SK_PrimaryExpression, SK_IdentifierToken
+    };
+    REQUIRE(tree.Kinds == expected);
+
+    REQUIRE(tree.ChildCounts[0] == 3);
+    REQUIRE(tree.FirstChildren[0] == 1);
+    REQUIRE(tree.SubtreeEnds[0] == tree.GetNodeCount());
+
+    REQUIRE(tree.SubtreeEnds[1] == 3);
+    REQUIRE(tree.SubtreeEnds[3] == 4);
+    REQUIRE(tree.ChildCounts[4] == 3);
+    REQUIRE(tree.SubtreeEnds[4] == tree.GetNodeCount());
+
+    REQUIRE(tree.FirstChildren[2] == FlatSyntaxTree::NONE);
+    REQUIRE(tree.TokenIndices[0] == FlatSyntaxTree::NONE);
+    REQUIRE(tree.Tokens.size() == 5);
+}
+
+TEST_CASE("FlatSyntaxTree SiblingWalk") {
+    FlatSyntaxTree tree{ Flatten("x = y ? 1 : 2") };
+    REQUIRE(tree.Kinds[0] == SK_AssignmentExpression);
+
+    std::vector<SYNTAX_KIND> children{ };
+    for (uint32_t child{ tree.FirstChildren[0] }; child < tree.SubtreeEnds[0]; child = tree.SubtreeEnds[child])
+        children.push_back(tree.Kinds[child]);
+
+    REQUIRE(children == std::vector<SYNTAX_KIND>{
+        SK_PrimaryExpression, SK_EqualsSymbol, SK_ConditionalExpression
+    });
+}
+
+TEST_CASE("FlatSyntaxTree LinearScan") {
+    FlatSyntaxTree tree{ Flatten("p->q[i + 1] - -r.s") };
+
+    std::vector<std::string> names{ };
+    for (uint32_t i{ 0 }; i < tree.GetNodeCount(); ++i) {
+        if (tree.Kinds[i] == SK_IdentifierToken)
+            names.push_back(As<IdentifierToken>(tree.Tokens[tree.TokenIndices[i]])->GetName());
+    }
+
+    REQUIRE(names == std::vector<std::string>{ "p", "q", "i", "r", "s" });
+}
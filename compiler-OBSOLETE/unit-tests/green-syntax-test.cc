@@ -0,0 +1,78 @@
+#include <catch.hpp>
+#include "../backtracking-lexer.hh"
+#include "../code-lexer.hh"
+#include "../green-syntax.hh"
+#include "../language-parser.hh"
+#include "../source.hh"
+#include "../syntax.hh"
+
+static Rc<Expression> Parse(const std::string& source) {
+    Rc<SourceFile> sourceFile{ CreateSourceFile("", source) };
+    Rc<CodeLexer> codeLexer{ NewObj<CodeLexer>(sourceFile) };
+    Rc<BacktrackingLexer> backtrackingLexer{ NewObj<BacktrackingLexer>(codeLexer) };
+
+    Rc<Expression> expression{ ParseExpression(backtrackingLexer) };
+    REQUIRE(expression);
+    return expression;
+}
+
+TEST_CASE("GreenSyntax SharesEqualSubtrees") {
+    GreenNodeCache cache{ };
+    Rc<GreenNode> root{ cache.Intern(Parse("sizeof (x) + sizeof (x)")) };
+
+    REQUIRE(root->GetKind() == SK_AdditiveExpression);
+    REQUIRE(root->GetProduction() == SP_ADDITION);
+    REQUIRE(root->GetWidth() == 9);
+    REQUIRE(root->GetChild(0) == root->GetChild(2));
+
+    // sizeof, (, x, ), the identifier and parenthesized primaries, the
+    // unary expression, + and the sum.
+    REQUIRE(cache.GetNodeCount() == 9);
+}
+
+TEST_CASE("GreenSyntax SharesAcrossTrees") {
+    GreenNodeCache cache{ };
+    Rc<GreenNode> first{ cache.Intern(Parse("a[i] = b")) };
+    size_t count{ cache.GetNodeCount() };
+
+    Rc<GreenNode> second{ cache.Intern(Parse("a[i] = b")) };
+    REQUIRE(second == first);
+    REQUIRE(cache.GetNodeCount() == count);
+
+    Rc<GreenNode> third{ cache.Intern(Parse("a[j] = b")) };
+    REQUIRE(third != first);
+    REQUIRE(third->GetChild(1) == first->GetChild(1));
+    REQUIRE(third->GetChild(2) == first->GetChild(2));
+}
+
+TEST_CASE("GreenSyntax TokenText") {
+    GreenNodeCache cache{ };
+    Rc<GreenNode> root{ cache.Intern(Parse("x + 42")) };
+
+    REQUIRE(root->GetChild(0)->GetChild(0)->GetText() == "x");
+    REQUIRE(root->GetChild(1)->GetText().empty());
+    REQUIRE(root->GetChild(2)->GetChild(0)->GetKind() == SK_NumericLiteralToken);
+    REQUIRE(root->GetChild(2)->GetChild(0)->GetText() == "42");
+}
+
+TEST_CASE("RedSyntax OffsetsAndParents") {
+    GreenNodeCache cache{ };
+    Rc<RedNode> root{ NewObj<RedNode>(cache.Intern(Parse("a * (b + c)"))) };
+
+    Rc<RedNode> parenthesized{ root->GetChild(2) };
+    REQUIRE(parenthesized->GetKind() == SK_PrimaryExpression);
+    REQUIRE(parenthesized->GetOffset() == 2);
+    REQUIRE(parenthesized->GetParent() == root);
+
+    Rc<RedNode> c{ parenthesized->GetChild(1)->GetChild(2) };
+    REQUIRE(c->GetOffset() == 5);
+    REQUIRE(c->GetParent()->GetParent() == parenthesized);
+
+    Rc<RedNode> found{ root->FindToken(5) };
+    REQUIRE(found->GetKind() == SK_IdentifierToken);
+    REQUIRE(found->GetGreen()->GetText() == "c");
+    REQUIRE(found->GetOffset() == 5);
+    REQUIRE(found->GetParent()->GetParent()->GetKind() == SK_AdditiveExpression);
+
+    REQUIRE(!root->FindToken(7));
+}
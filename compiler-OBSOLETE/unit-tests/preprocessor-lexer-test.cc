@@ -26,7 +26,7 @@ TEST_CASE("PreprocessorLexer HStringLiteralToken") {
     REQUIRE((secondToken->GetFlags() & SyntaxToken::BEGINNING_OF_LINE) == 0);
     REQUIRE(IsSyntaxNode<StringLiteralToken>(secondToken));
 
-    Rc<StringLiteralToken> literalToken{ std::static_pointer_cast<StringLiteralToken>(secondToken) };
+    Rc<StringLiteralToken> literalToken{ As<StringLiteralToken>(secondToken) };
     REQUIRE(literalToken->GetValue() == path);
     REQUIRE(literalToken->GetOpeningQuote() == '<');
     REQUIRE(literalToken->GetClosingQuote() == '>');
@@ -47,7 +47,7 @@ TEST_CASE("PreprocessorLexer HStringLiteralToken_WithoutWhitespaceInBetween") {
     REQUIRE((secondToken->GetFlags() & SyntaxToken::BEGINNING_OF_LINE) == 0);
     REQUIRE(IsSyntaxNode<StringLiteralToken>(secondToken));
 
-    Rc<StringLiteralToken> literalToken{ std::static_pointer_cast<StringLiteralToken>(secondToken) };
+    Rc<StringLiteralToken> literalToken{ As<StringLiteralToken>(secondToken) };
     REQUIRE(literalToken->GetValue() == path);
     REQUIRE(literalToken->GetOpeningQuote() == '<');
     REQUIRE(literalToken->GetClosingQuote() == '>');
@@ -74,7 +74,7 @@ TEST_CASE("PreprocessorLexer InvalidDirective") {
     Rc<SyntaxToken> token{ preprocessor->ReadToken() };
     REQUIRE(IsSyntaxNode<InvalidDirective>(token));
 
-    Rc<InvalidDirective> directive{ std::static_pointer_cast<InvalidDirective>(token) };
+    Rc<InvalidDirective> directive{ As<InvalidDirective>(token) };
     REQUIRE(directive->GetName() == name);
     REQUIRE((directive->GetFlags() & SyntaxToken::BEGINNING_OF_LINE) != 0);
 }
@@ -88,7 +88,7 @@ TEST_CASE("PreprocessorLexer InvalidDirective_WithWhitespaceInBetween") {
     REQUIRE((token->GetFlags() & SyntaxToken::BEGINNING_OF_LINE) != 0);
     REQUIRE(IsSyntaxNode<InvalidDirective>(token));
 
-    Rc<InvalidDirective> directive{ std::static_pointer_cast<InvalidDirective>(token) };
+    Rc<InvalidDirective> directive{ As<InvalidDirective>(token) };
     REQUIRE(directive->GetName() == name);
 }
 
@@ -0,0 +1,41 @@
+#include <catch.hpp>
+#include "../source-minimizer.hh"
+#include "../source.hh"
+#include <string>
+
+static std::string Minimize(const std::string& contents) {
+    Rc<SourceFile> minimized{ MinimizeSource(*CreateSourceFile("", contents)) };
+    return std::string{ minimized->Contents.data() };
+}
+
+TEST_CASE("SourceMinimizer EmptyFile") {
+    REQUIRE(Minimize("") == "\n");
+}
+
+TEST_CASE("SourceMinimizer CodeLinesAreEmptied") {
+    REQUIRE(Minimize("int x;\n#include <a.h>\nint y;") == "\n#include <a.h>\n\n");
+}
+
+TEST_CASE("SourceMinimizer CommentsAreReplacedBySpaces") {
+    REQUIRE(Minimize("#define A 1 /* one */\n#define B 2 // two") == "#define A 1          \n#define B 2       \n");
+}
+
+TEST_CASE("SourceMinimizer MultiLineCommentKeepsLineNumbers") {
+    REQUIRE(Minimize("/*\n#include <a.h>\n*/\n#include <b.h>") == "\n\n\n#include <b.h>\n");
+}
+
+TEST_CASE("SourceMinimizer CommentBeforeDirective") {
+    REQUIRE(Minimize("/* c */ #pragma once") == "        #pragma once\n");
+}
+
+TEST_CASE("SourceMinimizer CommentMarkersInStrings") {
+    REQUIRE(Minimize("char* s = \"/*\";\n#define X \"//\"") == "\n#define X \"//\"\n");
+}
+
+TEST_CASE("SourceMinimizer ContinuedLines") {
+    REQUIRE(Minimize("#define A \\\n  1\nint x = \\\n#y;") == "#define A \\\n  1\n\n\n");
+}
+
+TEST_CASE("SourceMinimizer CommentSpanningLinesInDirective") {
+    REQUIRE(Minimize("#define A /*\n*/ 1\nint x;\n#define B") == "#define A       1\n\n\n#define B");
+}
@@ -0,0 +1,165 @@
+#include <catch.hpp>
+#include "../backtracking-lexer.hh"
+#include "../code-lexer.hh"
+#include "../language-parser.hh"
+#include "../source.hh"
+#include "../syntax.hh"
+#include "../syntax-arena.hh"
+
+static Rc<Expression> Parse(Rc<SourceFile> sourceFile, const ParserOptions& options) {
+    Rc<CodeLexer> codeLexer{ NewObj<CodeLexer>(sourceFile) };
+    Rc<BacktrackingLexer> backtrackingLexer{ NewObj<BacktrackingLexer>(codeLexer) };
+
+    return ParseExpression(backtrackingLexer, options);
+}
+
+TEST_CASE("SyntaxArena ChildKeepsTreeAlive") {
+    Rc<SourceFile> sourceFile{ CreateSourceFile("", "a + b * c") };
+    Rc<Expression> expression{ Parse(sourceFile, ParserOptions{ }) };
+    REQUIRE(IsSyntaxNode<AdditiveExpression>(expression));
+
+    Rc<Expression> right{ As<Expression>(expression->GetChild(2)) };
+    expression.reset();
+
+    REQUIRE(IsSyntaxNode<MultiplicativeExpression>(right));
+    Rc<Expression> left{ As<Expression>(right->GetChild(0)) };
+    REQUIRE(As<IdentifierToken>(left->GetChild(0))->GetName() == "b");
+}
+
+TEST_CASE("SyntaxArena ReleasesTokensWithTree") {
+    Rc<SourceFile> sourceFile{ CreateSourceFile("", "x[1] = y") };
+    Rc<Expression> expression{ Parse(sourceFile, ParserOptions{ }) };
+    REQUIRE(expression);
+    REQUIRE(sourceFile.use_count() > 1);
+
+    expression.reset();
+    REQUIRE(sourceFile.use_count() == 1);
+}
+
+TEST_CASE("SyntaxArena SharedByTranslationUnit") {
+    ParserOptions options{ };
+    options.Arena = NewObj<SyntaxArena>();
+
+    Rc<Expression> first{ Parse(CreateSourceFile("", "a ? b : c"), options) };
+    Rc<Expression> second{ Parse(CreateSourceFile("", "-d, e"), options) };
+    REQUIRE(IsSyntaxNode<ConditionalExpression>(first));
+    REQUIRE(IsSyntaxNode<CommaExpression>(second));
+
+    size_t reservedBytes{ options.Arena->GetReservedBytes() };
+    REQUIRE(reservedBytes > 0);
+
+    for (int i{ 0 }; i < 100; ++i)
+        Parse(CreateSourceFile("", "f(g)"), options);
+    REQUIRE(options.Arena->GetReservedBytes() == reservedBytes);
+}
+
+TEST_CASE("SyntaxArena NodesCountTowardsArena") {
+    Rc<SyntaxArena> arena{ NewObj<SyntaxArena>() };
+    REQUIRE(arena.use_count() == 1);
+
+    Rc<PrimaryExpression> node{ arena->New<PrimaryExpression>() };
+    REQUIRE(arena.use_count() == 2);
+    REQUIRE(node.use_count() == 2);
+
+    Rc<SyntaxNode> shared{ arena->Share(node.get()) };
+    REQUIRE(arena.use_count() == 3);
+
+    arena.reset();
+    node.reset();
+    REQUIRE(shared.use_count() == 1);
+    REQUIRE(IsSyntaxNode<PrimaryExpression>(shared));
+}
+
+static void FillArena(SyntaxArena& arena) {
+    for (int i{ 0 }; i < 10000; ++i) {
+        Rc<IdentifierToken> token{ arena.New<IdentifierToken>() };
+        token->SetName("identifier");
+    }
+
+    // Oversized, so it gets a chunk of its own.
+    arena.NewChildArray(64 * 1024);
+}
+
+TEST_CASE("SyntaxArena ResetReusesChunks") {
+    Rc<SyntaxArena> arena{ NewObj<SyntaxArena>() };
+
+    FillArena(*arena);
+    size_t reservedBytes{ arena->GetReservedBytes() };
+
+    for (int pass{ 0 }; pass < 3; ++pass) {
+        REQUIRE(arena->Reset());
+
+        FillArena(*arena);
+        REQUIRE(arena->GetReservedBytes() == reservedBytes);
+    }
+}
+
+TEST_CASE("SyntaxArena ResetRefusedWhileNodesLive") {
+    Rc<SyntaxArena> arena{ NewObj<SyntaxArena>() };
+    Rc<IdentifierToken> token{ arena->New<IdentifierToken>() };
+    token->SetName("x");
+
+    REQUIRE_FALSE(arena->Reset());
+    REQUIRE(token->GetName() == "x");
+
+    token.reset();
+    REQUIRE(arena->Reset());
+}
+
+TEST_CASE("SyntaxArena FreedBlocksAreReused") {
+    Rc<SyntaxArena> arena{ NewObj<SyntaxArena>() };
+
+    void* first{ arena->AllocateBlock(100) };
+    arena->FreeBlock(first, 100);
+    REQUIRE(arena->AllocateBlock(120) == first);
+
+    void* large{ arena->AllocateBlock(1024 * 1024) };
+    REQUIRE(large != nullptr);
+    arena->FreeBlock(large, 1024 * 1024);
+    arena->FreeBlock(first, 120);
+}
+
+TEST_CASE("SyntaxArena HugePages") {
+    Rc<SyntaxArena> arena{ NewObj<SyntaxArena>(SAB_HUGE_PAGES) };
+    REQUIRE(arena->GetBacking() == SAB_HUGE_PAGES);
+
+    Rc<PrimaryExpression> node{ arena->New<PrimaryExpression>() };
+    REQUIRE(arena->GetReservedBytes() == 2 * 1024 * 1024);
+
+    node.reset();
+    REQUIRE(arena->Reset());
+}
+
+TEST_CASE("SyntaxArena ThreadArenaReusedWhenFree") {
+    SyntaxArena* first{ AcquireThreadArena().get() };
+    REQUIRE(AcquireThreadArena().get() == first);
+
+    Rc<SyntaxArena> held{ AcquireThreadArena() };
+    Rc<SyntaxArena> next{ AcquireThreadArena() };
+    REQUIRE(next.get() != held.get());
+
+    REQUIRE(AcquireThreadArena(SAB_HUGE_PAGES)->GetBacking() == SAB_HUGE_PAGES);
+}
+
+TEST_CASE("SyntaxArena HoldsTokensAndTree") {
+    Rc<SyntaxArena> arena{ NewObj<SyntaxArena>() };
+    ParserOptions options{ };
+    options.Arena = arena;
+
+    Rc<SourceFile> sourceFile{ CreateSourceFile("", "a + b * c") };
+    Rc<CodeLexer> codeLexer{ NewObj<CodeLexer>(sourceFile, arena) };
+    Rc<Expression> expression{ ParseExpression(NewObj<BacktrackingLexer>(codeLexer), options) };
+    codeLexer.reset();
+    options.Arena.reset();
+
+    REQUIRE(IsSyntaxNode<AdditiveExpression>(expression));
+    REQUIRE(expression->GetChildNode(1)->GetArena() == arena.get());
+    REQUIRE_FALSE(arena->Reset());
+
+    // Tokens the tree points to are in its own arena, so releasing the
+    // tree leaves nothing referring to it.
+    expression.reset();
+    REQUIRE(arena.use_count() == 1);
+    REQUIRE(arena->Reset());
+    REQUIRE(sourceFile.use_count() == 1);
+}
@@ -0,0 +1,107 @@
+#include <catch.hpp>
+#include "../backtracking-lexer.hh"
+#include "../binary-format.hh"
+#include "../code-lexer.hh"
+#include "../flat-syntax-tree.hh"
+#include "../language-parser.hh"
+#include "../source.hh"
+#include "../syntax.hh"
+#include "../syntax-tree-file.hh"
+#include <stdio.h>
+#include <string>
+
+static const char* const TEST_TREE_FILE{ "syntax-tree-file-test.tmp" };
+
+static FlatSyntaxTree Flatten(const std::string& source) {
+    Rc<SourceFile> sourceFile{ CreateSourceFile("", source) };
+    Rc<CodeLexer> codeLexer{ NewObj<CodeLexer>(sourceFile) };
+    Rc<BacktrackingLexer> backtrackingLexer{ NewObj<BacktrackingLexer>(codeLexer) };
+
+    return FlattenSyntaxTree(ParseExpression(backtrackingLexer));
+}
+
+TEST_CASE("SyntaxTreeFile RoundTrip") {
+    FlatSyntaxTree expected{ Flatten("a[i] = b ? \"s\" : -(c + 42)") };
+    REQUIRE(WriteSyntaxTreeFile(TEST_TREE_FILE, expected));
+
+    Rc<SyntaxTreeFile> file{ OpenSyntaxTreeFile(TEST_TREE_FILE) };
+    REQUIRE(file != nullptr);
+    REQUIRE(file->GetNodeCount() == expected.GetNodeCount());
+    REQUIRE(file->GetTokenCount() == expected.Tokens.size());
+
+    for (uint32_t i{ 0 }; i < expected.GetNodeCount(); ++i) {
+        REQUIRE(file->GetKind(i) == expected.Kinds[i]);
+        REQUIRE(file->GetChildCount(i) == expected.ChildCounts[i]);
+        REQUIRE(file->GetFirstChild(i) == expected.FirstChildren[i]);
+        REQUIRE(file->GetSubtreeEnd(i) == expected.SubtreeEnds[i]);
+        REQUIRE(file->GetTokenIndex(i) == expected.TokenIndices[i]);
+    }
+
+    FlatSyntaxTree loaded{ file->ToFlatSyntaxTree() };
+    file = nullptr;
+    remove(TEST_TREE_FILE);
+
+    REQUIRE(loaded.Kinds == expected.Kinds);
+    REQUIRE(loaded.Tokens.size() == expected.Tokens.size());
+
+    for (size_t i{ 0 }; i < loaded.Tokens.size(); ++i) {
+        const SourceRange& range{ loaded.Tokens[i]->GetLexemeRange() };
+        REQUIRE(range.Location.Line == expected.Tokens[i]->GetLexemeRange().Location.Line);
+        REQUIRE(range.Location.Column == expected.Tokens[i]->GetLexemeRange().Location.Column);
+
+        if (loaded.Tokens[i]->GetKind() == SK_IdentifierToken)
+            REQUIRE(As<IdentifierToken>(loaded.Tokens[i])->GetName() == As<IdentifierToken>(expected.Tokens[i])->GetName());
+        if (loaded.Tokens[i]->GetKind() == SK_StringLiteralToken)
+            REQUIRE(As<StringLiteralToken>(loaded.Tokens[i])->GetValue() == "s");
+    }
+}
+
+TEST_CASE("SyntaxTreeFile EmptyTree") {
+    REQUIRE(WriteSyntaxTreeFile(TEST_TREE_FILE, Flatten("")));
+
+    Rc<SyntaxTreeFile> file{ OpenSyntaxTreeFile(TEST_TREE_FILE) };
+    REQUIRE(file != nullptr);
+    REQUIRE(file->GetNodeCount() == 0);
+
+    file = nullptr;
+    remove(TEST_TREE_FILE);
+}
+
+TEST_CASE("SyntaxTreeFile CorruptFileRejected") {
+    REQUIRE(WriteSyntaxTreeFile(TEST_TREE_FILE, Flatten("a + b")));
+
+    FILE* file{ fopen(TEST_TREE_FILE, "r+b") };
+    REQUIRE(file != nullptr);
+    fseek(file, -1, SEEK_END);
+    fputc('!', file);
+    fclose(file);
+
+    REQUIRE(OpenSyntaxTreeFile(TEST_TREE_FILE) == nullptr);
+    remove(TEST_TREE_FILE);
+}
+
+TEST_CASE("SyntaxTreeFile Varints") {
+    std::string buffer{ };
+    uint32_t values[]{ 0, 1, 127, 128, 300, 16384, UINT32_MAX };
+
+    for (uint32_t value : values)
+        AppendVarint(buffer, value);
+    REQUIRE(buffer.size() == 1 + 1 + 1 + 2 + 2 + 3 + 5);
+
+    const char* cursor{ buffer.data() };
+    for (uint32_t value : values) {
+        uint32_t read{ };
+        REQUIRE(ReadVarint(cursor, buffer.data() + buffer.size(), read));
+        REQUIRE(read == value);
+    }
+    REQUIRE(cursor == buffer.data() + buffer.size());
+
+    uint32_t read{ };
+    std::string truncated{ "\x80" };
+    const char* start{ truncated.data() };
+    REQUIRE(!ReadVarint(start, truncated.data() + truncated.size(), read));
+
+    std::string overlong{ "\xFF\xFF\xFF\xFF\x1F" };
+    start = overlong.data();
+    REQUIRE(!ReadVarint(start, overlong.data() + overlong.size(), read));
+}
@@ -0,0 +1,133 @@
+#include <catch.hpp>
+#include "../backtracking-lexer.hh"
+#include "../code-lexer.hh"
+#include "../language-parser.hh"
+#include "../source.hh"
+#include "../syntax.hh"
+#include "../syntax-visitor.hh"
+#include <stdlib.h>
+#include <string>
+
+static Rc<Expression> Parse(const std::string& source) {
+    Rc<SourceFile> sourceFile{ CreateSourceFile("", source) };
+    Rc<CodeLexer> codeLexer{ NewObj<CodeLexer>(sourceFile) };
+    Rc<BacktrackingLexer> backtrackingLexer{ NewObj<BacktrackingLexer>(codeLexer) };
+
+    Rc<Expression> expression{ ParseExpression(backtrackingLexer) };
+    REQUIRE(expression);
+    return expression;
+}
+
+/**
+ * Evaluates integer arithmetic on literals; anything else is 0.
+ */
+class ConstantFolder : public StaticSyntaxVisitor<ConstantFolder, long long> {
+public:
+    long long VisitNumericLiteralToken(NumericLiteralToken& token) {
+        return strtoll(token.GetWholeValue().c_str(), nullptr, 10);
+    }
+
+    long long VisitPrimaryExpression(PrimaryExpression& expression) {
+        return Visit(*expression.GetChildNode(expression.IsParenthesizedExpression() ? 1 : 0));
+    }
+
+    long long VisitUnaryExpression(UnaryExpression& expression) {
+        long long operand{ Visit(*expression.GetChildNode(1)) };
+        return expression.IsNegative() ? -operand : operand;
+    }
+
+    long long VisitAdditiveExpression(AdditiveExpression& expression) {
+        long long left{ Visit(*expression.GetChildNode(0)) };
+        long long right{ Visit(*expression.GetChildNode(2)) };
+        return expression.IsAddition() ? left + right : left - right;
+    }
+
+    long long VisitMultiplicativeExpression(MultiplicativeExpression& expression) {
+        long long left{ Visit(*expression.GetChildNode(0)) };
+        long long right{ Visit(*expression.GetChildNode(2)) };
+
+        if (expression.IsMultiplication())
+            return left * right;
+        return right == 0 ? 0 : expression.IsDivision() ? left / right : left % right;
+    }
+
+    long long VisitShiftExpression(ShiftExpression& expression) {
+        long long left{ Visit(*expression.GetChildNode(0)) };
+        long long right{ Visit(*expression.GetChildNode(2)) };
+        return expression.IsLeftShift() ? left << right : left >> right;
+    }
+};
+
+/**
+ * Counts the identifiers under a node.
+ */
+class IdentifierCounter : public StaticSyntaxVisitor<IdentifierCounter, void> {
+public:
+    void VisitIdentifierToken(IdentifierToken& token) {
+        (void) token;
+        ++count;
+    }
+
+    void VisitDefault(SyntaxNode& node) {
+        if (IsSyntaxTokenKind(node.GetKind()))
+            return;
+
+        Expression& expression{ static_cast<Expression&>(node) };
+        for (size_t i{ 0 }; i < expression.GetChildCount(); ++i)
+            Visit(*expression.GetChildNode(static_cast<int>(i)));
+    }
+
+    int count{ 0 };
+};
+
+TEST_CASE("StaticSyntaxVisitor ConstantFolding") {
+    ConstantFolder folder{ };
+
+    REQUIRE(folder.Visit(*Parse("42")) == 42);
+    REQUIRE(folder.Visit(*Parse("1 + 2 * 3")) == 7);
+    REQUIRE(folder.Visit(*Parse("(1 + 2) * -3")) == -9);
+    REQUIRE(folder.Visit(*Parse("100 / 7 % 4 << 2")) == 8);
+}
+
+TEST_CASE("StaticSyntaxVisitor DefaultHandler") {
+    ConstantFolder folder{ };
+    REQUIRE(folder.Visit(*Parse("a + 1")) == 1);
+
+    IdentifierCounter counter{ };
+    counter.Visit(*Parse("a[b] = c ? d.e : -f"));
+    REQUIRE(counter.count == 6);
+}
+
+TEST_CASE("WalkSyntaxTree EnterLeaveOrder") {
+    Rc<Expression> expression{ Parse("a + b * c") };
+    std::string order{ };
+
+    WalkSyntaxTree(
+        *expression,
+        [&](SyntaxNode& node) {
+            if (IsSyntaxNode<IdentifierToken>(&node))
+                order += static_cast<IdentifierToken&>(node).GetName();
+            else if (!IsSyntaxTokenKind(node.GetKind()))
+                order += "(";
+        },
+        [&](SyntaxNode& node) {
+            if (!IsSyntaxTokenKind(node.GetKind()))
+                order += ")";
+        }
+    );
+
+    REQUIRE(order == "((a)((b)(c)))");
+}
+
+TEST_CASE("WalkSyntaxTree DeepTree") {
+    constexpr int DEPTH{ 50000 };
+    Rc<Expression> expression{ Parse(std::string(DEPTH, '(') + "x" + std::string(DEPTH, ')')) };
+
+    size_t entered{ 0 };
+    size_t left{ 0 };
+    WalkSyntaxTree(*expression, [&](SyntaxNode&) { ++entered; }, [&](SyntaxNode&) { ++left; });
+
+    // Each level is a primary expression and its two parentheses.
+    REQUIRE(entered == DEPTH * 3 + 2);
+    REQUIRE(left == entered);
+}
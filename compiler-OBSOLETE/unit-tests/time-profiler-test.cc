@@ -0,0 +1,130 @@
+#include <catch.hpp>
+#include "../backtracking-lexer.hh"
+#include "../code-lexer.hh"
+#include "../language-parser.hh"
+#include "../parallel.hh"
+#include "../performance-counters.hh"
+#include "../source.hh"
+#include "../time-profiler.hh"
+#include <stdio.h>
+#include <string>
+
+static const char* const TEST_TRACE_FILE{ "time-profiler-test.tmp" };
+
+static std::string ReadFile(const char* path) {
+    std::string contents{ };
+    FILE* file{ fopen(path, "rb") };
+    REQUIRE(file != nullptr);
+
+    for (int c{ fgetc(file) }; c != EOF; c = fgetc(file))
+        contents += static_cast<char>(c);
+
+    fclose(file);
+    return contents;
+}
+
+static size_t CountOccurrences(const std::string& text, const std::string& pattern) {
+    size_t count{ 0 };
+    for (size_t at{ text.find(pattern) }; at != std::string::npos; at = text.find(pattern, at + 1))
+        ++count;
+    return count;
+}
+
+TEST_CASE("TimeProfiler Disabled") {
+    ResetTimeProfiler();
+
+    {
+        ScopedTimer timer{ TP_PARSE_EXPRESSION };
+    }
+
+    REQUIRE(FormatTimeReport().find("ParseExpression") == std::string::npos);
+}
+
+TEST_CASE("TimeProfiler Report") {
+    ResetTimeProfiler();
+    EnableTimeReport();
+
+    Rc<SourceFile> sourceFile{ CreateSourceFile("", "a + b * c") };
+    Rc<BacktrackingLexer> lexer{ NewObj<BacktrackingLexer>(NewObj<CodeLexer>(sourceFile)) };
+    REQUIRE(ParseExpression(lexer));
+
+    std::string report{ FormatTimeReport() };
+    ResetTimeProfiler();
+
+    REQUIRE(report.find("          1  ParseExpression\n") != std::string::npos);
+    REQUIRE(report.find("          1  BacktrackingLexer\n") != std::string::npos);
+    REQUIRE(report.find("CodeLexer") == std::string::npos);
+}
+
+TEST_CASE("TimeProfiler TracePerInput") {
+    ResetTimeProfiler();
+    EnableTimeTrace();
+
+    ParallelFor(8, 4, [](size_t index) {
+        ScopedTimer timer{ TP_SCAN_FILE, index % 2, "file" + std::to_string(index) + ".c" };
+        ScopedTimer lexTimer{ TP_PREPROCESSOR_LEXER };
+    });
+
+    // Outside of any input's work, so in no trace.
+    {
+        ScopedTimer timer{ TP_CODE_LEXER };
+    }
+
+    REQUIRE(WriteTimeTrace(TEST_TRACE_FILE, 1));
+    std::string trace{ ReadFile(TEST_TRACE_FILE) };
+    remove(TEST_TRACE_FILE);
+    ResetTimeProfiler();
+
+    REQUIRE(trace.rfind("{\"traceEvents\":[\n", 0) == 0);
+    REQUIRE(trace.find("\n],\"displayTimeUnit\":\"ms\"}\n") != std::string::npos);
+    REQUIRE(CountOccurrences(trace, "\"name\":\"ScanFile\"") == 4);
+    REQUIRE(CountOccurrences(trace, "\"name\":\"PreprocessorLexer\"") == 4);
+    REQUIRE(CountOccurrences(trace, "\"name\":\"CodeLexer\"") == 0);
+    REQUIRE(CountOccurrences(trace, "\"detail\":\"file") == 4);
+    REQUIRE(CountOccurrences(trace, "\"detail\":\"file0.c\"") == 0);
+    REQUIRE(CountOccurrences(trace, "\"name\":\"thread_name\"") >= 1);
+}
+
+TEST_CASE("TimeProfiler Counters") {
+    ResetTimeProfiler();
+    EnableCounterReport();
+
+    Rc<SourceFile> sourceFile{ CreateSourceFile("", "a + b * c") };
+    Rc<BacktrackingLexer> lexer{ NewObj<BacktrackingLexer>(NewObj<CodeLexer>(sourceFile)) };
+    REQUIRE(ParseExpression(lexer));
+
+    std::string report{ FormatTimeReport() };
+    ResetTimeProfiler();
+
+    // Without counters, e.g. in a container, the report goes on without them.
+    PerformanceCounterSample sample{ };
+    bool hasCounters{ ReadPerformanceCounters(sample) };
+    INFO(report);
+
+    REQUIRE(report.find("          1  ParseExpression\n") != std::string::npos);
+    REQUIRE((report.find("Hardware counters") != std::string::npos) == hasCounters);
+}
+
+TEST_CASE("TimeProfiler CounterDeltas") {
+    PerformanceCounterSample start{ };
+    start.Values[PC_CYCLES] = 100;
+    start.Values[PC_INSTRUCTIONS] = 50;
+    start.TimeEnabled = 1000;
+    start.TimeRunning = 1000;
+    start.AvailableMask = (1u << PC_CYCLES) | (1u << PC_INSTRUCTIONS);
+
+    // Switched out for half of the time since start.
+    PerformanceCounterSample end{ start };
+    end.Values[PC_CYCLES] = 300;
+    end.Values[PC_INSTRUCTIONS] = 450;
+    end.TimeEnabled = 3000;
+    end.TimeRunning = 2000;
+    end.AvailableMask = 1u << PC_CYCLES;
+
+    uint64_t deltas[PC_COUNT];
+    GetPerformanceCounterDeltas(start, end, deltas);
+
+    REQUIRE(deltas[PC_CYCLES] == 400);
+    REQUIRE(deltas[PC_INSTRUCTIONS] == 0);
+    REQUIRE(deltas[PC_LLC_MISSES] == 0);
+}
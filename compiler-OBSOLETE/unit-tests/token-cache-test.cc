@@ -0,0 +1,121 @@
+#include <catch.hpp>
+#include "../code-lexer.hh"
+#include "../source.hh"
+#include "../syntax.hh"
+#include "../token-cache.hh"
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+static const char* const TEST_CACHE_DIRECTORY{ "token-cache-test.tmp" };
+
+static std::vector<Rc<SyntaxToken>> LexAll(Rc<SourceFile> sourceFile) {
+    Rc<CodeLexer> lexer{ NewObj<CodeLexer>(sourceFile) };
+    std::vector<Rc<SyntaxToken>> tokens{ };
+
+    do {
+        tokens.push_back(lexer->ReadToken());
+    }
+    while (tokens.back()->GetKind() != SK_EofToken);
+
+    return tokens;
+}
+
+static void RemoveEntry(const TokenCache& cache, const SourceFile& sourceFile) {
+    remove(cache.GetEntryPath(sourceFile.Contents).c_str());
+    remove(TEST_CACHE_DIRECTORY);
+}
+
+TEST_CASE("TokenCache RoundTrip") {
+    Rc<SourceFile> sourceFile{
+        CreateSourceFile("a.h", "#define A 1.5f\n/* note */ int x = \"s\" @ y;")
+    };
+    std::vector<Rc<SyntaxToken>> expected{ LexAll(sourceFile) };
+
+    TokenCache cache{ TEST_CACHE_DIRECTORY };
+    REQUIRE(cache.Store(*sourceFile, expected));
+
+    std::vector<Rc<SyntaxToken>> tokens{ };
+    Rc<SourceFile> loaded{ cache.Load("a.h", sourceFile->Contents, tokens) };
+    RemoveEntry(cache, *sourceFile);
+
+    REQUIRE(loaded != nullptr);
+    REQUIRE(loaded->GetLineStarts() == sourceFile->GetLineStarts());
+    REQUIRE(tokens.size() == expected.size());
+
+    for (size_t i{ 0 }; i < tokens.size(); ++i) {
+        REQUIRE(tokens[i]->GetKind() == expected[i]->GetKind());
+        REQUIRE(tokens[i]->GetFlags() == expected[i]->GetFlags());
+        REQUIRE(tokens[i]->GetLexemeRange().Location.Source == loaded);
+        REQUIRE(tokens[i]->GetLexemeRange().Location.Line == expected[i]->GetLexemeRange().Location.Line);
+        REQUIRE(tokens[i]->GetLexemeRange().Location.Column == expected[i]->GetLexemeRange().Location.Column);
+    }
+
+    for (size_t i{ 0 }; i < tokens.size(); ++i) {
+        if (tokens[i]->GetKind() == SK_IdentifierToken)
+            REQUIRE(As<IdentifierToken>(tokens[i])->GetName() == As<IdentifierToken>(expected[i])->GetName());
+        if (tokens[i]->GetKind() == SK_StrayToken)
+            REQUIRE(As<StrayToken>(tokens[i])->GetOffendingChar() == As<StrayToken>(expected[i])->GetOffendingChar());
+        if (tokens[i]->GetKind() == SK_NumericLiteralToken) {
+            Rc<NumericLiteralToken> literal{ As<NumericLiteralToken>(tokens[i]) };
+            Rc<NumericLiteralToken> expectedLiteral{ As<NumericLiteralToken>(expected[i]) };
+            REQUIRE(literal->GetWholeValue() == expectedLiteral->GetWholeValue());
+            REQUIRE(literal->GetFractionalValue() == expectedLiteral->GetFractionalValue());
+            REQUIRE(literal->GetSuffix() == expectedLiteral->GetSuffix());
+        }
+    }
+}
+
+TEST_CASE("TokenCache ChangedContentsMiss") {
+    Rc<SourceFile> sourceFile{ CreateSourceFile("a.h", "int x;") };
+    Rc<SourceFile> changedFile{ CreateSourceFile("a.h", "int y;") };
+
+    TokenCache cache{ TEST_CACHE_DIRECTORY };
+    REQUIRE(cache.Store(*sourceFile, LexAll(sourceFile)));
+
+    std::vector<Rc<SyntaxToken>> tokens{ };
+    Rc<SourceFile> loaded{ cache.Load("a.h", changedFile->Contents, tokens) };
+    RemoveEntry(cache, *sourceFile);
+
+    REQUIRE(loaded == nullptr);
+    REQUIRE(tokens.empty());
+}
+
+TEST_CASE("TokenCache CorruptEntryMiss") {
+    Rc<SourceFile> sourceFile{ CreateSourceFile("a.h", "int x;") };
+
+    TokenCache cache{ TEST_CACHE_DIRECTORY };
+    REQUIRE(cache.Store(*sourceFile, LexAll(sourceFile)));
+
+    std::string entryPath{ cache.GetEntryPath(sourceFile->Contents) };
+    FILE* file{ fopen(entryPath.c_str(), "r+b") };
+    REQUIRE(file != nullptr);
+    fseek(file, -1, SEEK_END);
+    fputc('!', file);
+    fclose(file);
+
+    std::vector<Rc<SyntaxToken>> tokens{ };
+    Rc<SourceFile> loaded{ cache.Load("a.h", sourceFile->Contents, tokens) };
+    RemoveEntry(cache, *sourceFile);
+
+    REQUIRE(loaded == nullptr);
+}
+
+TEST_CASE("TokenCache TruncatedEntryMiss") {
+    Rc<SourceFile> sourceFile{ CreateSourceFile("a.h", "int x;") };
+
+    TokenCache cache{ TEST_CACHE_DIRECTORY };
+    REQUIRE(cache.Store(*sourceFile, LexAll(sourceFile)));
+
+    std::string entryPath{ cache.GetEntryPath(sourceFile->Contents) };
+    FILE* file{ fopen(entryPath.c_str(), "wb") };
+    REQUIRE(file != nullptr);
+    fputs("CMBTOKS", file);
+    fclose(file);
+
+    std::vector<Rc<SyntaxToken>> tokens{ };
+    Rc<SourceFile> loaded{ cache.Load("a.h", sourceFile->Contents, tokens) };
+    RemoveEntry(cache, *sourceFile);
+
+    REQUIRE(loaded == nullptr);
+}